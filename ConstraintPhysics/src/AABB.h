@@ -1,5 +1,6 @@
 #pragma once
 #include "../../Math/src/Vec3.h"
+#include "../../Math/src/Mat3.h"
 #include <vector>
 
 namespace phyz{
@@ -103,6 +104,20 @@ namespace phyz{
 			return out;
 		}
 
+		//bounds of a after it is rotated by rot and translated by trans. Constant time, each new half extent is the old half extents
+		//projected onto the absolute values of the rotation
+		static AABB getTransformed(AABB a, const mthz::Mat3& rot, mthz::Vec3 trans) {
+			mthz::Vec3 center = rot * ((a.max + a.min) / 2.0) + trans;
+			mthz::Vec3 half_dim = (a.max - a.min) / 2.0;
+
+			mthz::Vec3 new_half_dim;
+			for (int i = 0; i < 3; i++) {
+				new_half_dim[i] = abs(rot.v[i][0]) * half_dim.x + abs(rot.v[i][1]) * half_dim.y + abs(rot.v[i][2]) * half_dim.z;
+			}
+
+			return AABB{ center - new_half_dim, center + new_half_dim };
+		}
+
 		static double volume(AABB a) {
 			return	  (a.max.x - a.min.x)
 					* (a.max.y - a.min.y)
@@ -130,6 +145,21 @@ namespace phyz{
 			};
 		}
 
+		static AABB getExpanded(AABB a, double margin) {
+			return AABB{
+				a.min - mthz::Vec3(margin, margin, margin),
+				a.max + mthz::Vec3(margin, margin, margin)
+			};
+		}
+
+		//lower bound on the distance between anything contained by a and anything contained by b. 0 if they overlap
+		static double distanceBetween(AABB a, AABB b) {
+			double dx = std::max<double>(0, std::max<double>(a.min.x - b.max.x, b.min.x - a.max.x));
+			double dy = std::max<double>(0, std::max<double>(a.min.y - b.max.y, b.min.y - a.max.y));
+			double dz = std::max<double>(0, std::max<double>(a.min.z - b.max.z, b.min.z - a.max.z));
+			return sqrt(dx * dx + dy * dy + dz * dz);
+		}
+
 		static bool isAABBContained(AABB contained_aabb, AABB containing_aabb) {
 			return	   contained_aabb.min.x >= containing_aabb.min.x
 					&& contained_aabb.min.y >= containing_aabb.min.y
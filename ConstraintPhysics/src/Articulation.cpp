@@ -0,0 +1,409 @@
+#include "Articulation.h"
+#include <cassert>
+
+namespace phyz {
+
+	static const mthz::Vec3 AXES[3] = { mthz::Vec3(1, 0, 0), mthz::Vec3(0, 1, 0), mthz::Vec3(0, 0, 1) };
+
+	static inline mthz::Vec3 angularPart(const mthz::NVec<6>& s) { return mthz::Vec3(s.v[0], s.v[1], s.v[2]); }
+	static inline mthz::Vec3 linearPart(const mthz::NVec<6>& s) { return mthz::Vec3(s.v[3], s.v[4], s.v[5]); }
+
+	static inline mthz::NVec<6> spatial(mthz::Vec3 angular, mthz::Vec3 linear) {
+		return mthz::NVec<6>{ angular.x, angular.y, angular.z, linear.x, linear.y, linear.z };
+	}
+
+	//m x n, for motion vectors
+	static inline mthz::NVec<6> crossMotion(const mthz::NVec<6>& m, const mthz::NVec<6>& n) {
+		mthz::Vec3 w = angularPart(m), v = linearPart(m);
+		return spatial(w.cross(angularPart(n)), w.cross(linearPart(n)) + v.cross(angularPart(n)));
+	}
+
+	//m x* f, for force vectors
+	static inline mthz::NVec<6> crossForce(const mthz::NVec<6>& m, const mthz::NVec<6>& f) {
+		mthz::Vec3 w = angularPart(m), v = linearPart(m);
+		return spatial(w.cross(angularPart(f)) + v.cross(linearPart(f)), w.cross(linearPart(f)));
+	}
+
+	static inline void copyBlock(mthz::NMat<6, 6>* m, const mthz::Mat3& block, int row, int col) {
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				m->v[row + i][col + j] = block.v[i][j];
+			}
+		}
+	}
+
+	//inertia of a body about the origin, r being its center of mass relative to the origin
+	static mthz::NMat<6, 6> spatialInertia(double mass, const mthz::Mat3& tensor, mthz::Vec3 r) {
+		mthz::NMat<6, 6> out;
+		mthz::Mat3 rx = mthz::Mat3::cross_mat(r);
+		copyBlock(&out, tensor - mass * (rx * rx), 0, 0);
+		copyBlock(&out, mass * rx, 0, 3);
+		copyBlock(&out, -mass * rx, 3, 0);
+		copyBlock(&out, mass * mthz::Mat3::iden(), 3, 3);
+		return out;
+	}
+
+	Articulation::Articulation(RigidBody* root) : n_dof(0) {
+		Link l;
+		l.body = root;
+		l.parent = -1;
+		l.joint = (root->getMovementType() == RigidBody::DYNAMIC) ? FREE_ROOT : FIXED_ROOT;
+		l.dof_begin = 0;
+		l.n_dof = (l.joint == FREE_ROOT) ? 6 : 0;
+		l.position = 0;
+		l.joint_force = 0;
+
+		root->articulation = this;
+		root->articulation_link = 0;
+		links.push_back(l);
+		n_dof = l.n_dof;
+		qdot.assign(n_dof, 0);
+		psuedo_qdot.assign(n_dof, 0);
+	}
+
+	void Articulation::addJoint(RigidBody* parent, RigidBody* child, JointType joint, mthz::Vec3 pivot, mthz::Vec3 axis) {
+		assert(parent->articulation == this && child->articulation == nullptr && child->getMovementType() == RigidBody::DYNAMIC);
+
+		mthz::Quaternion parent_conjugate = parent->orientation.conjugate();
+		Link l;
+		l.body = child;
+		l.parent = parent->articulation_link;
+		l.joint = joint;
+		l.dof_begin = n_dof;
+		l.n_dof = (joint == BALL) ? 3 : 1;
+		l.parent_pivot = parent_conjugate.applyRotation(pivot - parent->com);
+		l.child_pivot = child->orientation.conjugate().applyRotation(pivot - child->com);
+		l.axis = parent_conjugate.applyRotation(axis.normalize());
+		l.rest_orientation = parent_conjugate * child->orientation;
+		l.position = 0;
+		l.joint_force = 0;
+
+		child->articulation = this;
+		child->articulation_link = links.size();
+		links.push_back(l);
+		n_dof += l.n_dof;
+		qdot.resize(n_dof, 0);
+		psuedo_qdot.resize(n_dof, 0);
+	}
+
+	void Articulation::updateKinematics() {
+		origin = links[0].body->com;
+		for (Link& l : links) {
+			if (l.joint == FREE_ROOT) {
+				for (int k = 0; k < 6; k++) {
+					l.S[k] = mthz::NVec<6>{ 0.0 };
+					l.S[k].v[k] = 1;
+				}
+			}
+			else if (l.joint != FIXED_ROOT) {
+				const RigidBody* p = links[l.parent].body;
+				mthz::Vec3 pivot = p->com + p->orientation.applyRotation(l.parent_pivot) - origin;
+				switch (l.joint) {
+				case HINGE:
+				{
+					mthz::Vec3 a = p->orientation.applyRotation(l.axis);
+					l.S[0] = spatial(a, pivot.cross(a));
+					break;
+				}
+				case SLIDER:
+					l.S[0] = spatial(mthz::Vec3(), p->orientation.applyRotation(l.axis));
+					break;
+				case BALL:
+					for (int k = 0; k < 3; k++) {
+						mthz::Vec3 e = p->orientation.applyRotation(AXES[k]);
+						l.S[k] = spatial(e, pivot.cross(e));
+					}
+					break;
+				}
+			}
+		}
+	}
+
+	//the position only half of the articulated body algorithm. Children always come after their parent, so a backwards sweep visits children first
+	void Articulation::updateArticulatedInertias() {
+		for (Link& l : links) {
+			if (l.joint != FIXED_ROOT) l.I = spatialInertia(l.body->mass, l.body->tensor, l.body->com - origin);
+			l.IA = l.I;
+		}
+
+		for (int i = links.size() - 1; i >= 0; i--) {
+			Link& l = links[i];
+			if (l.n_dof == 0) continue;
+
+			double D[36];
+			double D_inverse[36];
+			//the inertias are symmetric and are kept exactly so. Rounding error that makes them slightly asymmetric grows with every joint it is
+			//projected through, and on long chains of ball joints wrecks the inertias near the root
+			for (int k = 0; k < l.n_dof; k++) l.U[k] = l.IA * l.S[k];
+			for (int j = 0; j < l.n_dof; j++) {
+				for (int k = j; k < l.n_dof; k++) {
+					D[j * l.n_dof + k] = l.S[j].dot(l.U[k]);
+					D[k * l.n_dof + j] = D[j * l.n_dof + k];
+				}
+			}
+			switch (l.n_dof) {
+			case 1: D_inverse[0] = 1.0 / D[0]; break;
+			case 3: mthz::rowMajorOrderInverse<3>(D_inverse, D); break;
+			case 6: mthz::rowMajorOrderInverse<6>(D_inverse, D); break;
+			}
+			for (int j = 0; j < l.n_dof; j++) {
+				for (int k = j; k < l.n_dof; k++) {
+					l.Dinv.v[j][k] = 0.5 * (D_inverse[j * l.n_dof + k] + D_inverse[k * l.n_dof + j]);
+					l.Dinv.v[k][j] = l.Dinv.v[j][k];
+				}
+			}
+
+			if (l.parent < 0) continue;
+
+			l.Ia = l.IA;
+			for (int j = 0; j < l.n_dof; j++) {
+				mthz::NVec<6> w{ 0.0 };
+				for (int k = 0; k < l.n_dof; k++) w += l.U[k] * l.Dinv.v[j][k];
+				for (int r = 0; r < 6; r++) {
+					for (int s = r; s < 6; s++) {
+						l.Ia.v[r][s] -= l.U[j].v[r] * w.v[s];
+					}
+				}
+			}
+			for (int r = 0; r < 6; r++) {
+				for (int s = r + 1; s < 6; s++) {
+					l.Ia.v[s][r] = l.Ia.v[r][s];
+				}
+			}
+			Link& p = links[l.parent];
+			for (int r = 0; r < 6; r++) {
+				for (int s = 0; s < 6; s++) {
+					p.IA.v[r][s] += l.Ia.v[r][s];
+				}
+			}
+		}
+	}
+
+	void Articulation::syncBodyVelocities() {
+		for (Link& l : links) {
+			RigidBody* b = l.body;
+			if (l.joint == FIXED_ROOT) {
+				mthz::Vec3 w = b->getAngVel();
+				l.v = spatial(w, b->getVel() - w.cross(b->com - origin));
+				l.c = mthz::NVec<6>{ 0.0 };
+				continue;
+			}
+
+			mthz::NVec<6> joint_vel{ 0.0 };
+			for (int k = 0; k < l.n_dof; k++) joint_vel += l.S[k] * qdot[l.dof_begin + k];
+			if (l.parent < 0) {
+				l.v = joint_vel;
+				l.c = mthz::NVec<6>{ 0.0 };
+			}
+			else {
+				const mthz::NVec<6>& parent_vel = links[l.parent].v;
+				l.v = parent_vel + joint_vel;
+				l.c = crossMotion(parent_vel, joint_vel);
+			}
+
+			mthz::Vec3 w = angularPart(l.v);
+			b->ang_vel = w;
+			b->vel = linearPart(l.v) + w.cross(b->com - origin);
+			l.synced_vel = b->vel;
+			l.synced_ang_vel = b->ang_vel;
+		}
+	}
+
+	void Articulation::absorbBodyVelocityChanges() {
+		bool changed = false;
+		for (Link& l : links) {
+			if (l.joint == FIXED_ROOT) continue;
+			mthz::Vec3 delta_vel = l.body->vel - l.synced_vel;
+			mthz::Vec3 delta_ang_vel = l.body->ang_vel - l.synced_ang_vel;
+			if (delta_vel.magSqrd() == 0 && delta_ang_vel.magSqrd() == 0) continue;
+
+			addLinkImpulse(l.body, delta_vel * l.body->mass, l.body->tensor * delta_ang_vel);
+			changed = true;
+		}
+
+		if (changed) {
+			scratch.resize(n_dof);
+			computeImpulseResponse(scratch.data());
+			for (int i = 0; i < n_dof; i++) qdot[i] += scratch[i];
+		}
+		syncBodyVelocities();
+	}
+
+	void Articulation::stepVelocities(mthz::Vec3 gravity, double step_time) {
+		updateKinematics();
+		updateArticulatedInertias();
+		absorbBodyVelocityChanges();
+
+		//the velocity product terms are quadratic in the velocities. Taken from the start of the step alone they pump energy into fast swinging
+		//chains, so a first pass predicts the velocities at the end of the step and a second takes the terms from the average of the two
+		scratch = qdot;
+		for (int pass = 0; pass < 2; pass++) {
+			if (pass == 1) {
+				for (int i = 0; i < n_dof; i++) qdot[i] = 0.5 * (scratch[i] + qdot[i]);
+				syncBodyVelocities();
+				qdot = scratch;
+			}
+
+			//bias forces, what holds each link to its current velocity against gravity
+			for (Link& l : links) {
+				if (l.joint == FIXED_ROOT) continue;
+				mthz::Vec3 weight = gravity * l.body->mass;
+				l.pA = crossForce(l.v, l.I * l.v) - spatial((l.body->com - origin).cross(weight), weight);
+			}
+
+			for (int i = links.size() - 1; i >= 0; i--) {
+				Link& l = links[i];
+				if (l.n_dof == 0) continue;
+
+				for (int k = 0; k < l.n_dof; k++) l.u.v[k] = -l.S[k].dot(l.pA);
+				if (l.joint == HINGE || l.joint == SLIDER) l.u.v[0] += l.joint_force;
+				if (l.parent < 0) continue;
+
+				mthz::NVec<6> pa = l.pA + l.Ia * l.c;
+				for (int j = 0; j < l.n_dof; j++) {
+					double d = 0;
+					for (int k = 0; k < l.n_dof; k++) d += l.Dinv.v[j][k] * l.u.v[k];
+					pa += l.U[j] * d;
+				}
+				links[l.parent].pA += pa;
+			}
+
+			for (Link& l : links) {
+				if (l.joint == FIXED_ROOT) {
+					l.a = mthz::NVec<6>{ 0.0 };
+					continue;
+				}
+
+				mthz::NVec<6> a = (l.parent < 0) ? l.c : links[l.parent].a + l.c;
+				double qddot[6];
+				for (int j = 0; j < l.n_dof; j++) {
+					qddot[j] = 0;
+					for (int k = 0; k < l.n_dof; k++) qddot[j] += l.Dinv.v[j][k] * (l.u.v[k] - l.U[k].dot(a));
+				}
+				for (int j = 0; j < l.n_dof; j++) a += l.S[j] * qddot[j];
+				l.a = a;
+
+				double* q = &qdot[l.dof_begin];
+				if (l.joint == FREE_ROOT) {
+					//the linear part is the acceleration of the body point at the origin, the center of mass moves away from it at the body's velocity
+					mthz::Vec3 w = angularPart(l.v);
+					mthz::Vec3 v = linearPart(l.v);
+					for (int j = 0; j < 3; j++) q[j] += qddot[j] * step_time;
+					mthz::Vec3 dv = (mthz::Vec3(qddot[3], qddot[4], qddot[5]) + w.cross(v)) * step_time;
+					q[3] += dv.x; q[4] += dv.y; q[5] += dv.z;
+				}
+				else {
+					for (int j = 0; j < l.n_dof; j++) q[j] += qddot[j] * step_time;
+				}
+			}
+		}
+
+		syncBodyVelocities();
+	}
+
+	void Articulation::rowJacobian(RigidBody* link, mthz::Vec3 linear, mthz::Vec3 angular, double* out) const {
+		assert(link->articulation == this);
+		mthz::NVec<6> f = spatial(angular + (link->com - origin).cross(linear), linear);
+		for (int i = link->articulation_link; i >= 0; i = links[i].parent) {
+			const Link& l = links[i];
+			for (int k = 0; k < l.n_dof; k++) out[l.dof_begin + k] += l.S[k].dot(f);
+		}
+	}
+
+	void Articulation::addLinkImpulse(RigidBody* link, mthz::Vec3 linear, mthz::Vec3 angular) {
+		assert(link->articulation == this);
+		links[link->articulation_link].impulse += spatial(angular + (link->com - origin).cross(linear), linear);
+	}
+
+	//the articulated body algorithm with no velocity and the impulses as the only forces. The articulated inertias depend only on the positions,
+	//so those of the step are reused and only the bias terms are swept
+	void Articulation::computeImpulseResponse(double* out) {
+		for (Link& l : links) {
+			l.pA = -l.impulse;
+			l.impulse = mthz::NVec<6>{ 0.0 };
+		}
+
+		for (int i = links.size() - 1; i >= 0; i--) {
+			Link& l = links[i];
+			if (l.n_dof == 0) continue;
+
+			for (int k = 0; k < l.n_dof; k++) l.u.v[k] = -l.S[k].dot(l.pA);
+			if (l.parent < 0) continue;
+
+			mthz::NVec<6> pa = l.pA;
+			for (int j = 0; j < l.n_dof; j++) {
+				double d = 0;
+				for (int k = 0; k < l.n_dof; k++) d += l.Dinv.v[j][k] * l.u.v[k];
+				pa += l.U[j] * d;
+			}
+			links[l.parent].pA += pa;
+		}
+
+		for (Link& l : links) {
+			mthz::NVec<6> a = (l.parent < 0) ? mthz::NVec<6>{ 0.0 } : links[l.parent].a;
+			for (int j = 0; j < l.n_dof; j++) {
+				double delta = 0;
+				for (int k = 0; k < l.n_dof; k++) delta += l.Dinv.v[j][k] * (l.u.v[k] - l.U[k].dot(a));
+				out[l.dof_begin + j] = delta;
+			}
+			for (int j = 0; j < l.n_dof; j++) a += l.S[j] * out[l.dof_begin + j];
+			l.a = a;
+		}
+	}
+
+	void Articulation::applySolverVelocityChanges() {
+		for (int i = 0; i < n_dof; i++) {
+			qdot[i] += velocity_change[i];
+			psuedo_qdot[i] += psuedo_velocity_change[i];
+		}
+	}
+
+	//joint positions are integrated and the link bodies placed from them, root first
+	void Articulation::integratePositions(double step_time) {
+		for (Link& l : links) {
+			RigidBody* b = l.body;
+			if (l.joint == FIXED_ROOT) continue;
+
+			b->prev_com = b->com;
+			b->prev_orientation = b->orientation;
+			double q[6];
+			for (int k = 0; k < l.n_dof; k++) q[k] = qdot[l.dof_begin + k] + psuedo_qdot[l.dof_begin + k];
+
+			mthz::Quaternion joint_rotation;
+			mthz::Vec3 parent_pivot = l.parent_pivot;
+			switch (l.joint) {
+			case FREE_ROOT:
+			{
+				mthz::Vec3 w(q[0], q[1], q[2]);
+				b->com += mthz::Vec3(q[3], q[4], q[5]) * step_time;
+				if (w.magSqrd() != 0) b->orientation = (mthz::Quaternion(step_time * w.mag(), w) * b->orientation).normalize();
+				continue;
+			}
+			case HINGE:
+				l.position += q[0] * step_time;
+				joint_rotation = mthz::Quaternion(l.position, l.axis);
+				break;
+			case SLIDER:
+				l.position += q[0] * step_time;
+				parent_pivot += l.axis * l.position;
+				break;
+			case BALL:
+			{
+				//joint velocities are in the parent's coordinates
+				mthz::Vec3 w(q[0], q[1], q[2]);
+				if (w.magSqrd() != 0) l.ball_orientation = (mthz::Quaternion(step_time * w.mag(), w) * l.ball_orientation).normalize();
+				joint_rotation = l.ball_orientation;
+				break;
+			}
+			}
+
+			const RigidBody* p = links[l.parent].body;
+			b->orientation = (p->orientation * joint_rotation * l.rest_orientation).normalize();
+			b->com = p->com + p->orientation.applyRotation(parent_pivot) - b->orientation.applyRotation(l.child_pivot);
+		}
+
+		for (int i = 0; i < n_dof; i++) psuedo_qdot[i] = 0;
+		updateKinematics();
+		syncBodyVelocities();
+	}
+}
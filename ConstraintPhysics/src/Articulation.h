@@ -0,0 +1,91 @@
+#pragma once
+#include "RigidBody.h"
+#include "../../Math/src/NVec.h"
+#include "../../Math/src/NMat.h"
+#include <vector>
+
+namespace phyz {
+
+	//a tree of bodies joined by hinges, sliders and ball joints, simulated in reduced coordinates: the pose of the root and the position of each
+	//joint. Joints can't drift apart and forward dynamics are O(n) in the number of links with Featherstone's articulated body algorithm, see
+	//Rigid Body Dynamics Algorithms by Roy Featherstone. Contacts and other constraints on the links are solved by PGS alongside everything else,
+	//with the response of the whole tree to an impulse on one link, also found in O(n).
+	//Spatial vectors are in world coordinates about a fixed origin, the root's center of mass at the start of the step, angular part first
+	class Articulation {
+	public:
+		enum JointType { FIXED_ROOT, FREE_ROOT, HINGE, SLIDER, BALL };
+
+		inline RigidBody* getRoot() const { return links[0].body; }
+		inline int getNumLinks() const { return links.size(); }
+		inline int getDegreesOfFreedom() const { return n_dof; }
+		//links are in the order they were added, each after its parent. Link 0 is the root
+		inline RigidBody* getLink(int i) const { return links[i].body; }
+
+		//velocity changes found by the solver for each degree of freedom, sized and cleared by SolverRows
+		std::vector<double> velocity_change;
+		std::vector<double> psuedo_velocity_change;
+
+		//adds to out, one value per degree of freedom, how fast the joints make the row with the given linear and angular jacobian on link change
+		void rowJacobian(RigidBody* link, mthz::Vec3 linear, mthz::Vec3 angular, double* out) const;
+		//queues an impulse with the given linear and angular part on link. computeImpulseResponse writes the velocity change of every degree of
+		//freedom that the queued impulses cause together, then clears them
+		void addLinkImpulse(RigidBody* link, mthz::Vec3 linear, mthz::Vec3 angular);
+		void computeImpulseResponse(double* out);
+		//adds the solver's velocity changes to the joint velocities
+		void applySolverVelocityChanges();
+
+		friend class PhysicsEngine;
+	private:
+		Articulation(RigidBody* root);
+
+		struct Link {
+			RigidBody* body;
+			int parent;
+			JointType joint;
+			int dof_begin;
+			int n_dof;
+			mthz::Vec3 parent_pivot; //parent's local coordinates, relative to its center of mass
+			mthz::Vec3 child_pivot;
+			mthz::Vec3 axis; //parent's local coordinates
+			mthz::Quaternion rest_orientation; //orientation relative to the parent at joint position 0
+			double position;
+			mthz::Quaternion ball_orientation; //relative to the parent
+			double joint_force;
+			mthz::Vec3 synced_vel;
+			mthz::Vec3 synced_ang_vel;
+
+			//motion subspace, velocity, velocity product acceleration and inertia of the current configuration
+			mthz::NVec<6> S[6];
+			mthz::NVec<6> v;
+			mthz::NVec<6> c;
+			mthz::NMat<6, 6> I;
+			//articulated body inertia before and after the joint is projected out, and the terms of the joint it was projected through
+			mthz::NMat<6, 6> IA;
+			mthz::NMat<6, 6> Ia;
+			mthz::NVec<6> U[6];
+			mthz::NMat<6, 6> Dinv;
+			mthz::NVec<6> pA;
+			mthz::NVec<6> u;
+			mthz::NVec<6> a;
+			mthz::NVec<6> impulse;
+		};
+
+		void addJoint(RigidBody* parent, RigidBody* child, JointType joint, mthz::Vec3 pivot, mthz::Vec3 axis);
+		//gravity, joint forces and the velocity product terms over one step, integrated into the joint velocities
+		void stepVelocities(mthz::Vec3 gravity, double step_time);
+		//velocity changes made to the link bodies since they were last synced, by collision actions or by the user, are turned into impulses on the tree
+		void absorbBodyVelocityChanges();
+		void integratePositions(double step_time);
+
+		void updateKinematics();
+		void updateArticulatedInertias();
+		void syncBodyVelocities();
+
+		std::vector<Link> links;
+		std::vector<double> qdot;
+		std::vector<double> psuedo_qdot;
+		std::vector<double> scratch;
+		int n_dof;
+		mthz::Vec3 origin;
+	};
+}
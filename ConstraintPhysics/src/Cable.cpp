@@ -0,0 +1,212 @@
+#include "Cable.h"
+#include <unordered_map>
+#include <algorithm>
+#include <cassert>
+
+namespace phyz {
+
+	Cable::Cable(const std::vector<RigidBody*>& segments, double bending_stiffness, double pos_correct_hardness)
+		: segments(segments), start_attachment(-1), end_attachment(-1), bending_stiffness(bending_stiffness), pos_correct_hardness(pos_correct_hardness), half_bandwidth(0)
+	{
+		assert(segments.size() >= 2);
+
+		//a bending row is placed right after the stretch row that brings in its second segment, which keeps every row within a few of the
+		//others on the same segments
+		for (int i = 0; i < segments.size() - 1; i++) {
+			addLink(segments[i], segments[i + 1], -1, false);
+			if (bending_stiffness > 0 && i >= 1) {
+				addLink(segments[i - 1], segments[i + 1], -1, true);
+			}
+		}
+		orderBand();
+	}
+
+	bool Cable::involves(RigidBody* b) const {
+		if (std::find(segments.begin(), segments.end(), b) != segments.end()) return true;
+		return (start_attachment != -1 && links[start_attachment].b1 == b) || (end_attachment != -1 && links[end_attachment].b1 == b);
+	}
+
+	void Cable::getBandRows(std::vector<Constraint*>* out) {
+		for (int i : band) out->push_back(&links[i].constraint);
+	}
+
+	void Cable::getLooseRows(std::vector<Constraint*>* out) {
+		for (int i : loose) out->push_back(&links[i].constraint);
+	}
+
+	void Cable::getAllRows(std::vector<Constraint*>* out) {
+		for (Link& l : links) out->push_back(&l.constraint);
+	}
+
+	void Cable::addLink(RigidBody* b1, RigidBody* b2, RigidBody::PKey b1_point_key, bool bending) {
+		mthz::Vec3 p1 = (b1_point_key == -1) ? b1->getCOM() : b1->getTrackedP(b1_point_key);
+		mthz::Vec3 diff = p1 - b2->getCOM();
+		assert(diff.magSqrd() != 0);
+
+		links.push_back(Link{ b1, b2, b1_point_key, diff.mag(), bending, DistanceConstraint(b1, b2) });
+	}
+
+	//attached like one more segment, at the current distance between the point and the end segment
+	void Cable::attach(RigidBody* b, RigidBody::PKey point_key, bool at_start) {
+		assert(std::find(segments.begin(), segments.end(), b) == segments.end());
+		assert((at_start ? start_attachment : end_attachment) == -1);
+
+		addLink(b, at_start ? segments.front() : segments.back(), point_key, false);
+		if (at_start) start_attachment = links.size() - 1;
+		else		  end_attachment = links.size() - 1;
+		orderBand();
+	}
+
+	bool Cable::endsJoined() {
+		return start_attachment != -1 && end_attachment != -1 && links[start_attachment].b1 == links[end_attachment].b1
+			&& links[start_attachment].b1->getMovementType() == RigidBody::DYNAMIC;
+	}
+
+	void Cable::orderBand() {
+		band.clear();
+		loose.clear();
+
+		if (start_attachment != -1) band.push_back(start_attachment);
+		for (int i = 0; i < links.size(); i++) {
+			if (i != start_attachment && i != end_attachment) band.push_back(i);
+		}
+		if (end_attachment != -1) {
+			if (endsJoined()) loose.push_back(end_attachment);
+			else			  band.push_back(end_attachment);
+		}
+
+		//rows only couple through the dynamic bodies they share
+		std::unordered_map<RigidBody*, int> first_row;
+		half_bandwidth = 0;
+		for (int i = 0; i < band.size(); i++) {
+			for (RigidBody* b : { links[band[i]].b1, links[band[i]].b2 }) {
+				if (b->getMovementType() != RigidBody::DYNAMIC) continue;
+				auto it = first_row.insert({ b, i }).first;
+				half_bandwidth = std::max<int>(half_bandwidth, i - it->second);
+			}
+		}
+	}
+
+	void Cable::refresh(double pos_correct_coeff, double constraint_force_mixing, double warm_start_coefficient, double step_time) {
+		if (endsJoined() != !loose.empty()) orderBand();
+
+		for (Link& l : links) {
+			mthz::Vec3 p1 = (l.b1_point_key == -1) ? l.b1->getCOM() : l.b1->getTrackedP(l.b1_point_key);
+			mthz::Vec3 p2 = l.b2->getCOM();
+			mthz::NVec<1> starting_impulse = warm_start_coefficient * l.constraint.impulse;
+
+			if (!l.bending) {
+				l.constraint.refresh(p1, p2, l.rest_length, pos_correct_coeff, constraint_force_mixing, false, starting_impulse);
+				l.constraint.compliance = 0;
+			}
+			else {
+				//an implicit spring as a soft row, see Soft Constraints by Erin Catto. The row is scaled by the distance, as its jacobian isn't normalized,
+				//and has no position correction since the spring pulls back the error itself
+				l.constraint.refresh(p1, p2, l.rest_length, 0, constraint_force_mixing, false, starting_impulse);
+				double distance = (p1 - p2).mag();
+				l.constraint.target_val.v[0] += distance * (l.rest_length - distance) / step_time;
+				DistanceConstraint& c = l.constraint;
+				c.compliance = distance * distance / (step_time * step_time * bending_stiffness);
+				c.impulse_to_value_inverse.v[0][0] = 1.0 / (c.impulse_to_value.v[0][0] * (1 + constraint_force_mixing) + c.compliance);
+			}
+		}
+	}
+
+	//entry of the band matrix, the change in row i's value per impulse of row j
+	double Cable::coupling(int i, int j) {
+		const DistanceConstraint& ci = links[band[i]].constraint;
+		const DistanceConstraint& cj = links[band[j]].constraint;
+
+		double out = 0;
+		for (int k = 0; k < 6; k++) {
+			if (ci.a_solver_index != 0 && ci.a_solver_index == cj.a_solver_index) out += ci.a_jacobian.v[0][k] * cj.impulse_to_a_velocity.v[k][0];
+			if (ci.a_solver_index != 0 && ci.a_solver_index == cj.b_solver_index) out += ci.a_jacobian.v[0][k] * cj.impulse_to_b_velocity.v[k][0];
+			if (ci.b_solver_index != 0 && ci.b_solver_index == cj.a_solver_index) out += ci.b_jacobian.v[0][k] * cj.impulse_to_a_velocity.v[k][0];
+			if (ci.b_solver_index != 0 && ci.b_solver_index == cj.b_solver_index) out += ci.b_jacobian.v[0][k] * cj.impulse_to_b_velocity.v[k][0];
+		}
+		return out;
+	}
+
+	void Cable::prepareSolve(SolverBodies* solver_bodies) {
+		mthz::NVec<6>* velocity_changes = solver_bodies->velocity_changes.data();
+		mthz::NVec<6>* psuedo_velocity_changes = solver_bodies->psuedo_velocity_changes.data();
+		for (int i : band) {
+			DistanceConstraint& c = links[i].constraint;
+			c.a_velocity_change = &velocity_changes[c.a_solver_index];
+			c.a_psuedo_velocity_change = &psuedo_velocity_changes[c.a_solver_index];
+			c.b_velocity_change = &velocity_changes[c.b_solver_index];
+			c.b_psuedo_velocity_change = &psuedo_velocity_changes[c.b_solver_index];
+			if (c.constraintWarmStarted()) c.applyWarmStartVelocityChange();
+		}
+
+		//banded LDL^T, L(i, j) stored at L[i * w + i - j - 1]
+		int m = band.size();
+		int w = half_bandwidth;
+		L.assign(m * w, 0);
+		D.assign(m, 0);
+		rhs.resize(m);
+		for (int i = 0; i < m; i++) {
+			int begin = std::max<int>(0, i - w);
+			for (int j = begin; j < i; j++) {
+				double v = coupling(i, j);
+				for (int k = std::max<int>(begin, j - w); k < j; k++) {
+					v -= L[i * w + i - k - 1] * D[k] * L[j * w + j - k - 1];
+				}
+				L[i * w + i - j - 1] = v / D[j];
+			}
+
+			const DistanceConstraint& c = links[band[i]].constraint;
+			double diagonal = c.impulse_to_value.v[0][0] * (1 + c.constraint_force_mixing) + c.compliance;
+			double d = diagonal;
+			for (int k = begin; k < i; k++) {
+				d -= L[i * w + i - k - 1] * L[i * w + i - k - 1] * D[k];
+			}
+			//a straight cable makes its bending rows nearly dependent on the stretch rows, which stiff bending barely softens
+			D[i] = std::max<double>(d, 0.000001 * diagonal);
+		}
+	}
+
+	void Cable::solve(bool use_psuedo_values) {
+		int m = band.size();
+		int w = half_bandwidth;
+
+		for (int i = 0; i < m; i++) {
+			const DistanceConstraint& c = links[band[i]].constraint;
+			if (use_psuedo_values) {
+				double value = (c.a_jacobian * *c.a_psuedo_velocity_change + c.b_jacobian * *c.b_psuedo_velocity_change).v[0];
+				rhs[i] = c.psuedo_target_val.v[0] - value - c.compliance * c.psuedo_impulse.v[0];
+			}
+			else {
+				double value = (c.a_jacobian * *c.a_velocity_change + c.b_jacobian * *c.b_velocity_change).v[0];
+				rhs[i] = c.target_val.v[0] - value - c.compliance * c.impulse.v[0];
+			}
+		}
+
+		for (int i = 0; i < m; i++) {
+			for (int j = std::max<int>(0, i - w); j < i; j++) {
+				rhs[i] -= L[i * w + i - j - 1] * rhs[j];
+			}
+		}
+		for (int i = 0; i < m; i++) {
+			rhs[i] /= D[i];
+		}
+		for (int i = m - 1; i >= 0; i--) {
+			for (int j = i + 1; j <= std::min<int>(m - 1, i + w); j++) {
+				rhs[i] -= L[j * w + j - i - 1] * rhs[j];
+			}
+		}
+
+		for (int i = 0; i < m; i++) {
+			DistanceConstraint& c = links[band[i]].constraint;
+			mthz::NVec<1> impulse = mthz::NVec<1>{ rhs[i] };
+			if (use_psuedo_values) {
+				c.psuedo_impulse += impulse;
+				c.computeAndApplyVelocityChange(impulse, c.a_psuedo_velocity_change, c.b_psuedo_velocity_change);
+			}
+			else {
+				c.impulse += impulse;
+				c.computeAndApplyVelocityChange(impulse, c.a_velocity_change, c.b_velocity_change);
+			}
+		}
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "RigidBody.h"
+#include "ConstraintSolver.h"
+#include <vector>
+
+namespace phyz {
+
+	//a rope or cable of bodies joined center of mass to center of mass by distance rows, with optional bending springs between every other
+	//segment and optional attachments of either end to ordinary bodies. Each row only shares bodies with the few rows beside it, so the
+	//rows of the whole cable form a banded matrix that is factorized and solved directly in O(n), in place of the many PGS iterations a long
+	//chain needs to stop stretching. Contacts and other constraints on the segments are solved by PGS as usual, alternating with the cable.
+	//Segments are free to spin about their center of mass, so round segments suit best
+	class Cable {
+	public:
+		inline int getNumSegments() const { return segments.size(); }
+		inline RigidBody* getSegment(int i) const { return segments[i]; }
+		inline double getBendingStiffness() const { return bending_stiffness; }
+		bool involves(RigidBody* b) const;
+
+		//rows solved by the cable, and the rows left to PGS. An end attachment to a body the rest of the cable already touches would join the
+		//two ends of the band, so is left to PGS
+		void getBandRows(std::vector<Constraint*>* out);
+		void getLooseRows(std::vector<Constraint*>* out);
+		//every row of the cable, for solvers that don't solve the cable directly. Bending rows are soft, so are solved as generic rows there
+		void getAllRows(std::vector<Constraint*>* out);
+
+		//points the rows at the solver's velocity changes, applies their warm start and factorizes the band. Solver indices must already be assigned
+		void prepareSolve(SolverBodies* solver_bodies);
+		//solves the band rows exactly against the current velocity changes of the bodies
+		void solve(bool use_psuedo_values);
+
+		friend class PhysicsEngine;
+	private:
+		Cable(const std::vector<RigidBody*>& segments, double bending_stiffness, double pos_correct_hardness);
+
+		struct Link {
+			RigidBody* b1;
+			RigidBody* b2;
+			RigidBody::PKey b1_point_key; //-1 when b1 is a segment, joined at its center of mass
+			double rest_length;
+			bool bending;
+			DistanceConstraint constraint;
+		};
+
+		void addLink(RigidBody* b1, RigidBody* b2, RigidBody::PKey b1_point_key, bool bending);
+		void attach(RigidBody* b, RigidBody::PKey point_key, bool at_start);
+		//the two ends attached to the same dynamic body, in which case the end attachment is left to PGS
+		bool endsJoined();
+		void orderBand();
+		//recomputes the rows for the new positions, at the start of each step
+		void refresh(double pos_correct_coeff, double constraint_force_mixing, double warm_start_coefficient, double step_time);
+		double coupling(int i, int j);
+
+		std::vector<RigidBody*> segments;
+		std::vector<Link> links;
+		int start_attachment;
+		int end_attachment;
+		double bending_stiffness;
+		double pos_correct_hardness;
+
+		//band rows in solve order, rows left to PGS, and the LDL^T factorization of the band: half_bandwidth entries of L left of the diagonal per row
+		std::vector<int> band;
+		std::vector<int> loose;
+		int half_bandwidth;
+		std::vector<double> L;
+		std::vector<double> D;
+		std::vector<double> rhs;
+	};
+}
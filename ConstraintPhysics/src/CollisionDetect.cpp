@@ -3,6 +3,7 @@
 #include "Geometry.h"
 
 #include <cassert>
+#include <algorithm>
 
 static uint32_t getEdgeID(uint16_t p1_id, uint16_t p2_id) {
 	int min, max;
@@ -47,23 +48,23 @@ namespace phyz {
 	static std::vector<Manifold> SAT_SphereMesh(const Sphere& a, AABB a_aabb, int a_id, const Material& a_mat, const StaticMeshGeometry& b, mthz::Vec3 b_world_position, mthz::Quaternion b_world_orientation);
 	static std::vector<Manifold> SAT_CylinderMesh(const Cylinder& a, AABB a_aabb, int a_id, const Material& a_mat, const StaticMeshGeometry& b, mthz::Vec3 b_world_position, mthz::Quaternion b_world_orientation);
 
-	Manifold detectCollision(const ConvexPrimitive& a, const ConvexPrimitive& b) {
+	static Manifold detectPrimitiveCollision(const ConvexGeometry& a, int a_id, const Material& a_mat, const ConvexGeometry& b, int b_id, const Material& b_mat) {
 		switch (a.getType()) {
 		case POLYHEDRON:
 			switch (b.getType()) {
 			case POLYHEDRON:
-				return SAT_PolyPoly((const Polyhedron&)*a.getGeometry(), a.getID(), a.material, (const Polyhedron&)*b.getGeometry(), b.getID(), b.material);
+				return SAT_PolyPoly((const Polyhedron&)a, a_id, a_mat, (const Polyhedron&)b, b_id, b_mat);
 			case SPHERE:
-				return SAT_PolySphere((const Polyhedron&)*a.getGeometry(), a.getID(), a.material, (const Sphere&)*b.getGeometry(), b.getID(), b.material);
+				return SAT_PolySphere((const Polyhedron&)a, a_id, a_mat, (const Sphere&)b, b_id, b_mat);
 			case CYLINDER:
-				return SAT_PolyCylinder((const Polyhedron&)*a.getGeometry(), a.getID(), a.material, (const Cylinder&)*b.getGeometry(), b.getID(), b.material);
+				return SAT_PolyCylinder((const Polyhedron&)a, a_id, a_mat, (const Cylinder&)b, b_id, b_mat);
 			}
 			break;
 		case SPHERE:
 			switch (b.getType()) {
 			case POLYHEDRON:
 			{
-				Manifold out = SAT_PolySphere((const Polyhedron&)*b.getGeometry(), b.getID(), b.material, (const Sphere&)*a.getGeometry(), a.getID(), a.material);
+				Manifold out = SAT_PolySphere((const Polyhedron&)b, b_id, b_mat, (const Sphere&)a, a_id, a_mat);
 				out.normal = -out.normal; //physics engine expects the manifold to be facing away from a. SAT_PolySphere generates normal facing away from the polyhedron
 				for (ContactP& p : out.points) {
 					p.magicID = swapOrder(p.magicID);
@@ -71,16 +72,16 @@ namespace phyz {
 				return out;
 			}
 			case SPHERE:
-				return detectSphereSphere((const Sphere&)*a.getGeometry(), a.getID(), a.material, (const Sphere&)*b.getGeometry(), b.getID(), b.material);
+				return detectSphereSphere((const Sphere&)a, a_id, a_mat, (const Sphere&)b, b_id, b_mat);
 			case CYLINDER:
-				return detectSphereCylinder((const Sphere&)*a.getGeometry(), a.getID(), a.material, (const Cylinder&)*b.getGeometry(), b.getID(), b.material);
+				return detectSphereCylinder((const Sphere&)a, a_id, a_mat, (const Cylinder&)b, b_id, b_mat);
 			}
 			break;
 		case CYLINDER:
 			switch (b.getType()) {
 			case POLYHEDRON:
 			{
-				Manifold out = SAT_PolyCylinder((const Polyhedron&)*b.getGeometry(), b.getID(), b.material, (const Cylinder&)*a.getGeometry(), a.getID(), a.material);
+				Manifold out = SAT_PolyCylinder((const Polyhedron&)b, b_id, b_mat, (const Cylinder&)a, a_id, a_mat);
 				out.normal = -out.normal; //physics engine expects the manifold to be facing away from a. SAT_PolySphere generates normal facing away from the polyhedron
 				for (ContactP& p : out.points) {
 					p.magicID = swapOrder(p.magicID);
@@ -89,7 +90,7 @@ namespace phyz {
 			}
 			case SPHERE:
 			{
-				Manifold out = detectSphereCylinder((const Sphere&)*b.getGeometry(), b.getID(), b.material, (const Cylinder&)*a.getGeometry(), a.getID(), a.material);
+				Manifold out = detectSphereCylinder((const Sphere&)b, b_id, b_mat, (const Cylinder&)a, a_id, a_mat);
 				out.normal = -out.normal; //physics engine expects the manifold to be facing away from a. detectSphereCylinder generates normal facing away from the sphere
 				for (ContactP& p : out.points) {
 					p.magicID = swapOrder(p.magicID);
@@ -97,12 +98,43 @@ namespace phyz {
 				return out;
 			}
 			case CYLINDER:
-				return detectCylinderCylinder((const Cylinder&)*a.getGeometry(), a.getID(), a.material, (const Cylinder&)*b.getGeometry(), b.getID(), b.material);
+				return detectCylinderCylinder((const Cylinder&)a, a_id, a_mat, (const Cylinder&)b, b_id, b_mat);
 			}
 		}
 		
 	}
 
+	Manifold detectCollision(const ConvexPrimitive& a, const ConvexPrimitive& b) {
+		return detectPrimitiveCollision(*a.getGeometry(), a.getID(), a.material, *b.getGeometry(), b.getID(), b.material);
+	}
+
+	Manifold detectCollision(const ConvexPrimitive& a, const ConvexPrimitive& b, const mthz::Mat3& b_rot, mthz::Vec3 b_trans) {
+		//only a copy of b is brought into a's coordinates, the primitives themselves are left untouched
+		switch (b.getType()) {
+		case POLYHEDRON:
+		{
+			const Polyhedron& reference = (const Polyhedron&)*b.getGeometry();
+			Polyhedron transformed = reference;
+			transformed.recomputeFromReference((const ConvexGeometry&)reference, b_rot, b_trans);
+			return detectPrimitiveCollision(*a.getGeometry(), a.getID(), a.material, (const ConvexGeometry&)transformed, b.getID(), b.material);
+		}
+		case SPHERE:
+		{
+			const Sphere& reference = (const Sphere&)*b.getGeometry();
+			Sphere transformed = reference;
+			transformed.recomputeFromReference((const ConvexGeometry&)reference, b_rot, b_trans);
+			return detectPrimitiveCollision(*a.getGeometry(), a.getID(), a.material, (const ConvexGeometry&)transformed, b.getID(), b.material);
+		}
+		case CYLINDER:
+		{
+			const Cylinder& reference = (const Cylinder&)*b.getGeometry();
+			Cylinder transformed = reference;
+			transformed.recomputeFromReference((const ConvexGeometry&)reference, b_rot, b_trans);
+			return detectPrimitiveCollision(*a.getGeometry(), a.getID(), a.material, (const ConvexGeometry&)transformed, b.getID(), b.material);
+		}
+		}
+	}
+
 	std::vector<Manifold> detectCollision(const ConvexPrimitive& a, AABB a_aabb, const StaticMeshGeometry& b, mthz::Vec3 b_world_position, mthz::Quaternion b_world_orientation) {
 		switch (a.getType()) {
 		case POLYHEDRON:
@@ -588,8 +620,8 @@ namespace phyz {
 				}
 			}
 		}
-		for (GaussArc arc1 : ag.arcs) {
-			for (GaussArc arc2 : bg.arcs) {
+		for (GaussArc arc1 : *ag.arcs) {
+			for (GaussArc arc2 : *bg.arcs) {
 
 				mthz::Vec3 a1 = ag.face_verts[arc1.v1_indx].v;
 				mthz::Vec3 a2 = ag.face_verts[arc1.v2_indx].v;
@@ -1040,7 +1072,7 @@ namespace phyz {
 			}
 		}
 		//check edge edge
-		for (GaussArc arc1 : ag.arcs) {
+		for (GaussArc arc1 : *ag.arcs) {
 			for (GaussArc arc2 : b.getGuassArcs()) {
 
 				mthz::Vec3 a1 = ag.face_verts[arc1.v1_indx].v;
@@ -1315,7 +1347,7 @@ namespace phyz {
 			SimpleArc{b.normal, b.edges[2].out_direction}, SimpleArc{b.edges[2].out_direction, -b.normal},
 		};
 
-		for (const GaussArc& arc1 : ag.arcs) {
+		for (const GaussArc& arc1 : *ag.arcs) {
 			for (SimpleArc sa : triangle_arcs) {
 
 				mthz::Vec3 a1 = ag.face_verts[arc1.v1_indx].v;
@@ -1815,4 +1847,411 @@ namespace phyz {
 
 		return out;
 	}
+
+	struct SupportP {
+		mthz::Vec3 p;
+		int id;
+	};
+
+	static SupportP polyhedronSupport(const Polyhedron& c, mthz::Vec3 dir, int hint) {
+		int i = c.getSupportPointIndex(dir, hint);
+		return SupportP{ c.getPoints()[i], i };
+	}
+
+	static SupportP primitiveSupport(const ConvexPrimitive& c, mthz::Vec3 dir, int hint) {
+		switch (c.getType()) {
+		case POLYHEDRON:
+			return polyhedronSupport((const Polyhedron&)*c.getGeometry(), dir, hint);
+		case SPHERE:
+		{
+			const Sphere& s = (const Sphere&)*c.getGeometry();
+			return SupportP{ s.getCenter() + dir.normalize() * s.getRadius(), -1 };
+		}
+		case CYLINDER:
+		{
+			const Cylinder& cy = (const Cylinder&)*c.getGeometry();
+			mthz::Vec3 n = dir.normalize();
+			mthz::Vec3 disk_center = (cy.getHeightAxis().dot(n) > 0) ? cy.getTopDiskCenter() : cy.getBotDiskCenter();
+			return SupportP{ Cylinder::getExtremaOfDisk(disk_center, cy.getHeightAxis(), cy.getRadius(), n), -1 };
+		}
+		}
+		assert(false);
+		return SupportP{ mthz::Vec3(), -1 };
+	}
+
+	static SupportP triangleSupport(const StaticMeshFace& t, mthz::Vec3 dir) {
+		int max_i = 0;
+		double max_val = t.vertices[0].p.dot(dir);
+		for (int i = 1; i < 3; i++) {
+			double val = t.vertices[i].p.dot(dir);
+			if (val > max_val) {
+				max_val = val;
+				max_i = i;
+			}
+		}
+		return SupportP{ t.vertices[max_i].p, max_i };
+	}
+
+	struct SimplexVert {
+		mthz::Vec3 w; //a - b
+		mthz::Vec3 a;
+		mthz::Vec3 b;
+	};
+
+	struct Simplex {
+		SimplexVert verts[4];
+		double lambdas[4];
+		int n;
+	};
+
+	//reduces s to the sub-simplex whose interior contains the point of s closest to the origin, and fills in the barycentric coordinates of that point
+	static void reduceSimplexSegment(Simplex* s) {
+		mthz::Vec3 a = s->verts[0].w;
+		mthz::Vec3 ab = s->verts[1].w - a;
+		double ab_sqrd = ab.magSqrd();
+		double t = (ab_sqrd == 0) ? 0 : -a.dot(ab) / ab_sqrd;
+
+		if (t <= 0) {
+			s->n = 1;
+			s->lambdas[0] = 1;
+		}
+		else if (t >= 1) {
+			s->verts[0] = s->verts[1];
+			s->n = 1;
+			s->lambdas[0] = 1;
+		}
+		else {
+			s->lambdas[0] = 1 - t;
+			s->lambdas[1] = t;
+		}
+	}
+
+	//see Ericson, Real-Time Collision Detection, 5.1.5
+	static void reduceSimplexTriangle(Simplex* s) {
+		SimplexVert A = s->verts[0], B = s->verts[1], C = s->verts[2];
+		mthz::Vec3 ab = B.w - A.w;
+		mthz::Vec3 ac = C.w - A.w;
+
+		double d1 = -ab.dot(A.w);
+		double d2 = -ac.dot(A.w);
+		if (d1 <= 0 && d2 <= 0) {
+			s->n = 1;
+			s->lambdas[0] = 1;
+			return;
+		}
+
+		double d3 = -ab.dot(B.w);
+		double d4 = -ac.dot(B.w);
+		if (d3 >= 0 && d4 <= d3) {
+			s->verts[0] = B;
+			s->n = 1;
+			s->lambdas[0] = 1;
+			return;
+		}
+
+		double vc = d1 * d4 - d3 * d2;
+		if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+			double v = d1 / (d1 - d3);
+			s->n = 2;
+			s->lambdas[0] = 1 - v;
+			s->lambdas[1] = v;
+			return;
+		}
+
+		double d5 = -ab.dot(C.w);
+		double d6 = -ac.dot(C.w);
+		if (d6 >= 0 && d5 <= d6) {
+			s->verts[0] = C;
+			s->n = 1;
+			s->lambdas[0] = 1;
+			return;
+		}
+
+		double vb = d5 * d2 - d1 * d6;
+		if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+			double w = d2 / (d2 - d6);
+			s->verts[1] = C;
+			s->n = 2;
+			s->lambdas[0] = 1 - w;
+			s->lambdas[1] = w;
+			return;
+		}
+
+		double va = d3 * d6 - d5 * d4;
+		if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+			double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			s->verts[0] = B;
+			s->verts[1] = C;
+			s->n = 2;
+			s->lambdas[0] = 1 - w;
+			s->lambdas[1] = w;
+			return;
+		}
+
+		double denom = 1.0 / (va + vb + vc);
+		double v = vb * denom;
+		double w = vc * denom;
+		s->lambdas[0] = 1 - v - w;
+		s->lambdas[1] = v;
+		s->lambdas[2] = w;
+	}
+
+	static mthz::Vec3 simplexClosestPoint(const Simplex& s) {
+		mthz::Vec3 out;
+		for (int i = 0; i < s.n; i++) out += s.lambdas[i] * s.verts[i].w;
+		return out;
+	}
+
+	//returns false if the origin is contained by the tetrahedron
+	static bool reduceSimplexTetrahedron(Simplex* s) {
+		static const int faces[4][4] = { {0, 1, 2, 3}, {0, 2, 3, 1}, {0, 3, 1, 2}, {1, 3, 2, 0} }; //3 face indices + the opposite vertex
+
+		bool origin_outside_any = false;
+		Simplex best;
+		double best_dist_sqrd = std::numeric_limits<double>::infinity();
+		for (int i = 0; i < 4; i++) {
+			mthz::Vec3 a = s->verts[faces[i][0]].w;
+			mthz::Vec3 n = (s->verts[faces[i][1]].w - a).cross(s->verts[faces[i][2]].w - a);
+			double origin_side = -a.dot(n);
+			double opposite_side = (s->verts[faces[i][3]].w - a).dot(n);
+
+			if (origin_side * opposite_side < 0) {
+				origin_outside_any = true;
+
+				Simplex face;
+				face.n = 3;
+				for (int j = 0; j < 3; j++) face.verts[j] = s->verts[faces[i][j]];
+				reduceSimplexTriangle(&face);
+
+				double dist_sqrd = simplexClosestPoint(face).magSqrd();
+				if (dist_sqrd < best_dist_sqrd) {
+					best_dist_sqrd = dist_sqrd;
+					best = face;
+				}
+			}
+		}
+
+		if (!origin_outside_any) {
+			return false;
+		}
+		*s = best;
+		return true;
+	}
+
+	static const double GJK_REL_TOL = 0.0000000001;
+	static const double GJK_ABS_TOL_SQRD = 0.000000000000000001;
+	static const int GJK_MAX_ITR = 64;
+
+	//GJK distance between the convex shapes described by support_a and support_b. Does not fill in anything beyond found=false if they overlap.
+	//Shapes touching within tolerance also give found=false, but with the witness points of the final simplex and a normal filled in
+	template<typename SupportA, typename SupportB>
+	static DistanceInfo gjkDistance(const SupportA& support_a, const SupportB& support_b, SimplexCache* cache) {
+		Simplex s;
+		s.n = 0;
+
+		mthz::Vec3 v = cache->last_dir;
+		if (v.magSqrd() == 0) v = mthz::Vec3(1, 0, 0);
+
+		for (int itr = 0; itr < GJK_MAX_ITR; itr++) {
+			SupportP sa = support_a(-v, cache->a_support_hint);
+			SupportP sb = support_b(v, cache->b_support_hint);
+			cache->a_support_hint = sa.id;
+			cache->b_support_hint = sb.id;
+			SimplexVert w = { sa.p - sb.p, sa.p, sb.p };
+
+			if (s.n > 0) {
+				double v_sqrd = v.magSqrd();
+				if (v_sqrd - v.dot(w.w) <= GJK_REL_TOL * v_sqrd) break;
+
+				bool repeated_vertex = false;
+				for (int i = 0; i < s.n; i++) {
+					if (s.verts[i].w == w.w) repeated_vertex = true;
+				}
+				if (repeated_vertex) break;
+			}
+
+			s.verts[s.n++] = w;
+			switch (s.n) {
+			case 1: s.lambdas[0] = 1; break;
+			case 2: reduceSimplexSegment(&s); break;
+			case 3: reduceSimplexTriangle(&s); break;
+			case 4:
+				if (!reduceSimplexTetrahedron(&s)) {
+					return DistanceInfo{ false };
+				}
+				break;
+			}
+
+			mthz::Vec3 prev_v = v;
+			v = simplexClosestPoint(s);
+			if (v.magSqrd() < GJK_ABS_TOL_SQRD) {
+				//the origin lies on the simplex. A triangle is a piece of a face of the minkowski difference, giving the normal, otherwise the
+				//last direction searched is the best guess
+				mthz::Vec3 n = prev_v;
+				if (s.n == 3) {
+					mthz::Vec3 face_n = (s.verts[1].w - s.verts[0].w).cross(s.verts[2].w - s.verts[0].w);
+					if (face_n.magSqrd() > 0) n = (face_n.dot(prev_v) >= 0) ? face_n : -face_n;
+				}
+				cache->last_dir = n;
+
+				DistanceInfo touching = { false, 0 };
+				touching.normal = -n.normalize();
+				for (int i = 0; i < s.n; i++) {
+					touching.a_point += s.lambdas[i] * s.verts[i].a;
+					touching.b_point += s.lambdas[i] * s.verts[i].b;
+				}
+				return touching;
+			}
+		}
+
+		cache->last_dir = v;
+
+		DistanceInfo out;
+		out.found = true;
+		out.distance = v.mag();
+		out.normal = -v / out.distance;
+		for (int i = 0; i < s.n; i++) {
+			out.a_point += s.lambdas[i] * s.verts[i].a;
+			out.b_point += s.lambdas[i] * s.verts[i].b;
+		}
+		return out;
+	}
+
+	//shapes touching within tolerance, too close for GJK to separate but not overlapping enough for SAT to find a contact. Uses what GJK filled
+	//in when it ended on the touching simplex, otherwise the supports of each shape toward the other along the last direction searched
+	template<typename SupportA, typename SupportB>
+	static DistanceInfo touchingDistanceInfo(const DistanceInfo& gjk, const SupportA& support_a, const SupportB& support_b, SimplexCache* cache) {
+		DistanceInfo out = gjk;
+		out.found = true;
+		out.distance = 0;
+		if (gjk.normal.magSqrd() != 0) {
+			return out;
+		}
+
+		mthz::Vec3 v = cache->last_dir;
+		if (v.magSqrd() == 0) v = mthz::Vec3(1, 0, 0);
+		out.normal = -v.normalize();
+		out.a_point = support_a(-v, cache->a_support_hint).p;
+		out.b_point = support_b(v, cache->b_support_hint).p;
+		return out;
+	}
+
+	//GJK only answers whether overlapping shapes overlap, so the penetration depth comes from the same SAT routines used by contact generation.
+	//Shapes only touching come back from SAT with a depth of 0 and exact contact points
+	static DistanceInfo distanceInfoFromManifold(const Manifold& m) {
+		if (m.max_pen_depth < 0 || m.points.empty()) {
+			return DistanceInfo{ false };
+		}
+
+		ContactP deepest = m.points[0];
+		for (const ContactP& p : m.points) {
+			if (p.pen_depth > deepest.pen_depth) deepest = p;
+		}
+
+		DistanceInfo out;
+		out.found = true;
+		out.distance = -deepest.pen_depth;
+		out.normal = m.normal;
+		out.a_point = deepest.pos;
+		out.b_point = deepest.pos - m.normal * deepest.pen_depth;
+		return out;
+	}
+
+	DistanceInfo computeDistance(const ConvexPrimitive& a, const ConvexPrimitive& b, SimplexCache* cache) {
+		SimplexCache tmp_cache;
+		if (cache == nullptr) cache = &tmp_cache;
+
+		auto support_a = [&](mthz::Vec3 dir, int hint) { return primitiveSupport(a, dir, hint); };
+		auto support_b = [&](mthz::Vec3 dir, int hint) { return primitiveSupport(b, dir, hint); };
+		DistanceInfo out = gjkDistance(support_a, support_b, cache);
+
+		if (!out.found) {
+			DistanceInfo gjk = out;
+			out = distanceInfoFromManifold(detectCollision(a, b));
+			if (!out.found) {
+				out = touchingDistanceInfo(gjk, support_a, support_b, cache);
+			}
+		}
+		return out;
+	}
+
+	static DistanceInfo computeTriangleDistance(const ConvexPrimitive& a, const StaticMeshFace& t, SimplexCache* cache) {
+		auto support_a = [&](mthz::Vec3 dir, int hint) { return primitiveSupport(a, dir, hint); };
+		auto support_t = [&](mthz::Vec3 dir, int hint) { return triangleSupport(t, dir); };
+		DistanceInfo out = gjkDistance(support_a, support_t, cache);
+
+		if (!out.found) {
+			DistanceInfo gjk = out;
+			Manifold m;
+			switch (a.getType()) {
+			case POLYHEDRON:	m = SAT_PolyTriangle((const Polyhedron&)*a.getGeometry(), a.getID(), a.material, t, 0); break;
+			case SPHERE:		m = SAT_SphereTriangle((const Sphere&)*a.getGeometry(), a.getID(), a.material, t, 0); break;
+			case CYLINDER:		m = SAT_CylinderTriangle((const Cylinder&)*a.getGeometry(), a.getID(), a.material, t, 0); break;
+			}
+			out = distanceInfoFromManifold(m);
+			if (!out.found) {
+				out = touchingDistanceInfo(gjk, support_a, support_t, cache);
+			}
+		}
+		return out;
+	}
+
+	DistanceInfo computeDistance(const ConvexPrimitive& a, AABB a_aabb, const StaticMeshGeometry& b, mthz::Vec3 b_world_position, mthz::Quaternion b_world_orientation, MeshDistanceCache* cache) {
+		MeshDistanceCache tmp_cache;
+		if (cache == nullptr) cache = &tmp_cache;
+
+		DistanceInfo best = { false, std::numeric_limits<double>::infinity() };
+		if (b.getTriangles().empty()) {
+			return best;
+		}
+
+		mthz::Mat3 local_to_world_rot = b_world_orientation.getRotMatrix();
+		bool local_transformation_required = b_world_position != mthz::Vec3() || b_world_orientation != mthz::Quaternion();
+		mthz::Vec3 u = local_to_world_rot * mthz::Vec3(1, 0, 0);
+		mthz::Vec3 v = local_to_world_rot * mthz::Vec3(0, 1, 0);
+		mthz::Vec3 w = local_to_world_rot * mthz::Vec3(0, 0, 1);
+
+		auto getCandidates = [&](double margin) {
+			AABB search_aabb = AABB::getExpanded(a_aabb, margin);
+			if (local_transformation_required) search_aabb = AABB::conformNewBasis(search_aabb, u, v, w, b_world_position);
+			return b.getAABBTree().getCollisionCandidatesWith(search_aabb);
+		};
+
+		auto checkTriangle = [&](unsigned int i) {
+			StaticMeshFace tri = local_transformation_required ? b.getTriangles()[i].getTransformed(local_to_world_rot, b_world_position, mthz::Vec3()) : b.getTriangles()[i];
+			SimplexCache tri_cache = cache->simplex;
+			DistanceInfo d = computeTriangleDistance(a, tri, &tri_cache);
+			if (d.found && d.distance < best.distance) {
+				best = d;
+				cache->triangle_hint = i;
+				cache->simplex = tri_cache;
+			}
+		};
+
+		//the triangle closest last query gives an upper bound that is usually tight. Without one, grow the search region until something is found
+		int hint = cache->triangle_hint;
+		std::vector<unsigned int> candidates;
+		if (hint >= 0 && hint < b.getTriangles().size()) {
+			checkTriangle(hint);
+		}
+		else {
+			double search_margin = std::max<double>(AABB::longestDimension(a_aabb), 0.01);
+			for (int i = 0; i < 64 && candidates.empty(); i++) {
+				candidates = getCandidates(search_margin);
+				search_margin *= 2;
+			}
+			for (unsigned int i : candidates) checkTriangle(i);
+		}
+
+		//any triangle closer than the current best must intersect a_aabb expanded by that distance
+		if (best.found) {
+			for (unsigned int i : getCandidates(std::max<double>(best.distance, 0))) {
+				if (i != hint && std::find(candidates.begin(), candidates.end(), i) == candidates.end()) {
+					checkTriangle(i);
+				}
+			}
+		}
+
+		return best;
+	}
 }
\ No newline at end of file
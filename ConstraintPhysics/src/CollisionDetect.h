@@ -68,16 +68,53 @@ namespace phyz {
 	inline ExtremaInfo recenter(const ExtremaInfo& info, double old_ref_value, double new_ref_value);
 	inline ExtremaInfo findExtrema(const Polyhedron& c, mthz::Vec3 axis);
 	Manifold detectCollision(const ConvexPrimitive& a, const ConvexPrimitive& b);
+	//b is brought into a's coordinates by b_rot and b_trans before testing, the returned manifold is in a's coordinates
+	Manifold detectCollision(const ConvexPrimitive& a, const ConvexPrimitive& b, const mthz::Mat3& b_rot, mthz::Vec3 b_trans);
 	std::vector<Manifold> detectCollision(const ConvexPrimitive& a, AABB a_aabb, const StaticMeshGeometry& b, mthz::Vec3 b_world_position, mthz::Quaternion b_world_orientation);
 	std::vector<Manifold> detectCollision(const StaticMeshGeometry& a, mthz::Vec3 a_world_position, mthz::Quaternion a_world_orientation, const ConvexPrimitive& b, AABB b_aabb);
 
+	struct DistanceInfo {
+		bool found;
+		double distance; //negative penetration depth if the shapes overlap
+		mthz::Vec3 a_point;
+		mthz::Vec3 b_point;
+		mthz::Vec3 normal; //facing away from a
+	};
+
+	//remembered between distance queries of the same pair of primitives. The last separating direction seeds GJK, and the
+	//support features of the last query are where the support search of polyhedra starts hill climbing from.
+	struct SimplexCache {
+		SimplexCache() : last_dir(1, 0, 0), a_support_hint(0), b_support_hint(0) {}
+
+		mthz::Vec3 last_dir;
+		int a_support_hint;
+		int b_support_hint;
+	};
+
+	struct MeshDistanceCache {
+		MeshDistanceCache() : triangle_hint(-1) {}
+
+		int triangle_hint;
+		SimplexCache simplex;
+	};
+
+	DistanceInfo computeDistance(const ConvexPrimitive& a, const ConvexPrimitive& b, SimplexCache* cache=nullptr);
+	DistanceInfo computeDistance(const ConvexPrimitive& a, AABB a_aabb, const StaticMeshGeometry& b, mthz::Vec3 b_world_position, mthz::Quaternion b_world_orientation, MeshDistanceCache* cache=nullptr);
+
 }
 
 //providing hash function for MagicID
 namespace std {
   template <> struct hash<phyz::MagicID> {
 		inline size_t operator()(const phyz::MagicID& key) const {
-			return key.cID * key.bID;
+			//mixes every bit of both ids. Contacts between the same two shapes share cID, so it can't be left to the low bits
+			uint64_t h = key.cID * 0x9E3779B97F4A7C15ull ^ key.bID;
+			h ^= h >> 33;
+			h *= 0xFF51AFD7ED558CCDull;
+			h ^= h >> 33;
+			h *= 0xC4CEB9FE1A85EC53ull;
+			h ^= h >> 33;
+			return h;
 		}
 	};
 }
\ No newline at end of file
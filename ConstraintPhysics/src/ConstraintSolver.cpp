@@ -1,11 +1,12 @@
 #include "ConstraintSolver.h"
 #include "PhysicsEngine.h"
-#include <unordered_map>
 #include <cassert>
 
 #define NDEBUG
 
 #include <chrono>
+#include <algorithm>
+#include <limits>
 
 namespace phyz {
 
@@ -14,177 +15,1148 @@ namespace phyz {
 
 	static mthz::NVec<6> velAngToNVec(mthz::Vec3 vel, mthz::Vec3 ang_vel);
 
+	//largest component of an impulse change, which is how the solver measures its residual. Changes small enough for NVec::isZero count as none
 	template<int n>
-	static void PGSConstraintStep(DegreedConstraint<n>* constraint, bool use_psuedo_values) {
+	static inline double impulseChange(const mthz::NVec<n>& impulse_diff) {
+		if (impulse_diff.isZero()) return 0;
+		double out = 0;
+		for (int i = 0; i < n; i++) out = std::max<double>(out, abs(impulse_diff.v[i]));
+		return out;
+	}
+
+	template<int n>
+	static double PGSConstraintStep(DegreedConstraint<n>* constraint, SolverBodies* solver_bodies, bool use_psuedo_values) {
 		mthz::NVec<6>* vel_a_change, *vel_b_change;
 		mthz::NVec<n>* accumulated_impulse;
 		mthz::NVec<n> target_val;
 		if (use_psuedo_values) {
-			vel_a_change = constraint->a_psuedo_velocity_change;
-			vel_b_change = constraint->b_psuedo_velocity_change;
+			vel_a_change = &solver_bodies->psuedo_velocity_changes[constraint->a_solver_index];
+			vel_b_change = &solver_bodies->psuedo_velocity_changes[constraint->b_solver_index];
 			accumulated_impulse = &constraint->psuedo_impulse;
 			target_val = constraint->psuedo_target_val;
 		}
 		else {
-			vel_a_change = constraint->a_velocity_change;
-			vel_b_change = constraint->b_velocity_change;
+			vel_a_change = &solver_bodies->velocity_changes[constraint->a_solver_index];
+			vel_b_change = &solver_bodies->velocity_changes[constraint->b_solver_index];
 			accumulated_impulse = &constraint->impulse;
 			target_val = constraint->target_val;
 		}
 
 		mthz::NVec<n> current_val = constraint->getConstraintValue(*vel_a_change, *vel_b_change);
-		mthz::NVec<n> delta = target_val - current_val;
+		mthz::NVec<n> delta = target_val - current_val - constraint->compliance * (*accumulated_impulse);
 		//printf("%f\n", delta.mag());
 		//Apply projection on the accumulation, not the delta, to allow reversing overcorrection.
 		mthz::NVec<n> impulse_new = (*accumulated_impulse) + constraint->impulse_to_value_inverse * delta;
 		mthz::NVec<n> impulse_diff = constraint->isInequalityConstraint()? constraint->projectValidImpulse(impulse_new) - *accumulated_impulse
 																   : impulse_new - *accumulated_impulse;
-		if (!impulse_diff.isZero()) {
+		double change = impulseChange(impulse_diff);
+		if (change != 0) {
 			constraint->computeAndApplyVelocityChange(impulse_diff, vel_a_change, vel_b_change);
 			*accumulated_impulse += impulse_diff;
 		}
+		return change;
 	}
 
-	static void constraintStep(Constraint* c, bool pos_correct) {
+	static double constraintStep(Constraint* c, SolverBodies* solver_bodies, bool pos_correct) {
 		switch (c->getDegree()) {
-		case 1: PGSConstraintStep<1>((DegreedConstraint<1>*)c, pos_correct); break;
-		case 2: PGSConstraintStep<2>((DegreedConstraint<2>*)c, pos_correct); break;
-		case 3: PGSConstraintStep<3>((DegreedConstraint<3>*)c, pos_correct); break;
-		case 4: PGSConstraintStep<4>((DegreedConstraint<4>*)c, pos_correct); break;
-		case 5: PGSConstraintStep<5>((DegreedConstraint<5>*)c, pos_correct); break;
-		case 6: PGSConstraintStep<6>((DegreedConstraint<6>*)c, pos_correct); break;
+		case 1: return PGSConstraintStep<1>((DegreedConstraint<1>*)c, solver_bodies, pos_correct);
+		case 2: return PGSConstraintStep<2>((DegreedConstraint<2>*)c, solver_bodies, pos_correct);
+		case 3: return PGSConstraintStep<3>((DegreedConstraint<3>*)c, solver_bodies, pos_correct);
+		case 4: return PGSConstraintStep<4>((DegreedConstraint<4>*)c, solver_bodies, pos_correct);
+		case 5: return PGSConstraintStep<5>((DegreedConstraint<5>*)c, solver_bodies, pos_correct);
+		case 6: return PGSConstraintStep<6>((DegreedConstraint<6>*)c, solver_bodies, pos_correct);
 		}
+		return 0;
 	}
 
-	static int get_total_island_degree(const std::vector<Constraint*>& constraints) {
-		int sum = 0;
-		for (Constraint* c : constraints) sum += c->getDegree();
-		return sum;
+	//unprojected accumulated impulse that would bring the row to its target value
+	template<int n>
+	static inline mthz::NVec<n> rowImpulseUpdate(const SolverRow<n>& row, const mthz::NVec<6>* velocity_changes, const mthz::NVec<n>& accumulated_impulse, const mthz::NVec<n>& target_val) {
+		mthz::NVec<n> current_val = row.a_jacobian * velocity_changes[row.a_index] + row.b_jacobian * velocity_changes[row.b_index];
+		return accumulated_impulse + row.impulse_to_value_inverse * (target_val - current_val);
 	}
 
 	template<int n>
-	static void add_impulses(std::vector<double>* add_to, DegreedConstraint<n>* c, int indx, bool psuedo_velocity) {
+	static inline double applyRowImpulse(const SolverRow<n>& row, mthz::NVec<6>* velocity_changes, mthz::NVec<n>* accumulated_impulse, const mthz::NVec<n>& impulse_new) {
+		mthz::NVec<n> impulse_diff = impulse_new - *accumulated_impulse;
+		double change = impulseChange(impulse_diff);
+		if (change == 0) return 0;
+
+		//index 0, the non dynamic bodies, always stays zero. Not writing it keeps rows of the same color free of shared writes
+		if (row.a_index != 0) velocity_changes[row.a_index] += row.impulse_to_a_velocity * impulse_diff;
+		if (row.b_index != 0) velocity_changes[row.b_index] += row.impulse_to_b_velocity * impulse_diff;
+		*accumulated_impulse += impulse_diff;
+		return change;
+	}
+
+	template<int n>
+	static inline double solveJointRow(SolverRow<n>* row, SolverBodies* solver_bodies, bool use_psuedo_values) {
+		if (use_psuedo_values) {
+			if (!row->needs_pos_correct) return 0;
+			mthz::NVec<6>* velocity_changes = solver_bodies->psuedo_velocity_changes.data();
+			mthz::NVec<n> impulse_new = rowImpulseUpdate(*row, velocity_changes, row->psuedo_impulse, row->psuedo_target_val);
+			return applyRowImpulse(*row, velocity_changes, &row->psuedo_impulse, impulse_new);
+		}
+		else {
+			mthz::NVec<6>* velocity_changes = solver_bodies->velocity_changes.data();
+			mthz::NVec<n> impulse_new = rowImpulseUpdate(*row, velocity_changes, row->impulse, row->target_val);
+			return applyRowImpulse(*row, velocity_changes, &row->impulse, impulse_new);
+		}
+	}
+
+	//friction is limited to a disk whose radius scales with the normal impulse
+	static inline double solveFrictionRow(ContactRow* row, mthz::NVec<6>* velocity_changes) {
+		mthz::NVec<2> friction_new = rowImpulseUpdate(row->friction, velocity_changes, row->friction.impulse, row->friction.target_val);
+		double max_impulse_mag = row->coeff_friction * std::min<double>(row->normal_impulse_limit, row->normal.impulse.v[0]);
+		double current_impulse_mag = sqrt(friction_new.v[0] * friction_new.v[0] + friction_new.v[1] * friction_new.v[1]);
+		if (current_impulse_mag > max_impulse_mag) {
+			row->static_ready = false;
+			double r = max_impulse_mag / current_impulse_mag;
+			friction_new = mthz::NVec<2>{ friction_new.v[0] * r, friction_new.v[1] * r };
+		}
+		else {
+			row->static_ready = true;
+		}
+		return applyRowImpulse(row->friction, velocity_changes, &row->friction.impulse, friction_new);
+	}
+
+	static inline double solveContactRow(ContactRow* row, SolverBodies* solver_bodies, bool use_psuedo_values) {
+		if (use_psuedo_values) {
+			mthz::NVec<6>* velocity_changes = solver_bodies->psuedo_velocity_changes.data();
+			mthz::NVec<1> impulse_new = rowImpulseUpdate(row->normal, velocity_changes, row->normal.psuedo_impulse, row->normal.psuedo_target_val);
+			impulse_new.v[0] = std::max<double>(impulse_new.v[0], 0);
+			return applyRowImpulse(row->normal, velocity_changes, &row->normal.psuedo_impulse, impulse_new);
+		}
+
+		mthz::NVec<6>* velocity_changes = solver_bodies->velocity_changes.data();
+		mthz::NVec<1> impulse_new = rowImpulseUpdate(row->normal, velocity_changes, row->normal.impulse, row->normal.target_val);
+		impulse_new.v[0] = std::max<double>(impulse_new.v[0], 0);
+		double residual = applyRowImpulse(row->normal, velocity_changes, &row->normal.impulse, impulse_new);
+
+		if (!row->has_friction) return residual;
+		return std::max<double>(residual, solveFrictionRow(row, velocity_changes));
+	}
+
+	//impulses when exactly the contacts in set push. True if that is consistent: no pushing contact pulls and no other contact is left approaching
+	static bool solveContactSet(const ContactBlock& block, const double* q, int set, double* x) {
+		const double TOLERANCE = 0.000000001;
+		int n = block.n_contacts;
+		int pushing[ContactBlock::MAX_CONTACTS];
+		int m = 0;
 		for (int i = 0; i < n; i++) {
-			if (psuedo_velocity) add_to->at(indx + i) = c->psuedo_impulse.v[i];
-			else				 add_to->at(indx + i) = c->impulse.v[i];
+			x[i] = 0;
+			if ((set >> i) & 1) pushing[m++] = i;
+		}
+
+		//gaussian elimination with partial pivoting on K x = -q restricted to the pushing contacts
+		double system[ContactBlock::MAX_CONTACTS][ContactBlock::MAX_CONTACTS + 1];
+		for (int r = 0; r < m; r++) {
+			for (int c = 0; c < m; c++) system[r][c] = block.impulse_to_value[pushing[r]][pushing[c]];
+			system[r][m] = -q[pushing[r]];
 		}
+		for (int c = 0; c < m; c++) {
+			int pivot = c;
+			for (int r = c + 1; r < m; r++) {
+				if (abs(system[r][c]) > abs(system[pivot][c])) pivot = r;
+			}
+			if (abs(system[pivot][c]) <= TOLERANCE * block.impulse_to_value[pushing[c]][pushing[c]]) return false;
+			if (pivot != c) {
+				for (int k = c; k <= m; k++) std::swap(system[c][k], system[pivot][k]);
+			}
+			for (int r = c + 1; r < m; r++) {
+				double f = system[r][c] / system[c][c];
+				for (int k = c; k <= m; k++) system[r][k] -= f * system[c][k];
+			}
+		}
+		for (int r = m - 1; r >= 0; r--) {
+			double v = system[r][m];
+			for (int k = r + 1; k < m; k++) v -= system[r][k] * x[pushing[k]];
+			v /= system[r][r];
+			if (v < -TOLERANCE) return false;
+			x[pushing[r]] = std::max<double>(v, 0);
+		}
+
+		for (int i = 0; i < n; i++) {
+			if ((set >> i) & 1) continue;
+			double w = q[i];
+			for (int r = 0; r < m; r++) w += block.impulse_to_value[i][pushing[r]] * x[pushing[r]];
+			if (w < -TOLERANCE) return false;
+		}
+		return true;
 	}
 
-	static void write_all_impulses(const std::vector<Constraint*>& constraints, std::vector<double>* out, bool psuedo_velocity) {
-		assert(out->size() == get_total_island_degree(constraints));
-		int indx = 0;
+	//normal rows of a block solved exactly as a small LCP. Writing w = Kx + q for how far each row's value is past its target once the
+	//accumulated impulses are x, this finds the set of pushing contacts where x >= 0, w >= 0 and only one of each pair is non zero
+	static double solveContactBlock(SolverRows* rows, const ContactBlock& block, SolverBodies* solver_bodies, bool use_psuedo_values) {
+		ContactRow* contacts = rows->contacts.data() + block.first;
+		int n = block.n_contacts;
+		if (n == 1) return solveContactRow(contacts, solver_bodies, use_psuedo_values);
 
-		for (Constraint* c : constraints) {
-			switch (c->getDegree()) {
-			case 1: add_impulses(out, (DegreedConstraint<1>*)c, indx, psuedo_velocity); indx += 1; break;
-			case 2: add_impulses(out, (DegreedConstraint<2>*)c, indx, psuedo_velocity); indx += 2; break;
-			case 3: add_impulses(out, (DegreedConstraint<3>*)c, indx, psuedo_velocity); indx += 3; break;
-			case 4: add_impulses(out, (DegreedConstraint<4>*)c, indx, psuedo_velocity); indx += 4; break;
-			case 5: add_impulses(out, (DegreedConstraint<5>*)c, indx, psuedo_velocity); indx += 5; break;
-			case 6: add_impulses(out, (DegreedConstraint<6>*)c, indx, psuedo_velocity); indx += 6; break;
+		mthz::NVec<6>* velocity_changes = use_psuedo_values ? solver_bodies->psuedo_velocity_changes.data() : solver_bodies->velocity_changes.data();
+		double q[ContactBlock::MAX_CONTACTS];
+		double accumulated[ContactBlock::MAX_CONTACTS];
+		for (int i = 0; i < n; i++) {
+			const SolverRow<1>& row = contacts[i].normal;
+			double current_val = (row.a_jacobian * velocity_changes[row.a_index] + row.b_jacobian * velocity_changes[row.b_index]).v[0];
+			q[i] = current_val - (use_psuedo_values ? row.psuedo_target_val.v[0] : row.target_val.v[0]);
+			accumulated[i] = use_psuedo_values ? row.psuedo_impulse.v[0] : row.impulse.v[0];
+		}
+		for (int i = 0; i < n; i++) {
+			for (int j = 0; j < n; j++) q[i] -= block.impulse_to_value[i][j] * accumulated[j];
+		}
+
+		//the contacts pushing now are usually the answer, otherwise try every set of pushing contacts, largest first.
+		//Only a degenerate manifold has no consistent set
+		int current_set = 0;
+		for (int i = 0; i < n; i++) {
+			if (accumulated[i] > 0) current_set |= 1 << i;
+		}
+		double x[ContactBlock::MAX_CONTACTS];
+		bool solved = solveContactSet(block, q, current_set, x);
+		for (int n_pushing = n; n_pushing >= 0 && !solved; n_pushing--) {
+			for (int set = (1 << n) - 1; set >= 0 && !solved; set--) {
+				int set_size = 0;
+				for (int i = 0; i < n; i++) set_size += (set >> i) & 1;
+				if (set_size == n_pushing) solved = solveContactSet(block, q, set, x);
 			}
 		}
+
+		double residual = 0;
+		if (solved) {
+			for (int i = 0; i < n; i++) {
+				SolverRow<1>& row = contacts[i].normal;
+				residual = std::max<double>(residual, applyRowImpulse(row, velocity_changes, use_psuedo_values ? &row.psuedo_impulse : &row.impulse, mthz::NVec<1>{ x[i] }));
+			}
+			if (!use_psuedo_values) {
+				for (int i = 0; i < n; i++) {
+					if (contacts[i].has_friction) residual = std::max<double>(residual, solveFrictionRow(&contacts[i], velocity_changes));
+				}
+			}
+		}
+		else {
+			for (int i = 0; i < n; i++) {
+				residual = std::max<double>(residual, solveContactRow(&contacts[i], solver_bodies, use_psuedo_values));
+			}
+		}
+		return residual;
 	}
 
-	static bool checkIfConverged(const std::vector<Constraint*>& constraints, const std::vector<double>& old_impulses, std::vector<double>* new_impulses, bool psuedo_velocity) {
-		write_all_impulses(constraints, new_impulses, psuedo_velocity);
+	template<int n>
+	static double solveJointRows(std::vector<SolverRow<n>>* rows, SolverBodies* solver_bodies, bool use_psuedo_values, bool skip_holonomic_system_rows) {
+		double residual = 0;
+		for (SolverRow<n>& row : *rows) {
+			if (skip_holonomic_system_rows && row.is_in_holonomic_system) continue;
+			residual = std::max<double>(residual, solveJointRow(&row, solver_bodies, use_psuedo_values));
+		}
+		return residual;
+	}
 
-		double total_delta = 0;
-		for (int i = 0; i < old_impulses.size(); i++) {
-			double di = new_impulses->at(i) - old_impulses[i];
-			total_delta += di * di;
+	static double solveGenericRows(SolverRows* rows, SolverBodies* solver_bodies, bool use_psuedo_values, bool skip_holonomic_system_rows) {
+		double residual = 0;
+		for (Constraint* c : rows->generic) {
+			if (skip_holonomic_system_rows && c->is_in_holonomic_system) continue;
+			if (use_psuedo_values && !c->needsPosCorrect()) continue;
+			residual = std::max<double>(residual, constraintStep(c, solver_bodies, use_psuedo_values));
 		}
-		return total_delta == 0;
+		return residual;
 	}
 
-	//Projected Gauss-Seidel solver, see Iterative Dynamics with Temporal Coherence by Erin Catto 
-	//the first third of this video explains it pretty well: https://www.youtube.com/watch?v=P-WP1yMOkc4 (Improving an Iterative Physics Solver Using a Direct Method)
-	void PGS_solve(PhysicsEngine* pEngine, const std::vector<Constraint*>& constraints, const std::vector<HolonomicSystem*>& holonomic_systems, double holonomic_block_solver_CFM, int n_itr_vel, int n_itr_pos, int n_itr_holonomic, ThreadManager::JobStatus* compute_inverse_status) {
-		auto t0 = std::chrono::system_clock::now();
-		
-		struct VelPair {
-			VelPair() : velocity_change({0.0}), psuedo_vel_change({0.0}) {} //initialize zeroed out
-			mthz::NVec<6> velocity_change;
-			mthz::NVec<6> psuedo_vel_change;
-		};
+	template<int n>
+	static double solveArticulatedRow(SolverRows* rows, const SolverRows::ArticulatedRow& row, bool use_psuedo_values) {
+		DegreedConstraint<n>* c = (DegreedConstraint<n>*)row.source;
+		if (use_psuedo_values && !c->needsPosCorrect()) return 0;
+		const double* values = rows->articulated_values.data();
+
+		mthz::NVec<n> current_val;
+		for (int s = 0; s < row.n_sides; s++) {
+			const SolverRows::ArticulatedRow::Side& side = row.sides[s];
+			const double* velocity_change = use_psuedo_values ? side.psuedo_velocity_change : side.velocity_change;
+			const double* jacobian = values + side.values;
+			for (int r = 0; r < n; r++) {
+				for (int k = 0; k < side.n_velocities; k++) current_val.v[r] += jacobian[r * side.n_velocities + k] * velocity_change[k];
+			}
+		}
 
-		std::unordered_map<RigidBody*, VelPair*> velocity_changes;
+		mthz::NVec<n>* accumulated_impulse = use_psuedo_values ? &c->psuedo_impulse : &c->impulse;
+		mthz::NVec<n> delta = (use_psuedo_values ? c->psuedo_target_val : c->target_val) - current_val - c->compliance * (*accumulated_impulse);
+		const double* impulse_to_value_inverse = values + row.impulse_to_value_inverse;
+		mthz::NVec<n> impulse_new = *accumulated_impulse;
+		for (int r = 0; r < n; r++) {
+			for (int k = 0; k < n; k++) impulse_new.v[r] += impulse_to_value_inverse[r * n + k] * delta.v[k];
+		}
+		mthz::NVec<n> impulse_diff = (c->isInequalityConstraint() ? c->projectValidImpulse(impulse_new) : impulse_new) - *accumulated_impulse;
+		double change = impulseChange(impulse_diff);
+		if (change == 0) return 0;
+
+		for (int s = 0; s < row.n_sides; s++) {
+			const SolverRows::ArticulatedRow::Side& side = row.sides[s];
+			double* velocity_change = use_psuedo_values ? side.psuedo_velocity_change : side.velocity_change;
+			const double* response = values + side.values + n * side.n_velocities;
+			for (int r = 0; r < n; r++) {
+				for (int k = 0; k < side.n_velocities; k++) velocity_change[k] += response[r * side.n_velocities + k] * impulse_diff.v[r];
+			}
+		}
+		*accumulated_impulse += impulse_diff;
+		return change;
+	}
 
-		for (Constraint* c : constraints) {
+	static double solveArticulatedRows(SolverRows* rows, bool use_psuedo_values) {
+		double residual = 0;
+		for (const SolverRows::ArticulatedRow& row : rows->articulated) {
+			double change = 0;
+			switch (row.degree) {
+			case 1: change = solveArticulatedRow<1>(rows, row, use_psuedo_values); break;
+			case 2: change = solveArticulatedRow<2>(rows, row, use_psuedo_values); break;
+			case 3: change = solveArticulatedRow<3>(rows, row, use_psuedo_values); break;
+			case 4: change = solveArticulatedRow<4>(rows, row, use_psuedo_values); break;
+			case 5: change = solveArticulatedRow<5>(rows, row, use_psuedo_values); break;
+			case 6: change = solveArticulatedRow<6>(rows, row, use_psuedo_values); break;
+			}
+			residual = std::max<double>(residual, change);
+		}
+		return residual;
+	}
 
-			VelPair* vA = nullptr; VelPair* vB = nullptr;
-			if (velocity_changes.find(c->a) == velocity_changes.end()) {
-				vA = new VelPair();
-				velocity_changes[c->a] = vA;
+	//one Gauss-Seidel sweep over every row of the island. Returns the largest impulse change of the sweep, 0 if nothing changed
+	static double solveRows(SolverRows* rows, SolverBodies* solver_bodies, bool use_psuedo_values, bool skip_holonomic_system_rows) {
+		double residual = 0;
+		residual = std::max<double>(residual, solveJointRows(&rows->joints<1>(), solver_bodies, use_psuedo_values, skip_holonomic_system_rows));
+		residual = std::max<double>(residual, solveJointRows(&rows->joints<2>(), solver_bodies, use_psuedo_values, skip_holonomic_system_rows));
+		residual = std::max<double>(residual, solveJointRows(&rows->joints<3>(), solver_bodies, use_psuedo_values, skip_holonomic_system_rows));
+		residual = std::max<double>(residual, solveJointRows(&rows->joints<4>(), solver_bodies, use_psuedo_values, skip_holonomic_system_rows));
+		residual = std::max<double>(residual, solveJointRows(&rows->joints<5>(), solver_bodies, use_psuedo_values, skip_holonomic_system_rows));
+		residual = std::max<double>(residual, solveJointRows(&rows->joints<6>(), solver_bodies, use_psuedo_values, skip_holonomic_system_rows));
+		residual = std::max<double>(residual, solveGenericRows(rows, solver_bodies, use_psuedo_values, skip_holonomic_system_rows));
+		if (rows->use_contact_blocks) {
+			for (const ContactBlock& block : rows->contact_blocks) {
+				residual = std::max<double>(residual, solveContactBlock(rows, block, solver_bodies, use_psuedo_values));
 			}
-			else {
-				vA = velocity_changes[c->a];
+		}
+		else if (rows->use_contact_batches) {
+			mthz::NVec<6>* velocity_changes = use_psuedo_values ? solver_bodies->psuedo_velocity_changes.data() : solver_bodies->velocity_changes.data();
+			for (ContactRowBatch& batch : rows->contact_batches) {
+				residual = std::max<double>(residual, solveContactBatch(&batch, velocity_changes, use_psuedo_values));
 			}
-			if (velocity_changes.find(c->b) == velocity_changes.end()) {
-				vB = new VelPair();
-				velocity_changes[c->b] = vB;
+		}
+		else {
+			for (ContactRow& row : rows->contacts) {
+				residual = std::max<double>(residual, solveContactRow(&row, solver_bodies, use_psuedo_values));
+			}
+		}
+		residual = std::max<double>(residual, solveArticulatedRows(rows, use_psuedo_values));
+		return residual;
+	}
+
+	static double solveRow(SolverRows* rows, SolverRows::RowRef ref, SolverBodies* solver_bodies, bool use_psuedo_values) {
+		switch (ref.degree) {
+		case -2: return solveContactBlock(rows, rows->contact_blocks[ref.index], solver_bodies, use_psuedo_values);
+		case -1: return solveContactBatch(&rows->contact_batches[ref.index], use_psuedo_values ? solver_bodies->psuedo_velocity_changes.data() : solver_bodies->velocity_changes.data(), use_psuedo_values);
+		case 0: return solveContactRow(&rows->contacts[ref.index], solver_bodies, use_psuedo_values);
+		case 1: return solveJointRow(&rows->joints<1>()[ref.index], solver_bodies, use_psuedo_values);
+		case 2: return solveJointRow(&rows->joints<2>()[ref.index], solver_bodies, use_psuedo_values);
+		case 3: return solveJointRow(&rows->joints<3>()[ref.index], solver_bodies, use_psuedo_values);
+		case 4: return solveJointRow(&rows->joints<4>()[ref.index], solver_bodies, use_psuedo_values);
+		case 5: return solveJointRow(&rows->joints<5>()[ref.index], solver_bodies, use_psuedo_values);
+		case 6: return solveJointRow(&rows->joints<6>()[ref.index], solver_bodies, use_psuedo_values);
+		}
+		return 0;
+	}
+
+	//sweep in color order. Rows of one color share no dynamic body so the order they are solved in, and which thread solves them, doesn't change the result
+	static double solveRowsColored(SolverRows* rows, SolverBodies* solver_bodies, bool use_psuedo_values, const SolverThreads* colored_solve) {
+		std::atomic<double> residual = 0;
+		for (int c = 0; c < rows->n_colors; c++) {
+			const SolverRows::RowColor& color = rows->colors[c];
+			auto solve_chunk = [&](int begin) {
+				int end = std::min<int>(begin + SolverRows::COLOR_CHUNK_SIZE, color.rows.size());
+				double chunk_residual = 0;
+				for (int i = begin; i < end; i++) {
+					chunk_residual = std::max<double>(chunk_residual, solveRow(rows, color.rows[i], solver_bodies, use_psuedo_values));
+				}
+				double prev = residual.load();
+				while (chunk_residual > prev && !residual.compare_exchange_weak(prev, chunk_residual));
+			};
+
+			if (colored_solve->thread_manager != nullptr && !color.conflicting && color.chunk_begins.size() > 1) {
+				colored_solve->thread_manager->do_all(colored_solve->n_threads, color.chunk_begins, solve_chunk);
 			}
 			else {
-				vB = velocity_changes[c->b];
+				for (int begin : color.chunk_begins) solve_chunk(begin);
 			}
-			c->a_velocity_change = &vA->velocity_change;
-			c->a_psuedo_velocity_change = &vA->psuedo_vel_change;
-			c->b_velocity_change = &vB->velocity_change;
-			c->b_psuedo_velocity_change = &vB->psuedo_vel_change;
 		}
 
-		//apply warm starting
+		double single_thread_residual = std::max<double>(solveGenericRows(rows, solver_bodies, use_psuedo_values, false), solveArticulatedRows(rows, use_psuedo_values));
+		return std::max<double>(residual.load(), single_thread_residual);
+	}
+
+	template<int n>
+	static void readRow(SolverRow<n>* row, DegreedConstraint<n>* c) {
+		row->source = c;
+		row->a_index = c->a_solver_index;
+		row->b_index = c->b_solver_index;
+		row->needs_pos_correct = c->needsPosCorrect();
+		row->is_in_holonomic_system = c->is_in_holonomic_system;
+		row->impulse = c->impulse;
+		row->psuedo_impulse = c->psuedo_impulse;
+		row->target_val = c->target_val;
+		row->psuedo_target_val = c->psuedo_target_val;
+		row->a_jacobian = c->a_jacobian.template cast<solver_real>();
+		row->b_jacobian = c->b_jacobian.template cast<solver_real>();
+		row->impulse_to_a_velocity = c->impulse_to_a_velocity.template cast<solver_real>();
+		row->impulse_to_b_velocity = c->impulse_to_b_velocity.template cast<solver_real>();
+		row->impulse_to_value_inverse = c->impulse_to_value_inverse.template cast<solver_real>();
+	}
+
+	template<int n>
+	static void readJointRow(SolverRows* rows, Constraint* c) {
+		rows->joints<n>().emplace_back();
+		readRow(&rows->joints<n>().back(), (DegreedConstraint<n>*)c);
+	}
+
+	void SolverRows::gather(const std::vector<Constraint*>& constraints) {
+		contacts.clear();
+		joints<1>().clear(); joints<2>().clear(); joints<3>().clear();
+		joints<4>().clear(); joints<5>().clear(); joints<6>().clear();
+		generic.clear();
+		articulated_sources.clear();
+
 		for (Constraint* c : constraints) {
-			if (c->constraintWarmStarted()) {
-				c->applyWarmStartVelocityChange();
+			if (c->a->getArticulation() != nullptr || c->b->getArticulation() != nullptr) {
+				articulated_sources.push_back(c);
+				continue;
+			}
+
+			switch (c->getRowType()) {
+			case Constraint::CONTACT_ROW:
+				contacts.emplace_back();
+				readRow(&contacts.back().normal, (ContactConstraint*)c);
+				contacts.back().has_friction = false;
+				break;
+			case Constraint::FRICTION_ROW:
+			{
+				FrictionConstraint* f = (FrictionConstraint*)c;
+				//friction is always added directly after the contact it is limited by
+				assert(!contacts.empty() && !contacts.back().has_friction && f->normal_impulse == &contacts.back().normal.source->impulse);
+				ContactRow& row = contacts.back();
+				readRow(&row.friction, f);
+				row.has_friction = true;
+				row.coeff_friction = f->coeff_friction;
+				row.normal_impulse_limit = f->normal_impulse_limit;
+				row.static_ready = f->static_ready;
+				break;
+			}
+			case Constraint::JOINT_ROW:
+				switch (c->getDegree()) {
+				case 1: readJointRow<1>(this, c); break;
+				case 2: readJointRow<2>(this, c); break;
+				case 3: readJointRow<3>(this, c); break;
+				case 4: readJointRow<4>(this, c); break;
+				case 5: readJointRow<5>(this, c); break;
+				case 6: readJointRow<6>(this, c); break;
+				}
+				break;
+			case Constraint::GENERIC_ROW:
+				generic.push_back(c);
+				break;
 			}
 		}
 
-		//really need to refactor this into a class
-		int system_degree = get_total_island_degree(constraints);
-		std::vector<double> impulse_val_buff1(system_degree);
-		std::vector<double> impulse_val_buff2(system_degree);
-		std::vector<double> psuedo_impulse_val_buff1(system_degree);
-		std::vector<double> psuedo_impulse_val_buff2(system_degree);
+		if (use_contact_blocks) {
+			blockContacts();
+		}
+		else if (use_contact_batches) {
+			batchContacts();
+		}
+	}
+
+	template<int n>
+	static void readArticulatedRow(SolverRows* rows, DegreedConstraint<n>* c, SolverBodies* solver_bodies) {
+		SolverRows::ArticulatedRow row;
+		row.source = c;
+		row.degree = n;
+		row.n_sides = 0;
+		std::vector<double>& values = rows->articulated_values;
+		Articulation* a_articulation = c->a->getArticulation();
+		Articulation* b_articulation = c->b->getArticulation();
+
+		//when both bodies are links of the same articulation they make up one side
+		auto add_articulation_side = [&](Articulation* articulation) {
+			if (std::find(rows->articulations.begin(), rows->articulations.end(), articulation) == rows->articulations.end()) {
+				rows->articulations.push_back(articulation);
+				articulation->velocity_change.assign(articulation->getDegreesOfFreedom(), 0);
+				articulation->psuedo_velocity_change.assign(articulation->getDegreesOfFreedom(), 0);
+			}
+
+			SolverRows::ArticulatedRow::Side& side = row.sides[row.n_sides++];
+			int m = articulation->getDegreesOfFreedom();
+			side.velocity_change = articulation->velocity_change.data();
+			side.psuedo_velocity_change = articulation->psuedo_velocity_change.data();
+			side.n_velocities = m;
+			side.values = values.size();
+			values.resize(values.size() + 2 * n * m, 0);
+
+			double* jacobian = &values[side.values];
+			double* response = jacobian + n * m;
+			for (int r = 0; r < n; r++) {
+				if (a_articulation == articulation) {
+					mthz::Vec3 linear(c->a_jacobian.v[r][0], c->a_jacobian.v[r][1], c->a_jacobian.v[r][2]);
+					mthz::Vec3 angular(c->a_jacobian.v[r][3], c->a_jacobian.v[r][4], c->a_jacobian.v[r][5]);
+					articulation->rowJacobian(c->a, linear, angular, jacobian + r * m);
+					articulation->addLinkImpulse(c->a, linear, angular);
+				}
+				if (b_articulation == articulation) {
+					mthz::Vec3 linear(c->b_jacobian.v[r][0], c->b_jacobian.v[r][1], c->b_jacobian.v[r][2]);
+					mthz::Vec3 angular(c->b_jacobian.v[r][3], c->b_jacobian.v[r][4], c->b_jacobian.v[r][5]);
+					articulation->rowJacobian(c->b, linear, angular, jacobian + r * m);
+					articulation->addLinkImpulse(c->b, linear, angular);
+				}
+				articulation->computeImpulseResponse(response + r * m);
+			}
+		};
+
+		auto add_body_side = [&](int solver_index, const mthz::NMat<n, 6>& jacobian, const mthz::NMat<6, n>& impulse_to_velocity) {
+			//index 0, the non dynamic bodies, has no velocity to change
+			if (solver_index == 0) return;
+			SolverRows::ArticulatedRow::Side& side = row.sides[row.n_sides++];
+			side.velocity_change = solver_bodies->velocity_changes[solver_index].v;
+			side.psuedo_velocity_change = solver_bodies->psuedo_velocity_changes[solver_index].v;
+			side.n_velocities = 6;
+			side.values = values.size();
+			for (int r = 0; r < n; r++) {
+				for (int k = 0; k < 6; k++) values.push_back(jacobian.v[r][k]);
+			}
+			for (int r = 0; r < n; r++) {
+				for (int k = 0; k < 6; k++) values.push_back(impulse_to_velocity.v[k][r]);
+			}
+		};
+
+		if (a_articulation != nullptr) add_articulation_side(a_articulation);
+		else                           add_body_side(c->a_solver_index, c->a_jacobian, c->impulse_to_a_velocity);
+		if (b_articulation != nullptr && b_articulation != a_articulation) add_articulation_side(b_articulation);
+		else if (b_articulation == nullptr)                                add_body_side(c->b_solver_index, c->b_jacobian, c->impulse_to_b_velocity);
+
+		//the constraint's own impulse_to_value is that of free bodies, only its softening carries over
+		mthz::NMat<n, n> impulse_to_value;
+		for (int s = 0; s < row.n_sides; s++) {
+			const SolverRows::ArticulatedRow::Side& side = row.sides[s];
+			const double* jacobian = &values[side.values];
+			const double* response = jacobian + n * side.n_velocities;
+			for (int r = 0; r < n; r++) {
+				for (int q = 0; q < n; q++) {
+					for (int k = 0; k < side.n_velocities; k++) impulse_to_value.v[r][q] += jacobian[r * side.n_velocities + k] * response[q * side.n_velocities + k];
+				}
+			}
+		}
+		//a row the joints barely move along, like friction along a hinge axis or a contact right below one, would take huge impulses to meet its
+		//target. It is taken out of the constraint by zeroing its values, so it never gets an impulse
+		bool solvable[n];
+		int n_solvable = 0;
+		for (int r = 0; r < n; r++) {
+			solvable[r] = impulse_to_value.v[r][r] > 0.0001 * c->impulse_to_value.v[r][r];
+			if (solvable[r]) {
+				impulse_to_value.v[r][r] = impulse_to_value.v[r][r] * (1 + c->constraint_force_mixing) + c->compliance;
+				n_solvable++;
+				continue;
+			}
+
+			c->impulse.v[r] = 0;
+			for (int s = 0; s < row.n_sides; s++) {
+				const SolverRows::ArticulatedRow::Side& side = row.sides[s];
+				double* jacobian = &values[side.values];
+				double* response = jacobian + n * side.n_velocities;
+				for (int k = 0; k < side.n_velocities; k++) {
+					jacobian[r * side.n_velocities + k] = 0;
+					response[r * side.n_velocities + k] = 0;
+				}
+			}
+			for (int q = 0; q < n; q++) {
+				impulse_to_value.v[r][q] = 0;
+				impulse_to_value.v[q][r] = 0;
+			}
+			impulse_to_value.v[r][r] = 1;
+		}
+		if (n_solvable == 0) return;
+
+		mthz::NMat<n, n> impulse_to_value_inverse = impulse_to_value.inverse();
+		for (int r = 0; r < n; r++) {
+			if (!solvable[r]) impulse_to_value_inverse.v[r][r] = 0;
+		}
+		row.impulse_to_value_inverse = values.size();
+		for (int r = 0; r < n; r++) {
+			for (int q = 0; q < n; q++) values.push_back(impulse_to_value_inverse.v[r][q]);
+		}
+
+		if (c->constraintWarmStarted()) {
+			for (int s = 0; s < row.n_sides; s++) {
+				const SolverRows::ArticulatedRow::Side& side = row.sides[s];
+				const double* response = &values[side.values] + n * side.n_velocities;
+				for (int r = 0; r < n; r++) {
+					for (int k = 0; k < side.n_velocities; k++) side.velocity_change[k] += response[r * side.n_velocities + k] * c->impulse.v[r];
+				}
+			}
+		}
+		rows->articulated.push_back(row);
+	}
+
+	void SolverRows::gatherArticulated(SolverBodies* solver_bodies) {
+		articulated.clear();
+		articulated_values.clear();
+		articulations.clear();
+
+		for (Constraint* c : articulated_sources) {
+			switch (c->getDegree()) {
+			case 1: readArticulatedRow<1>(this, (DegreedConstraint<1>*)c, solver_bodies); break;
+			case 2: readArticulatedRow<2>(this, (DegreedConstraint<2>*)c, solver_bodies); break;
+			case 3: readArticulatedRow<3>(this, (DegreedConstraint<3>*)c, solver_bodies); break;
+			case 4: readArticulatedRow<4>(this, (DegreedConstraint<4>*)c, solver_bodies); break;
+			case 5: readArticulatedRow<5>(this, (DegreedConstraint<5>*)c, solver_bodies); break;
+			case 6: readArticulatedRow<6>(this, (DegreedConstraint<6>*)c, solver_bodies); break;
+			}
+		}
+	}
+
+	static void packContactLane(ContactRowBatch* batch, const ContactRow& row, int contact_index) {
+		int l = batch->n_lanes++;
+		batch->contact_index[l] = contact_index;
+		batch->a_index[l] = row.normal.a_index;
+		batch->b_index[l] = row.normal.b_index;
+
+		for (int k = 0; k < 6; k++) {
+			batch->a_jacobian[k][l] = row.normal.a_jacobian.v[0][k];
+			batch->b_jacobian[k][l] = row.normal.b_jacobian.v[0][k];
+			batch->impulse_to_a_velocity[k][l] = row.normal.impulse_to_a_velocity.v[k][0];
+			batch->impulse_to_b_velocity[k][l] = row.normal.impulse_to_b_velocity.v[k][0];
+		}
+		batch->impulse_to_value_inverse[l] = row.normal.impulse_to_value_inverse.v[0][0];
+		batch->target_val[l] = row.normal.target_val.v[0];
+		batch->psuedo_target_val[l] = row.normal.psuedo_target_val.v[0];
+		batch->impulse[l] = row.normal.impulse.v[0];
+		batch->psuedo_impulse[l] = row.normal.psuedo_impulse.v[0];
+
+		//without friction the lane's friction values stay zeroed, giving a zero friction impulse
+		if (!row.has_friction) return;
+
+		for (int j = 0; j < 2; j++) {
+			for (int k = 0; k < 6; k++) {
+				batch->friction_a_jacobian[j][k][l] = row.friction.a_jacobian.v[j][k];
+				batch->friction_b_jacobian[j][k][l] = row.friction.b_jacobian.v[j][k];
+				batch->friction_impulse_to_a_velocity[j][k][l] = row.friction.impulse_to_a_velocity.v[k][j];
+				batch->friction_impulse_to_b_velocity[j][k][l] = row.friction.impulse_to_b_velocity.v[k][j];
+			}
+			for (int i = 0; i < 2; i++) {
+				batch->friction_impulse_to_value_inverse[j][i][l] = row.friction.impulse_to_value_inverse.v[j][i];
+			}
+			batch->friction_target_val[j][l] = row.friction.target_val.v[j];
+			batch->friction_impulse[j][l] = row.friction.impulse.v[j];
+		}
+		batch->coeff_friction[l] = row.coeff_friction;
+		batch->normal_impulse_limit[l] = row.normal_impulse_limit;
+		batch->static_ready[l] = row.static_ready ? 1 : 0;
+	}
+
+	void SolverRows::batchContacts() {
+		//contacts are greedily colored so that no two of a color share a dynamic body, then each color is cut into full batches.
+		//Contacts that don't fit in the colors get a batch to themselves
+		body_color_masks.clear();
+		for (std::vector<int>& color : contact_colors) color.clear();
+		if (contact_colors.size() < MAX_COLORS) contact_colors.resize(MAX_COLORS);
+
+		for (int i = 0; i < contacts.size(); i++) {
+			int a = contacts[i].normal.a_index;
+			int b = contacts[i].normal.b_index;
+			if (std::max<int>(a, b) >= body_color_masks.size()) body_color_masks.resize(std::max<int>(a, b) + 1, 0);
+
+			uint64_t used = body_color_masks[a] | body_color_masks[b];
+			int c = 0;
+			while (c < MAX_COLORS - 1 && (used & ((uint64_t)1 << c))) c++;
+			if (c < MAX_COLORS - 1) {
+				if (a != 0) body_color_masks[a] |= (uint64_t)1 << c;
+				if (b != 0) body_color_masks[b] |= (uint64_t)1 << c;
+			}
+			contact_colors[c].push_back(i);
+		}
+
+		contact_batches.clear();
+		for (int c = 0; c < MAX_COLORS; c++) {
+			int lanes_per_batch = (c == MAX_COLORS - 1) ? 1 : ContactRowBatch::WIDTH;
+			for (int i = 0; i < contact_colors[c].size(); i++) {
+				if (i % lanes_per_batch == 0) {
+					contact_batches.emplace_back(); //value initialized, so unused lanes are zeroed and point at index 0
+				}
+				packContactLane(&contact_batches.back(), contacts[contact_colors[c][i]], contact_colors[c][i]);
+			}
+		}
+	}
 
-		std::vector<double>* old_impulse_val_buff = &impulse_val_buff1;
-		std::vector<double>* new_impulse_val_buff = &impulse_val_buff2;
-		std::vector<double>* old_psuedo_impulse_val_buff = &psuedo_impulse_val_buff1;
-		std::vector<double>* new_psuedo_impulse_val_buff = &psuedo_impulse_val_buff2;
+	void SolverRows::blockContacts() {
+		contact_blocks.clear();
+		for (int i = 0; i < contacts.size(); i++) {
+			const SolverRow<1>& row = contacts[i].normal;
+			bool extends_block = !contact_blocks.empty() && contact_blocks.back().n_contacts < ContactBlock::MAX_CONTACTS
+				&& contacts[contact_blocks.back().first].normal.a_index == row.a_index && contacts[contact_blocks.back().first].normal.b_index == row.b_index;
+			if (!extends_block) {
+				contact_blocks.emplace_back();
+				contact_blocks.back().first = i;
+				contact_blocks.back().n_contacts = 0;
+			}
+			contact_blocks.back().n_contacts++;
+		}
 
-		write_all_impulses(constraints, old_impulse_val_buff, false);
-		write_all_impulses(constraints, old_psuedo_impulse_val_buff, true);
+		for (ContactBlock& block : contact_blocks) {
+			for (int i = 0; i < block.n_contacts; i++) {
+				const SolverRow<1>& row_i = contacts[block.first + i].normal;
+				for (int j = 0; j < block.n_contacts; j++) {
+					const SolverRow<1>& row_j = contacts[block.first + j].normal;
+					if (i == j) {
+						//keeps the constraint force mixing of the row
+						block.impulse_to_value[i][i] = 1.0 / row_i.impulse_to_value_inverse.v[0][0];
+						continue;
+					}
+
+					double k = 0;
+					for (int m = 0; m < 6; m++) {
+						k += row_i.a_jacobian.v[0][m] * row_j.impulse_to_a_velocity.v[m][0] + row_i.b_jacobian.v[0][m] * row_j.impulse_to_b_velocity.v[m][0];
+					}
+					block.impulse_to_value[i][j] = k;
+				}
+			}
+		}
+	}
 
-		for (int i = 0; i < n_itr_vel; i++) {
-			for (Constraint* c : constraints) {
-				constraintStep(c, false);
+	static const double SHOCK_MIN_NORMAL_DOT_UP = 0.7;
+
+	void SolverRows::orderContactsByHeight(const std::vector<RigidBody*>& bodies, mthz::Vec3 up) {
+		shock_order.clear();
+		for (int i = 0; i < contacts.size(); i++) {
+			const SolverRow<1>& row = contacts[i].normal;
+			//only contacts that hold one body up on another. Between bodies side by side neither is below the other
+			mthz::Vec3 normal(row.a_jacobian.v[0][0], row.a_jacobian.v[0][1], row.a_jacobian.v[0][2]);
+			if (abs(normal.dot(up)) < SHOCK_MIN_NORMAL_DOT_UP * normal.mag()) continue;
+
+			//index 0, the non dynamic bodies, is always the immovable one
+			double a_height = (row.a_index == 0) ? -std::numeric_limits<double>::infinity() : bodies[row.a_index]->getCOM().dot(up);
+			double b_height = (row.b_index == 0) ? -std::numeric_limits<double>::infinity() : bodies[row.b_index]->getCOM().dot(up);
+			bool a_is_upper = (row.b_index == 0) || (row.a_index != 0 && a_height > b_height);
+
+			//the effective mass of the row without the lower body's share. What remains of the diagonal keeps the constraint force mixing
+			const mthz::NMat<1, 6, solver_real>& lower_jacobian = a_is_upper ? row.b_jacobian : row.a_jacobian;
+			const mthz::NMat<6, 1, solver_real>& lower_impulse_to_velocity = a_is_upper ? row.impulse_to_b_velocity : row.impulse_to_a_velocity;
+			double lower_share = 0;
+			for (int k = 0; k < 6; k++) lower_share += lower_jacobian.v[0][k] * lower_impulse_to_velocity.v[k][0];
+			double upper_impulse_to_value = 1.0 / row.impulse_to_value_inverse.v[0][0] - lower_share;
+			if (upper_impulse_to_value <= 0) continue;
+
+			ShockContact s;
+			s.index = i;
+			s.upper_index = a_is_upper ? row.a_index : row.b_index;
+			s.a_is_upper = a_is_upper;
+			s.upper_height = a_is_upper ? a_height : b_height;
+			s.upper_impulse_to_value_inverse = 1.0 / upper_impulse_to_value;
+			if (contacts[i].has_friction) {
+				const SolverRow<2>& friction = contacts[i].friction;
+				mthz::NMat<2, 2> upper_friction_impulse_to_value = a_is_upper ? (friction.a_jacobian * friction.impulse_to_a_velocity).cast<double>() : (friction.b_jacobian * friction.impulse_to_b_velocity).cast<double>();
+				s.upper_friction_impulse_to_value_inverse = upper_friction_impulse_to_value.inverse();
 			}
+			shock_order.push_back(s);
+		}
 
-			bool converged = checkIfConverged(constraints, *old_impulse_val_buff, new_impulse_val_buff, false);
-			std::vector<double>* tmp = old_impulse_val_buff;
-			old_impulse_val_buff = new_impulse_val_buff;
-			new_impulse_val_buff = tmp;
+		//bodies are settled bottom up, each with all the contacts holding it up at once
+		std::sort(shock_order.begin(), shock_order.end(), [](const ShockContact& c1, const ShockContact& c2) { 
+			return (c1.upper_height != c2.upper_height) ? c1.upper_height < c2.upper_height : c1.upper_index < c2.upper_index; 
+		});
+	}
 
-			if (converged) break;
+	void SolverRows::unpackContactBatches() {
+		for (const ContactRowBatch& batch : contact_batches) {
+			for (int l = 0; l < batch.n_lanes; l++) {
+				ContactRow& row = contacts[batch.contact_index[l]];
+				row.normal.impulse.v[0] = batch.impulse[l];
+				row.normal.psuedo_impulse.v[0] = batch.psuedo_impulse[l];
+				if (row.has_friction) {
+					row.friction.impulse.v[0] = batch.friction_impulse[0][l];
+					row.friction.impulse.v[1] = batch.friction_impulse[1][l];
+					row.static_ready = batch.static_ready[l] != 0;
+				}
+			}
+		}
+	}
+
+	template<int n>
+	static void writeRows(const std::vector<SolverRow<n>>& rows, bool include_holonomic_system_rows) {
+		for (const SolverRow<n>& row : rows) {
+			if (!include_holonomic_system_rows && row.is_in_holonomic_system) continue;
+			row.source->impulse = row.impulse;
+			row.source->psuedo_impulse = row.psuedo_impulse;
 		}
+	}
 
-		for (int i = 0; i < n_itr_pos; i++) {
-			for (Constraint* c : constraints) {
-				if (c->needsPosCorrect()) constraintStep(c, true);
+	void SolverRows::scatter(bool include_holonomic_system_rows) {
+		if (use_contact_batches) {
+			unpackContactBatches();
+		}
+		for (const ContactRow& row : contacts) {
+			row.normal.source->impulse = row.normal.impulse;
+			row.normal.source->psuedo_impulse = row.normal.psuedo_impulse;
+			if (row.has_friction) {
+				FrictionConstraint* f = (FrictionConstraint*)row.friction.source;
+				f->impulse = row.friction.impulse;
+				f->psuedo_impulse = row.friction.psuedo_impulse;
+				f->static_ready = row.static_ready;
 			}
+		}
+		writeRows(joints<1>(), include_holonomic_system_rows);
+		writeRows(joints<2>(), include_holonomic_system_rows);
+		writeRows(joints<3>(), include_holonomic_system_rows);
+		writeRows(joints<4>(), include_holonomic_system_rows);
+		writeRows(joints<5>(), include_holonomic_system_rows);
+		writeRows(joints<6>(), include_holonomic_system_rows);
+	}
 
-			bool converged = checkIfConverged(constraints, *old_psuedo_impulse_val_buff, new_psuedo_impulse_val_buff, true);
-			std::vector<double>* tmp = old_psuedo_impulse_val_buff;
-			old_psuedo_impulse_val_buff = new_psuedo_impulse_val_buff;
-			new_psuedo_impulse_val_buff = tmp;
+	void SolverRows::color(int n_bodies) {
+		//bit i of a body's mask is set once one of its rows has color i. Index 0, the non dynamic bodies, is never set
+		body_color_masks.assign(n_bodies, 0);
+		if (colors.size() < MAX_COLORS) colors.resize(MAX_COLORS);
+		for (int i = 0; i < n_colors; i++) {
+			colors[i].rows.clear();
+			colors[i].chunk_begins.clear();
+		}
+		n_colors = 0;
+
+		auto add_row = [&](RowRef ref, const int* a_indices, const int* b_indices, int n_rows) {
+			uint64_t used = 0;
+			for (int i = 0; i < n_rows; i++) used |= body_color_masks[a_indices[i]] | body_color_masks[b_indices[i]];
+			int c = 0;
+			while (c < MAX_COLORS - 1 && (used & ((uint64_t)1 << c))) c++;
+			if (c < MAX_COLORS - 1) {
+				for (int i = 0; i < n_rows; i++) {
+					if (a_indices[i] != 0) body_color_masks[a_indices[i]] |= (uint64_t)1 << c;
+					if (b_indices[i] != 0) body_color_masks[b_indices[i]] |= (uint64_t)1 << c;
+				}
+			}
+			colors[c].rows.push_back(ref);
+			n_colors = std::max<int>(n_colors, c + 1);
+		};
+
+		//same order as solveRows, joints before contacts
+		for (int i = 0; i < joints<1>().size(); i++) add_row(RowRef{ 1, i }, &joints<1>()[i].a_index, &joints<1>()[i].b_index, 1);
+		for (int i = 0; i < joints<2>().size(); i++) add_row(RowRef{ 2, i }, &joints<2>()[i].a_index, &joints<2>()[i].b_index, 1);
+		for (int i = 0; i < joints<3>().size(); i++) add_row(RowRef{ 3, i }, &joints<3>()[i].a_index, &joints<3>()[i].b_index, 1);
+		for (int i = 0; i < joints<4>().size(); i++) add_row(RowRef{ 4, i }, &joints<4>()[i].a_index, &joints<4>()[i].b_index, 1);
+		for (int i = 0; i < joints<5>().size(); i++) add_row(RowRef{ 5, i }, &joints<5>()[i].a_index, &joints<5>()[i].b_index, 1);
+		for (int i = 0; i < joints<6>().size(); i++) add_row(RowRef{ 6, i }, &joints<6>()[i].a_index, &joints<6>()[i].b_index, 1);
+		if (use_contact_blocks) {
+			for (int i = 0; i < contact_blocks.size(); i++) add_row(RowRef{ -2, i }, &contacts[contact_blocks[i].first].normal.a_index, &contacts[contact_blocks[i].first].normal.b_index, 1);
+		}
+		else if (use_contact_batches) {
+			for (int i = 0; i < contact_batches.size(); i++) add_row(RowRef{ -1, i }, contact_batches[i].a_index, contact_batches[i].b_index, contact_batches[i].n_lanes);
+		}
+		else {
+			for (int i = 0; i < contacts.size(); i++) add_row(RowRef{ 0, i }, &contacts[i].normal.a_index, &contacts[i].normal.b_index, 1);
+		}
+
+		for (int i = 0; i < n_colors; i++) {
+			RowColor& color = colors[i];
+			color.conflicting = i == MAX_COLORS - 1;
+			for (int begin = 0; begin < color.rows.size(); begin += COLOR_CHUNK_SIZE) {
+				color.chunk_begins.push_back(begin);
+			}
+		}
+	}
+
+	//a substep re-estimates the position error of a row from how far the solver has moved its bodies so far, using the jacobians of the outer step.
+	//Every substep keeps the full position correction bias, psuedo_target_val, and adds the drift between where target_val should have moved the bodies
+	//by now and where they actually are, divided by the whole step_time so the correction stays soft
+	template<int n>
+	static void setSubstepTarget(SolverRow<n>* row, const mthz::NVec<6>* displacements, double elapsed, double step_time, bool use_bias) {
+		const DegreedConstraint<n>* c = row->source;
+		if (!use_bias || !row->needs_pos_correct) {
+			row->target_val = c->target_val;
+			return;
+		}
+
+		mthz::NVec<n> progress = row->a_jacobian * displacements[row->a_index] + row->b_jacobian * displacements[row->b_index];
+		for (int i = 0; i < n; i++) {
+			double drift = c->target_val.v[i] * elapsed - progress.v[i];
+			row->target_val.v[i] = c->target_val.v[i] + c->psuedo_target_val.v[i] + drift / step_time;
+		}
+	}
+
+	template<int n>
+	static void setSubstepTargets(std::vector<SolverRow<n>>* rows, const mthz::NVec<6>* displacements, double elapsed, double step_time, bool use_bias) {
+		for (SolverRow<n>& row : *rows) setSubstepTarget(&row, displacements, elapsed, step_time, use_bias);
+	}
+
+	static void setSubstepTargets(SolverRows* rows, const mthz::NVec<6>* displacements, double elapsed, double step_time, bool use_bias) {
+		setSubstepTargets(&rows->joints<1>(), displacements, elapsed, step_time, use_bias);
+		setSubstepTargets(&rows->joints<2>(), displacements, elapsed, step_time, use_bias);
+		setSubstepTargets(&rows->joints<3>(), displacements, elapsed, step_time, use_bias);
+		setSubstepTargets(&rows->joints<4>(), displacements, elapsed, step_time, use_bias);
+		setSubstepTargets(&rows->joints<5>(), displacements, elapsed, step_time, use_bias);
+		setSubstepTargets(&rows->joints<6>(), displacements, elapsed, step_time, use_bias);
+		for (ContactRow& row : rows->contacts) setSubstepTarget(&row.normal, displacements, elapsed, step_time, use_bias);
+
+		if (rows->use_contact_batches && !rows->use_contact_blocks) {
+			for (ContactRowBatch& batch : rows->contact_batches) {
+				for (int l = 0; l < batch.n_lanes; l++) batch.target_val[l] = rows->contacts[batch.contact_index[l]].normal.target_val.v[0];
+			}
+		}
+	}
 
-			if (converged) break;
+	//sub-stepped solve, see Solve Temporal Gauss-Seidel (TGS) by Macklin et al. and Erin Catto's Solver2D. Each substep is one sweep with the position
+	//error re-estimated, then the bodies are moved by their velocity over the substep. The bodies only actually move at the end of the step, so their
+	//displacements are kept in psuedo_velocity_changes and turned into the psuedo velocity that carries them there. A final sweep without the position
+	//correction removes the velocity it added, taking the place of the psuedo velocity iterations. Contacts and jacobians are those of the outer step
+	static PGSSolveStats solveSubstepped(SolverRows* rows, SolverBodies* solver_bodies, int n_substeps, double step_time, const SolverThreads* colored_solve) {
+		int n_bodies = solver_bodies->bodies.size();
+		mthz::NVec<6>* velocity_changes = solver_bodies->velocity_changes.data();
+		mthz::NVec<6>* displacements = solver_bodies->psuedo_velocity_changes.data();
+		double substep_time = step_time / n_substeps;
+
+		PGSSolveStats stats;
+		for (int s = 0; s < n_substeps; s++) {
+			setSubstepTargets(rows, displacements, s * substep_time, step_time, true);
+			stats.vel_iterations++;
+			stats.vel_residual = (colored_solve != nullptr) ? solveRowsColored(rows, solver_bodies, false, colored_solve) : solveRows(rows, solver_bodies, false, false);
+
+			for (int i = 1; i < n_bodies; i++) displacements[i] += velocity_changes[i] * substep_time;
 		}
 
+		setSubstepTargets(rows, displacements, step_time, step_time, false);
+		stats.pos_iterations++;
+		stats.pos_residual = (colored_solve != nullptr) ? solveRowsColored(rows, solver_bodies, false, colored_solve) : solveRows(rows, solver_bodies, false, false);
+
+		for (int i = 1; i < n_bodies; i++) displacements[i] = displacements[i] * (1.0 / step_time) - velocity_changes[i];
+		return stats;
+	}
+
+	//shock propagation, see Nonconvex Rigid Bodies with Stacking by Guendelman et al. Contacts are solved bottom up with only the upper body moved,
+	//so no later row can undo an earlier one. The contacts holding up one body are swept a few times on their own, friction included, as nothing
+	//after them can even out how they hold it. Momentum isn't conserved, so this is only ever the last sweep of the velocity phase, and the
+	//impulses it adds aren't kept for warm starting. Used on the psuedo velocities it pushed whole layers of brick walls out of place
+	static void solveShockPropagation(SolverRows* rows, SolverBodies* solver_bodies) {
+		const int BODY_ITERATIONS = 8;
+		mthz::NVec<6>* velocity_changes = solver_bodies->velocity_changes.data();
+		std::vector<SolverRows::ShockContact>& order = rows->shock_order;
+		for (int begin = 0; begin < order.size();) {
+			int end = begin;
+			while (end < order.size() && order[end].upper_index == order[begin].upper_index) {
+				order[end].impulse = 0;
+				order[end].friction_impulse = mthz::NVec<2>{ 0.0, 0.0 };
+				end++;
+			}
+
+			for (int itr = 0; itr < BODY_ITERATIONS; itr++) {
+				for (int i = begin; i < end; i++) {
+					SolverRows::ShockContact& s = order[i];
+					const ContactRow& contact = rows->contacts[s.index];
+					const SolverRow<1>& row = contact.normal;
+					double current_val = (row.a_jacobian * velocity_changes[row.a_index] + row.b_jacobian * velocity_changes[row.b_index]).v[0];
+					double impulse_diff = std::max<double>((row.target_val.v[0] - current_val) * s.upper_impulse_to_value_inverse, -(row.impulse.v[0] + s.impulse));
+					if (s.a_is_upper) velocity_changes[row.a_index] += row.impulse_to_a_velocity * mthz::NVec<1>{ impulse_diff };
+					else              velocity_changes[row.b_index] += row.impulse_to_b_velocity * mthz::NVec<1>{ impulse_diff };
+					s.impulse += impulse_diff;
+
+					if (!contact.has_friction) continue;
+					const SolverRow<2>& friction = contact.friction;
+					mthz::NVec<2> friction_accumulated = friction.impulse + s.friction_impulse;
+					mthz::NVec<2> friction_current_val = friction.a_jacobian * velocity_changes[friction.a_index] + friction.b_jacobian * velocity_changes[friction.b_index];
+					mthz::NVec<2> friction_new = friction_accumulated + s.upper_friction_impulse_to_value_inverse * (friction.target_val - friction_current_val);
+					double max_impulse_mag = contact.coeff_friction * std::min<double>(contact.normal_impulse_limit, row.impulse.v[0] + s.impulse);
+					double impulse_mag = sqrt(friction_new.v[0] * friction_new.v[0] + friction_new.v[1] * friction_new.v[1]);
+					if (impulse_mag > max_impulse_mag) friction_new = friction_new * (max_impulse_mag / impulse_mag);
+
+					mthz::NVec<2> friction_diff = friction_new - friction_accumulated;
+					if (s.a_is_upper) velocity_changes[friction.a_index] += friction.impulse_to_a_velocity * friction_diff;
+					else              velocity_changes[friction.b_index] += friction.impulse_to_b_velocity * friction_diff;
+					s.friction_impulse += friction_diff;
+				}
+			}
+			begin = end;
+		}
+	}
+
+	//the rows NNCG steps over, visited in the same order every time so their impulses line up with the SolverRows::nncg_ vectors
+	template<typename F>
+	static void forEachNNCGRow(SolverRows* rows, F& f) {
+		for (SolverRow<1>& row : rows->joints<1>()) f(row);
+		for (SolverRow<2>& row : rows->joints<2>()) f(row);
+		for (SolverRow<3>& row : rows->joints<3>()) f(row);
+		for (SolverRow<4>& row : rows->joints<4>()) f(row);
+		for (SolverRow<5>& row : rows->joints<5>()) f(row);
+		for (SolverRow<6>& row : rows->joints<6>()) f(row);
+		for (ContactRow& row : rows->contacts) {
+			f(row.normal);
+			if (row.has_friction) f(row.friction);
+		}
+	}
+
+	//copies the impulses to nncg_start, the point the next sweep's change is measured from
+	struct NNCGStart {
+		SolverRows* rows;
+		bool use_psuedo_values;
+		int i;
+
+		template<int n>
+		void operator()(SolverRow<n>& row) {
+			const mthz::NVec<n>& impulse = use_psuedo_values ? row.psuedo_impulse : row.impulse;
+			for (int j = 0; j < n; j++) rows->nncg_start[i++] = impulse.v[j];
+		}
+	};
+
+	//size of the change the last sweep made to the impulses
+	struct NNCGMeasure {
+		SolverRows* rows;
+		bool use_psuedo_values;
+		int i;
+		double change_sqr;
+
+		template<int n>
+		void operator()(SolverRow<n>& row) {
+			const mthz::NVec<n>& impulse = use_psuedo_values ? row.psuedo_impulse : row.impulse;
+			for (int j = 0; j < n; j++, i++) {
+				double change = impulse.v[j] - rows->nncg_start[i];
+				change_sqr += change * change;
+			}
+		}
+	};
+
+	//moves the impulses beta further along the search direction, with the velocity change that goes with it, then adds the last sweep's change to the direction
+	struct NNCGMomentum {
+		SolverRows* rows;
+		mthz::NVec<6>* velocity_changes;
+		bool use_psuedo_values;
+		double beta;
+		int i;
+
+		template<int n>
+		void operator()(SolverRow<n>& row) {
+			mthz::NVec<n>& impulse = use_psuedo_values ? row.psuedo_impulse : row.impulse;
+			mthz::NVec<n> step;
+			for (int j = 0; j < n; j++, i++) {
+				double change = impulse.v[j] - rows->nncg_start[i];
+				step.v[j] = beta * rows->nncg_direction[i];
+				rows->nncg_direction[i] = step.v[j] + change;
+				impulse.v[j] += step.v[j];
+				rows->nncg_start[i] = impulse.v[j];
+			}
+			if (beta != 0) {
+				if (row.a_index != 0) velocity_changes[row.a_index] += row.impulse_to_a_velocity * step;
+				if (row.b_index != 0) velocity_changes[row.b_index] += row.impulse_to_b_velocity * step;
+			}
+		}
+	};
+
+	static void startNNCG(SolverRows* rows, bool use_psuedo_values) {
+		int n_impulses = rows->joints<1>().size() + 2 * rows->joints<2>().size() + 3 * rows->joints<3>().size()
+			+ 4 * rows->joints<4>().size() + 5 * rows->joints<5>().size() + 6 * rows->joints<6>().size();
+		for (const ContactRow& row : rows->contacts) n_impulses += row.has_friction ? 3 : 1;
+
+		rows->nncg_start.resize(n_impulses);
+		rows->nncg_direction.assign(n_impulses, 0.0);
+		rows->nncg_change_sqr = 0;
+
+		NNCGStart start = { rows, use_psuedo_values, 0 };
+		forEachNNCGRow(rows, start);
+	}
+
+	//Nonsmooth nonlinear conjugate gradient, see A Nonsmooth Nonlinear Conjugate Gradient Method for Interactive Contact Force Problems by Silcowski et al.
+	//The change a PGS sweep makes to the impulses is treated as the residual, and the impulses are pushed further along a direction built from the
+	//changes of earlier sweeps. The direction restarts whenever a sweep changes the impulses more than the one before. Only ever followed by another
+	//sweep, which projects the impulses back onto their limits
+	static void stepNNCG(SolverRows* rows, SolverBodies* solver_bodies, bool use_psuedo_values) {
+		assert(!rows->use_contact_batches);
+		NNCGMeasure measure = { rows, use_psuedo_values, 0, 0.0 };
+		forEachNNCGRow(rows, measure);
+
+		//Fletcher-Reeves coefficient. Polak-Ribiere's is negative whenever the sweeps shrink the change at a steady rate, as PGS does, so would almost always restart
+		double beta = 0;
+		if (rows->nncg_change_sqr > 0 && measure.change_sqr < rows->nncg_change_sqr) {
+			beta = measure.change_sqr / rows->nncg_change_sqr;
+		}
+		rows->nncg_change_sqr = measure.change_sqr;
+
+		mthz::NVec<6>* velocity_changes = use_psuedo_values ? solver_bodies->psuedo_velocity_changes.data() : solver_bodies->velocity_changes.data();
+		NNCGMomentum momentum = { rows, velocity_changes, use_psuedo_values, beta, 0 };
+		forEachNNCGRow(rows, momentum);
+	}
+
+	//Projected Gauss-Seidel solver, see Iterative Dynamics with Temporal Coherence by Erin Catto 
+	//the first third of this video explains it pretty well: https://www.youtube.com/watch?v=P-WP1yMOkc4 (Improving an Iterative Physics Solver Using a Direct Method)
+	PGSSolveStats PGS_solve(PhysicsEngine* pEngine, const std::vector<Constraint*>& constraints, const std::vector<HolonomicSystem*>& holonomic_systems, const std::vector<Cable*>& cables, SolverBodies* solver_bodies, SolverRows* solver_rows, double holonomic_block_solver_CFM, 
+		int holonomic_refactor_interval, int n_itr_vel, int n_itr_pos, int n_itr_holonomic, int n_substeps, double residual_tolerance, ThreadManager::JobStatus* compute_inverse_status, const SolverThreads* colored_solve, const SolverThreads* holonomic_threads) {
+		auto t0 = std::chrono::system_clock::now();
+
+		int n_bodies = solver_bodies->bodies.size();
+		solver_bodies->velocity_changes.assign(n_bodies, mthz::NVec<6>{ 0.0 });
+		solver_bodies->psuedo_velocity_changes.assign(n_bodies, mthz::NVec<6>{ 0.0 });
+
+		mthz::NVec<6>* velocity_changes = solver_bodies->velocity_changes.data();
+		mthz::NVec<6>* psuedo_velocity_changes = solver_bodies->psuedo_velocity_changes.data();
+		for (Constraint* c : constraints) {
+			c->a_velocity_change = &velocity_changes[c->a_solver_index];
+			c->a_psuedo_velocity_change = &psuedo_velocity_changes[c->a_solver_index];
+			c->b_velocity_change = &velocity_changes[c->b_solver_index];
+			c->b_psuedo_velocity_change = &psuedo_velocity_changes[c->b_solver_index];
+		}
+
+		//apply warm starting. Rows touching an articulation are warm started as they are gathered
+		for (Constraint* c : constraints) {
+			if (c->constraintWarmStarted() && c->a->getArticulation() == nullptr && c->b->getArticulation() == nullptr) {
+				c->applyWarmStartVelocityChange();
+			}
+		}
+		for (Cable* c : cables) {
+			c->prepareSolve(solver_bodies);
+		}
+
+		solver_rows->gather(constraints);
+		solver_rows->gatherArticulated(solver_bodies);
+		if (colored_solve != nullptr) {
+			solver_rows->color(n_bodies);
+		}
+		if (solver_rows->use_shock_propagation) {
+			mthz::Vec3 gravity = pEngine->getGravity();
+			solver_rows->orderContactsByHeight(solver_bodies->bodies, gravity.mag() > 0 ? -gravity.normalize() : mthz::Vec3(0, 1, 0));
+		}
+
+		PGSSolveStats stats;
+		if (n_substeps > 1) {
+			stats = solveSubstepped(solver_rows, solver_bodies, n_substeps, pEngine->getStep_time(), colored_solve);
+		}
+		else {
+			if (solver_rows->use_nncg) startNNCG(solver_rows, false);
+			while (stats.vel_iterations < n_itr_vel) {
+				stats.vel_iterations++;
+				stats.vel_residual = (colored_solve != nullptr) ? solveRowsColored(solver_rows, solver_bodies, false, colored_solve) : solveRows(solver_rows, solver_bodies, false, false);
+				for (Cable* c : cables) c->solve(false);
+				if (stats.vel_residual <= residual_tolerance) break;
+				if (solver_rows->use_nncg && stats.vel_iterations < n_itr_vel) stepNNCG(solver_rows, solver_bodies, false);
+			}
+			if (solver_rows->use_shock_propagation) solveShockPropagation(solver_rows, solver_bodies);
+
+			if (solver_rows->use_nncg) startNNCG(solver_rows, true);
+			while (stats.pos_iterations < n_itr_pos) {
+				stats.pos_iterations++;
+				stats.pos_residual = (colored_solve != nullptr) ? solveRowsColored(solver_rows, solver_bodies, true, colored_solve) : solveRows(solver_rows, solver_bodies, true, false);
+				for (Cable* c : cables) c->solve(true);
+				if (stats.pos_residual <= residual_tolerance) break;
+				if (solver_rows->use_nncg && stats.pos_iterations < n_itr_pos) stepNNCG(solver_rows, solver_bodies, true);
+			}
+		}
+		stats.vel_converged = stats.vel_residual <= residual_tolerance;
+		stats.pos_converged = stats.pos_residual <= residual_tolerance;
+
+		//the holonomic block solver works directly on the constraints
+		solver_rows->scatter(true);
+
 		auto t1 = std::chrono::system_clock::now();
 		//printf("PGS done. Took %f milliseconds\n", 1000 * std::chrono::duration<float>(t1 - t0).count());
 
-		if (holonomic_systems.size() > 0) {
+		//substeps solve the rows of holonomic systems with the rest
+		if (holonomic_systems.size() > 0 && n_substeps == 1) {
+			ThreadManager* holonomic_thread_manager = (holonomic_threads != nullptr) ? holonomic_threads->thread_manager : nullptr;
+			int holonomic_n_threads = (holonomic_threads != nullptr) ? holonomic_threads->n_threads : 1;
+
 			bool holonomic_inverse_computed_in_parallel = compute_inverse_status != nullptr;
 			//If holonomic inverse is being computed in another thread, don't continue until it has finished
 			if (holonomic_inverse_computed_in_parallel) {
@@ -195,38 +1167,46 @@ namespace phyz {
 			}
 			else {
 				for (HolonomicSystem* h : holonomic_systems) {
-					h->computeInverse(holonomic_block_solver_CFM);
+					h->computeInverse(holonomic_block_solver_CFM, holonomic_refactor_interval, holonomic_thread_manager, holonomic_n_threads);
 				}
 			}
 
 			//apply block solver solutions for holonomic systems
 			for (int i = 0; i < n_itr_holonomic; i++) {
 				for (HolonomicSystem* h : holonomic_systems) {
-					h->computeAndApplyImpulses(true);
-					h->computeAndApplyImpulses(false);
+					h->computeAndApplyImpulses(true, holonomic_thread_manager, holonomic_n_threads);
+					h->computeAndApplyImpulses(false, holonomic_thread_manager, holonomic_n_threads);
 				}
 
-				for (Constraint* c : constraints) {
-					if (c->is_in_holonomic_system) continue;
-
-					if (c->needsPosCorrect()) constraintStep(c, true);
-					constraintStep(c, false);
+				solveRows(solver_rows, solver_bodies, true, true);
+				solveRows(solver_rows, solver_bodies, false, true);
+				for (Cable* c : cables) {
+					c->solve(true);
+					c->solve(false);
 				}
 			}
+
+			solver_rows->scatter(false);
 		}
 
-		for (const auto& kv_pair : velocity_changes) {
-			RigidBody* b = kv_pair.first;
-			VelPair* deltaV = kv_pair.second;
+		for (Articulation* a : solver_rows->articulations) {
+			a->applySolverVelocityChanges();
+		}
+
+		//index 0 is the shared slot of non dynamic bodies
+		for (int i = 1; i < n_bodies; i++) {
+			const mthz::NVec<6>& delta_v = velocity_changes[i];
+			const mthz::NVec<6>& delta_psuedo_v = psuedo_velocity_changes[i];
 
-			mthz::Vec3 linear_change(deltaV->velocity_change.v[0], deltaV->velocity_change.v[1], deltaV->velocity_change.v[2]);
-			mthz::Vec3 angular_change(deltaV->velocity_change.v[3], deltaV->velocity_change.v[4], deltaV->velocity_change.v[5]);
-			mthz::Vec3 psuedo_linear_change(deltaV->psuedo_vel_change.v[0], deltaV->psuedo_vel_change.v[1], deltaV->psuedo_vel_change.v[2]);
-			mthz::Vec3 psuedo_angular_change(deltaV->psuedo_vel_change.v[3], deltaV->psuedo_vel_change.v[4], deltaV->psuedo_vel_change.v[5]);
+			mthz::Vec3 linear_change(delta_v.v[0], delta_v.v[1], delta_v.v[2]);
+			mthz::Vec3 angular_change(delta_v.v[3], delta_v.v[4], delta_v.v[5]);
+			mthz::Vec3 psuedo_linear_change(delta_psuedo_v.v[0], delta_psuedo_v.v[1], delta_psuedo_v.v[2]);
+			mthz::Vec3 psuedo_angular_change(delta_psuedo_v.v[3], delta_psuedo_v.v[4], delta_psuedo_v.v[5]);
 
-			pEngine->applyVelocityChange(b, linear_change, angular_change, psuedo_linear_change, psuedo_angular_change);
-			delete deltaV;
+			pEngine->applyVelocityChange(solver_bodies->bodies[i], linear_change, angular_change, psuedo_linear_change, psuedo_angular_change);
 		}
+
+		return stats;
 	}
 	
 	
@@ -251,29 +1231,73 @@ namespace phyz {
 		return out;
 	}
 
+	static const mthz::Vec3 AXES[3] = { mthz::Vec3(1, 0, 0), mthz::Vec3(0, 1, 0), mthz::Vec3(0, 0, 1) };
+
+	template<int n>
+	static inline void setJacobianRow(mthz::NMat<n, 6>* jacobian, int row, mthz::Vec3 linear, mthz::Vec3 angular) {
+		jacobian->v[row][0] = linear.x;  jacobian->v[row][1] = linear.y;  jacobian->v[row][2] = linear.z;
+		jacobian->v[row][3] = angular.x; jacobian->v[row][4] = angular.y; jacobian->v[row][5] = angular.z;
+	}
+
+	//fills impulse_to_a/b_velocity, impulse_to_value and its inverse from the jacobians. Same values as going through aInvMass()/bInvMass(),
+	//but works from each body's inverse mass and 3x3 inverse tensor, and only computes the lower triangle of the symmetric impulse_to_value
+	template<int n>
+	static void computeImpulseResponse(DegreedConstraint<n>* c, double constraint_force_mixing) {
+		double a_inv_mass = c->a->getInvMass();
+		double b_inv_mass = c->b->getInvMass();
+		mthz::Mat3 Ia_inv = c->a->getInvTensor();
+		mthz::Mat3 Ib_inv = c->b->getInvTensor();
+
+		for (int i = 0; i < n; i++) {
+			mthz::Vec3 a_rot = Ia_inv * mthz::Vec3(c->a_jacobian.v[i][3], c->a_jacobian.v[i][4], c->a_jacobian.v[i][5]);
+			mthz::Vec3 b_rot = Ib_inv * mthz::Vec3(c->b_jacobian.v[i][3], c->b_jacobian.v[i][4], c->b_jacobian.v[i][5]);
+			for (int k = 0; k < 3; k++) {
+				c->impulse_to_a_velocity.v[k][i] = a_inv_mass * c->a_jacobian.v[i][k];
+				c->impulse_to_b_velocity.v[k][i] = b_inv_mass * c->b_jacobian.v[i][k];
+			}
+			c->impulse_to_a_velocity.v[3][i] = a_rot.x; c->impulse_to_a_velocity.v[4][i] = a_rot.y; c->impulse_to_a_velocity.v[5][i] = a_rot.z;
+			c->impulse_to_b_velocity.v[3][i] = b_rot.x; c->impulse_to_b_velocity.v[4][i] = b_rot.y; c->impulse_to_b_velocity.v[5][i] = b_rot.z;
+		}
+
+		for (int i = 0; i < n; i++) {
+			for (int j = 0; j <= i; j++) {
+				double a_val = 0;
+				double b_val = 0;
+				for (int k = 0; k < 6; k++) {
+					a_val += c->a_jacobian.v[i][k] * c->impulse_to_a_velocity.v[k][j];
+					b_val += c->b_jacobian.v[i][k] * c->impulse_to_b_velocity.v[k][j];
+				}
+				c->impulse_to_value.v[i][j] = a_val + b_val;
+				c->impulse_to_value.v[j][i] = a_val + b_val;
+			}
+		}
+
+		//the closed form inverses are cheaper up to 3x3
+		c->constraint_force_mixing = constraint_force_mixing;
+		mthz::NMat<n, n> softened = applyCFM(c->impulse_to_value, constraint_force_mixing);
+		if (n <= 3) c->impulse_to_value_inverse = softened.inverse();
+		else		mthz::rowMajorOrderSymmetricInverse<n>((double*)c->impulse_to_value_inverse.v, (double*)softened.v);
+	}
+
 	//******************************
 	//*****CONTACT CONSTRAINT*******
 	//******************************
 	ContactConstraint::ContactConstraint(RigidBody* a, RigidBody* b, mthz::Vec3 norm, mthz::Vec3 contact_p, double bounce, double pen_depth, double pos_correct_hardness, double constraint_force_mixing, mthz::NVec<1> warm_start_impulse, double cutoff_vel)
-		: DegreedConstraint<1>(a, b, warm_start_impulse), norm(norm), rA(contact_p - a->getCOM()), rB(contact_p - b->getCOM())
+		: DegreedConstraint<1>(a, b, warm_start_impulse)
 	{
-		rotDirA = a->getInvTensor() * norm.cross(rA);
-		rotDirB = b->getInvTensor() * norm.cross(rB);
-		{
-			mthz::NMat<3, 3> rA_skew = mthz::crossMat(rA);
-			mthz::NMat<3, 3> rB_skew = mthz::crossMat(rB);
-			mthz::NMat<1, 3> n_dot = mthz::NMat<1, 3>{ {norm.x, norm.y, norm.z} };
+		refresh(norm, contact_p, bounce, pen_depth, pos_correct_hardness, constraint_force_mixing, warm_start_impulse, cutoff_vel);
+	}
 
-			a_jacobian.copyInto(-n_dot, 0, 0);
-			a_jacobian.copyInto(n_dot * rA_skew, 0, 3);
-			b_jacobian.copyInto(n_dot, 0, 0);
-			b_jacobian.copyInto(-n_dot * rB_skew, 0, 3);
+	void ContactConstraint::refresh(mthz::Vec3 norm, mthz::Vec3 contact_p, double bounce, double pen_depth, double pos_correct_hardness, double constraint_force_mixing, mthz::NVec<1> warm_start_impulse, double cutoff_vel) {
+		impulse = warm_start_impulse;
+		psuedo_impulse = mthz::NVec<1>{ 0.0 };
+		this->norm = norm;
+		rA = contact_p - a->getCOM();
+		rB = contact_p - b->getCOM();
 
-			impulse_to_a_velocity = aInvMass() * a_jacobian.transpose();
-			impulse_to_b_velocity = bInvMass() * b_jacobian.transpose();
-		}
-		impulse_to_value = a_jacobian * impulse_to_a_velocity + b_jacobian * impulse_to_b_velocity;
-		impulse_to_value_inverse = applyCFM(impulse_to_value, constraint_force_mixing).inverse();
+		setJacobianRow(&a_jacobian, 0, -norm, norm.cross(rA));
+		setJacobianRow(&b_jacobian, 0, norm, rB.cross(norm));
+		computeImpulseResponse(this, constraint_force_mixing);
 
 		double current_val = getConstraintValue(velAngToNVec(a->getVel(), a->getAngVel()), velAngToNVec(b->getVel(), b->getAngVel())).v[0];
 		target_val = mthz::NVec<1>{ (current_val < -cutoff_vel) ? -(1 + bounce) * current_val : -current_val };
@@ -288,57 +1312,28 @@ namespace phyz {
 	//*****FRICTION CONSTRAINT******
 	//******************************
 	FrictionConstraint::FrictionConstraint(RigidBody* a, RigidBody* b, mthz::Vec3 norm, mthz::Vec3 contact_p, double coeff_friction, ContactConstraint* normal, double constraint_force_mixing, mthz::NVec<2> warm_start_impulse, mthz::Vec3 source_u, mthz::Vec3 source_w, double normal_impulse_limit)
-		: DegreedConstraint<2>(a, b, warm_start_impulse), rA(contact_p - a->getCOM()), rB(contact_p - b->getCOM()),
-		coeff_friction(coeff_friction), normal_impulse(&normal->impulse), static_ready(false), normal_impulse_limit(normal_impulse_limit)
+		: DegreedConstraint<2>(a, b, warm_start_impulse), normal_impulse(&normal->impulse), static_ready(false)
 	{
+		refresh(norm, contact_p, coeff_friction, constraint_force_mixing, warm_start_impulse, source_u, source_w, normal_impulse_limit);
+	}
+
+	void FrictionConstraint::refresh(mthz::Vec3 norm, mthz::Vec3 contact_p, double coeff_friction, double constraint_force_mixing, mthz::NVec<2> warm_start_impulse, mthz::Vec3 source_u, mthz::Vec3 source_w, double normal_impulse_limit) {
+		psuedo_impulse = mthz::NVec<2>{ 0.0 };
+		this->coeff_friction = coeff_friction;
+		this->normal_impulse_limit = normal_impulse_limit;
+		static_ready = false;
+		rA = contact_p - a->getCOM();
+		rB = contact_p - b->getCOM();
 		norm.getPerpendicularBasis(&u, &w);
 
 		impulse.v[0] = u.dot(source_u) * warm_start_impulse.v[0] + u.dot(source_w) * warm_start_impulse.v[1];
 		impulse.v[1] = w.dot(source_u) * warm_start_impulse.v[0] + w.dot(source_w) * warm_start_impulse.v[1];
 
-		mthz::Mat3 Ia_inv = a->getInvTensor();
-		mthz::Mat3 Ib_inv = b->getInvTensor();
-		mthz::Vec3 rAxU = rA.cross(u);
-		mthz::Vec3 rAxW = rA.cross(w);
-		mthz::Vec3 rBxU = rB.cross(u);
-		mthz::Vec3 rBxW = rB.cross(w);
-
-		{
-			mthz::Vec3 l = Ia_inv * rAxU;
-			mthz::Vec3 r = Ia_inv * rAxW;
-			rotDirA.v[0][0] = l.x; rotDirA.v[0][1] = r.x;
-			rotDirA.v[1][0] = l.y; rotDirA.v[1][1] = r.y;
-			rotDirA.v[2][0] = l.z; rotDirA.v[2][1] = r.z;
-		}
-		{
-			mthz::Vec3 l = Ib_inv * rBxU;
-			mthz::Vec3 r = Ib_inv * rBxW;
-			rotDirB.v[0][0] = l.x; rotDirB.v[0][1] = r.x;
-			rotDirB.v[1][0] = l.y; rotDirB.v[1][1] = r.y;
-			rotDirB.v[2][0] = l.z; rotDirB.v[2][1] = r.z;
-		}
-		{
-			mthz::NMat<1, 3> u_dot = { {u.x, u.y, u.z} };
-			mthz::NMat<1, 3> w_dot = { {w.x, w.y, w.z} };
-			mthz::NMat<3, 3> rA_skew = mthz::crossMat(rA);
-			mthz::NMat<3, 3> rB_skew = mthz::crossMat(rB);
-
-			a_jacobian.copyInto(u_dot, 0, 0);
-			a_jacobian.copyInto(-u_dot * rA_skew, 0, 3);
-			b_jacobian.copyInto(-u_dot, 0, 0);
-			b_jacobian.copyInto(u_dot * rB_skew, 0, 3);
-
-			a_jacobian.copyInto(w_dot, 1, 0);
-			a_jacobian.copyInto(-w_dot * rA_skew, 1, 3);
-			b_jacobian.copyInto(-w_dot, 1, 0);
-			b_jacobian.copyInto(w_dot * rB_skew, 1, 3);
-
-			impulse_to_a_velocity = aInvMass() * a_jacobian.transpose();
-			impulse_to_b_velocity = bInvMass() * b_jacobian.transpose();
-		}
-
-		impulse_to_value = a_jacobian * impulse_to_a_velocity + b_jacobian * impulse_to_b_velocity;
-		impulse_to_value_inverse = applyCFM(impulse_to_value, constraint_force_mixing).inverse();
+		setJacobianRow(&a_jacobian, 0, u, rA.cross(u));
+		setJacobianRow(&b_jacobian, 0, -u, u.cross(rB));
+		setJacobianRow(&a_jacobian, 1, w, rA.cross(w));
+		setJacobianRow(&b_jacobian, 1, -w, w.cross(rB));
+		computeImpulseResponse(this, constraint_force_mixing);
 
 		target_val = -getConstraintValue(velAngToNVec(a->getVel(), a->getAngVel()), velAngToNVec(b->getVel(), b->getAngVel()));
 	}
@@ -361,61 +1356,88 @@ namespace phyz {
 	//*****DISTANCE CONSTRAINT*****
 	//******************************
 	DistanceConstraint::DistanceConstraint(RigidBody* a, RigidBody* b, mthz::Vec3 attach_pos_a, mthz::Vec3 attach_pos_b, double target_distance, double pos_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<1> warm_start_impulse)
-		: DegreedConstraint<1>(a, b, warm_start_impulse), rA(attach_pos_a - a->getCOM()), rB(attach_pos_b - b->getCOM())
+		: DegreedConstraint<1>(a, b, warm_start_impulse)
 	{
+		refresh(attach_pos_a, attach_pos_b, target_distance, pos_correct_hardness, constraint_force_mixing, is_in_holonomic_system, warm_start_impulse);
+	}
+
+	void DistanceConstraint::refresh(mthz::Vec3 attach_pos_a, mthz::Vec3 attach_pos_b, double target_distance, double pos_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<1> warm_start_impulse) {
 		this->is_in_holonomic_system = is_in_holonomic_system;
-		//mthz::Mat3 inverse_inertia_mat3 = (mthz::Mat3::iden()*a->getInvMass() + mthz::Mat3::iden()*b->getInvMass() - mthz::Mat3::cross_mat(rA)*rotDirA - mthz::Mat3::cross_mat(rB)*rotDirB);
-		//inverse_inertia = applyCFM(Mat3tomthz::NMat33(inverse_inertia_mat3), constraint_force_mixing).inverse();
+		impulse = warm_start_impulse;
+		psuedo_impulse = mthz::NVec<1>{ 0.0 };
+		rA = attach_pos_a - a->getCOM();
+		rB = attach_pos_b - b->getCOM();
 
 		mthz::Vec3 diff = attach_pos_a - attach_pos_b;
-		mthz::NMat<1, 3> diff_dot = { diff.x, diff.y, diff.z };
-		mthz::NMat<3, 3> rA_skew = mthz::crossMat(rA);
-		mthz::NMat<3, 3> rB_skew = mthz::crossMat(rB);
-
-		a_jacobian.copyInto(diff_dot, 0, 0);
-		a_jacobian.copyInto(-diff_dot * rA_skew, 0, 3);
-		b_jacobian.copyInto(-diff_dot, 0, 0);
-		b_jacobian.copyInto(diff_dot * rB_skew, 0, 3);
-
-		impulse_to_a_velocity = aInvMass() * a_jacobian.transpose();
-		impulse_to_b_velocity = bInvMass() * b_jacobian.transpose();
-
-		impulse_to_value = a_jacobian * impulse_to_a_velocity + b_jacobian * impulse_to_b_velocity;
-		impulse_to_value_inverse = applyCFM(impulse_to_value, constraint_force_mixing).inverse();
-		impulse_to_value = a_jacobian * impulse_to_a_velocity + b_jacobian * impulse_to_b_velocity;
+		setJacobianRow(&a_jacobian, 0, diff, rA.cross(diff));
+		setJacobianRow(&b_jacobian, 0, -diff, diff.cross(rB));
+		computeImpulseResponse(this, constraint_force_mixing);
 
 		target_val = -getConstraintValue(velAngToNVec(a->getVel(), a->getAngVel()), velAngToNVec(b->getVel(), b->getAngVel()));
 		double error = diff.magSqrd() < 0.00001? target_distance : target_distance - diff.normalize().dot(diff);
 		psuedo_target_val = mthz::NVec<1>{ pos_correct_hardness * error };
 	}
 
+	//******************************
+	//*******SPRING CONSTRAINT******
+	//******************************
+	void SpringConstraint::refresh(mthz::Vec3 attach_pos_a, mthz::Vec3 attach_pos_b, double resting_length, double stiffness, double damping, double step_time, double constraint_force_mixing, mthz::NVec<1> warm_start_impulse) {
+		impulse = warm_start_impulse;
+		psuedo_impulse = mthz::NVec<1>{ 0.0 };
+		rA = attach_pos_a - a->getCOM();
+		rB = attach_pos_b - b->getCOM();
+
+		mthz::Vec3 diff = attach_pos_b - attach_pos_a;
+		double distance = diff.mag();
+		mthz::Vec3 dir = (distance != 0) ? diff.normalize() : mthz::Vec3(0, -1, 0);
+		setJacobianRow(&a_jacobian, 0, -dir, dir.cross(rA));
+		setJacobianRow(&b_jacobian, 0, dir, rB.cross(dir));
+		computeImpulseResponse(this, constraint_force_mixing);
+
+		//a spring oscillating faster than a quarter of the step rate is held to it. A lone spring is stable at any stiffness, but in chains the
+		//unconverged error of the other rows is fed back through the stretch and grows
+		double max_frequency = PI / (2 * step_time);
+		double max_stiffness = max_frequency * max_frequency / impulse_to_value.v[0][0];
+		stiffness = std::min<double>(stiffness, max_stiffness);
+
+		//implicit Euler on the spring force -stiffness * stretch - damping * stretch velocity, as an impulse over the step
+		double softness = step_time * (step_time * stiffness + damping);
+		if (softness == 0) {
+			compliance = 0;
+			impulse_to_value_inverse = mthz::NMat<1, 1>();
+			target_val = mthz::NVec<1>{ 0.0 };
+		}
+		else {
+			compliance = 1.0 / softness;
+			impulse_to_value_inverse.v[0][0] = 1.0 / (impulse_to_value.v[0][0] * (1 + constraint_force_mixing) + compliance);
+			double erp = step_time * stiffness / (step_time * stiffness + damping);
+			target_val = -getConstraintValue(velAngToNVec(a->getVel(), a->getAngVel()), velAngToNVec(b->getVel(), b->getAngVel()));
+			target_val.v[0] -= erp * (distance - resting_length) / step_time;
+		}
+		psuedo_target_val = mthz::NVec<1>{ 0.0 };
+	}
+
 	//******************************
 	//****BALL SOCKET CONSTRAINT****
 	//******************************
 	BallSocketConstraint::BallSocketConstraint(RigidBody* a, RigidBody* b, mthz::Vec3 socket_pos_a, mthz::Vec3 socket_pos_b, double pos_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<3> warm_start_impulse)
-		: DegreedConstraint<3>(a, b, warm_start_impulse), rA(socket_pos_a - a->getCOM()), rB(socket_pos_a - b->getCOM()), rotDirA(a->getInvTensor() * mthz::Mat3::cross_mat(rA)), rotDirB(b->getInvTensor() * mthz::Mat3::cross_mat(rB))
+		: DegreedConstraint<3>(a, b, warm_start_impulse)
 	{
-		this->is_in_holonomic_system = is_in_holonomic_system;
-		//mthz::Mat3 inverse_inertia_mat3 = (mthz::Mat3::iden()*a->getInvMass() + mthz::Mat3::iden()*b->getInvMass() - mthz::Mat3::cross_mat(rA)*rotDirA - mthz::Mat3::cross_mat(rB)*rotDirB);
-		//inverse_inertia = applyCFM(Mat3tomthz::NMat33(inverse_inertia_mat3), constraint_force_mixing).inverse();
-
-		mthz::NMat<3, 3> rA_skew = mthz::crossMat(rA);
-		mthz::NMat<3, 3> rB_skew = mthz::crossMat(rB);
-
-		a_jacobian.copyInto(mthz::idenMat<3>(), 0, 0);
-		a_jacobian.copyInto(-rA_skew, 0, 3);
-		b_jacobian.copyInto(-mthz::idenMat<3>(), 0, 0);
-		b_jacobian.copyInto(rB_skew, 0, 3);
-		
-		impulse_to_a_velocity = aInvMass() * a_jacobian.transpose();
-		impulse_to_b_velocity = bInvMass() * b_jacobian.transpose();
-
-		impulse_to_value = a_jacobian * impulse_to_a_velocity + b_jacobian * impulse_to_b_velocity;
-		impulse_to_value_inverse = applyCFM(impulse_to_value, constraint_force_mixing).inverse();
+		refresh(socket_pos_a, socket_pos_b, pos_correct_hardness, constraint_force_mixing, is_in_holonomic_system, warm_start_impulse);
+	}
 
-		mthz::Vec3 ap_vel = a->getVelOfPoint(socket_pos_a);
-		mthz::Vec3 bp_vel = b->getVelOfPoint(socket_pos_a);
-		mthz::Vec3 vel_diff = ap_vel - bp_vel;
+	void BallSocketConstraint::refresh(mthz::Vec3 socket_pos_a, mthz::Vec3 socket_pos_b, double pos_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<3> warm_start_impulse) {
+		this->is_in_holonomic_system = is_in_holonomic_system;
+		impulse = warm_start_impulse;
+		psuedo_impulse = mthz::NVec<3>{ 0.0 };
+		rA = socket_pos_a - a->getCOM();
+		rB = socket_pos_a - b->getCOM();
+
+		for (int i = 0; i < 3; i++) {
+			setJacobianRow(&a_jacobian, i, AXES[i], rA.cross(AXES[i]));
+			setJacobianRow(&b_jacobian, i, -AXES[i], AXES[i].cross(rB));
+		}
+		computeImpulseResponse(this, constraint_force_mixing);
 
 		target_val = -getConstraintValue(velAngToNVec(a->getVel(), a->getAngVel()), velAngToNVec(b->getVel(), b->getAngVel()));
 		mthz::Vec3 error = socket_pos_b - socket_pos_a;
@@ -428,80 +1450,32 @@ namespace phyz {
 	//*****HINGE CONSTRAINT*********
 	//******************************
 	HingeConstraint::HingeConstraint(RigidBody* a, RigidBody* b, mthz::Vec3 hinge_pos_a, mthz::Vec3 hinge_pos_b, mthz::Vec3 rot_axis_a, mthz::Vec3 rot_axis_b, double pos_correct_hardness, double rot_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<5> warm_start_impulse, mthz::Vec3 source_u, mthz::Vec3 source_w)
-		: DegreedConstraint<5>(a, b, warm_start_impulse), rA(hinge_pos_a - a->getCOM()), rB(hinge_pos_a - b->getCOM())
+		: DegreedConstraint<5>(a, b, warm_start_impulse)
 	{
+		refresh(hinge_pos_a, hinge_pos_b, rot_axis_a, rot_axis_b, pos_correct_hardness, rot_correct_hardness, constraint_force_mixing, is_in_holonomic_system, warm_start_impulse, source_u, source_w);
+	}
+
+	void HingeConstraint::refresh(mthz::Vec3 hinge_pos_a, mthz::Vec3 hinge_pos_b, mthz::Vec3 rot_axis_a, mthz::Vec3 rot_axis_b, double pos_correct_hardness, double rot_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<5> warm_start_impulse, mthz::Vec3 source_u, mthz::Vec3 source_w) {
 		this->is_in_holonomic_system = is_in_holonomic_system;
+		impulse = warm_start_impulse;
+		psuedo_impulse = mthz::NVec<5>{ 0.0 };
+		rA = hinge_pos_a - a->getCOM();
+		rB = hinge_pos_a - b->getCOM();
 		rot_axis_a.getPerpendicularBasis(&u, &w);
 		n = rot_axis_b;
 
 		impulse.v[3] = u.dot(source_u) * warm_start_impulse.v[3] + u.dot(source_w) * warm_start_impulse.v[4];
 		impulse.v[4] = w.dot(source_u) * warm_start_impulse.v[3] + w.dot(source_w) * warm_start_impulse.v[4];
 
-		mthz::Mat3 Ia_inv = a->getInvTensor();
-		mthz::Mat3 Ib_inv = b->getInvTensor();
-
-		mthz::Mat3 rA_skew = mthz::Mat3::cross_mat(rA);
-		mthz::Mat3 rB_skew = mthz::Mat3::cross_mat(rB);
-
-		//IMPULSE TO ROTATION MATRICES
-		{
-			mthz::NMat<3, 3> l = (Ia_inv * rA_skew).toNMat(); //left block
-			mthz::Vec3 m = Ia_inv * (n.cross(u));          //middle block
-			mthz::Vec3 r = Ia_inv * (n.cross(w));          //right block
-
-			rotDirA.copyInto(l, 0, 0);
-			rotDirA.v[0][3] = m.x; rotDirA.v[1][3] = m.y; rotDirA.v[2][3] = m.z;
-			rotDirA.v[0][4] = r.x; rotDirA.v[1][4] = r.y; rotDirA.v[2][4] = r.z;
-		}
-		{
-			mthz::NMat<3, 3> l = (Ib_inv * rB_skew).toNMat(); //left block
-			mthz::Vec3 m = Ib_inv * (n.cross(u));          //middle block
-			mthz::Vec3 r = Ib_inv * (n.cross(w));          //right block
-
-			rotDirB.copyInto(l, 0, 0);
-			rotDirB.v[0][3] = m.x; rotDirB.v[1][3] = m.y; rotDirB.v[2][3] = m.z;
-			rotDirB.v[0][4] = r.x; rotDirB.v[1][4] = r.y; rotDirB.v[2][4] = r.z;
+		for (int i = 0; i < 3; i++) {
+			setJacobianRow(&a_jacobian, i, AXES[i], rA.cross(AXES[i]));
+			setJacobianRow(&b_jacobian, i, -AXES[i], AXES[i].cross(rB));
 		}
-		
-		//INVERSE INERTIA MATRIX
-		{
-			mthz::NMat<3, 3> ul = (mthz::Mat3::iden() * a->getInvMass() + mthz::Mat3::iden() * b->getInvMass() - rA_skew * Ia_inv * rA_skew - rB_skew * Ib_inv * rB_skew).toNMat(); //upper left
-			mthz::Vec3 um = -(rA_skew * Ia_inv + rB_skew * Ib_inv) * (n.cross(u)); //upper middle
-			mthz::Vec3 ur = -(rA_skew * Ia_inv + rB_skew * Ib_inv) * (n.cross(w)); //upper right
-
-			mthz::NMat<3, 3> rA_skew_mat = rA_skew.toNMat();
-			mthz::NMat<3, 3> rB_skew_mat = rB_skew.toNMat();
-			mthz::NMat<3, 3> u_skew = mthz::crossMat(u);
-			mthz::NMat<3, 3> w_skew = mthz::crossMat(w);
-			mthz::NMat<3, 3> n_skew = mthz::crossMat(n);
-			mthz::NMat<1, 3> u_dot = mthz::NMat<1, 3>{ {u.x, u.y, u.z} };
-			mthz::NMat<1, 3> w_dot = mthz::NMat<1, 3>{ {w.x, w.y, w.z} };
-			mthz::NMat<1, 3> n_dot = mthz::NMat<1, 3>{ {n.x, n.y, n.z} };
-			mthz::NMat<1, 3> zero = mthz::NMat<1, 3>{ {0, 0, 0} };
-
-			mthz::NMat<1, 5> m = n_dot * u_skew * rotDirA - u_dot * n_skew * rotDirB; //middle row
-			mthz::NMat<1, 5> b = n_dot * w_skew * rotDirA - w_dot * n_skew * rotDirB; //bottom row
-
-			a_jacobian.copyInto(mthz::idenMat<3>(), 0, 0);
-			a_jacobian.copyInto(-rA_skew_mat, 0, 3);
-			b_jacobian.copyInto(-mthz::idenMat<3>(), 0, 0);
-			b_jacobian.copyInto(rB_skew_mat, 0, 3);
-			
-			a_jacobian.copyInto(zero, 3, 0);
-			a_jacobian.copyInto(n_dot * u_skew, 3, 3);
-			b_jacobian.copyInto(zero, 3, 0);
-			b_jacobian.copyInto(u_dot * n_skew, 3, 3);
-			a_jacobian.copyInto(zero, 4, 0);
-			a_jacobian.copyInto(n_dot * w_skew, 4, 3);
-			b_jacobian.copyInto(zero, 4, 0);
-			b_jacobian.copyInto(w_dot * n_skew, 4, 3);
-		}
-
-		impulse_to_a_velocity = aInvMass() * a_jacobian.transpose();
-		impulse_to_b_velocity = bInvMass() * b_jacobian.transpose();
-
-		impulse_to_value = a_jacobian * impulse_to_a_velocity + b_jacobian * impulse_to_b_velocity;
-		impulse_to_value_inverse = applyCFM(impulse_to_value, constraint_force_mixing).inverse();
+		setJacobianRow(&a_jacobian, 3, mthz::Vec3(), n.cross(u));
+		setJacobianRow(&b_jacobian, 3, mthz::Vec3(), u.cross(n));
+		setJacobianRow(&a_jacobian, 4, mthz::Vec3(), n.cross(w));
+		setJacobianRow(&b_jacobian, 4, mthz::Vec3(), w.cross(n));
+		computeImpulseResponse(this, constraint_force_mixing);
 
 		target_val = -getConstraintValue(velAngToNVec(a->getVel(), a->getAngVel()), velAngToNVec(b->getVel(), b->getAngVel()));
 		{
@@ -545,6 +1519,7 @@ namespace phyz {
 		impulse_to_b_velocity = bInvMass() * b_jacobian.transpose();
 
 		impulse_to_value = a_jacobian * impulse_to_a_velocity + b_jacobian * impulse_to_b_velocity;
+		this->constraint_force_mixing = constraint_force_mixing;
 		impulse_to_value_inverse = applyCFM(impulse_to_value, constraint_force_mixing).inverse();
 
 		double current_val = getConstraintValue(velAngToNVec(a->getVel(), a->getAngVel()), velAngToNVec(b->getVel(), b->getAngVel())).v[0];
@@ -566,81 +1541,54 @@ namespace phyz {
 		}
 	}
 
+	//******************************
+	//*******GEAR CONSTRAINT********
+	//******************************
+	void GearConstraint::refresh(mthz::Vec3 rot_axis_a, mthz::Vec3 axis_b, bool b_slides, double ratio, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<1> warm_start_impulse) {
+		this->is_in_holonomic_system = is_in_holonomic_system;
+		impulse = warm_start_impulse;
+		psuedo_impulse = mthz::NVec<1>{ 0.0 };
+
+		setJacobianRow(&a_jacobian, 0, mthz::Vec3(0, 0, 0), rot_axis_a * ratio);
+		if (b_slides) setJacobianRow(&b_jacobian, 0, -axis_b, mthz::Vec3(0, 0, 0));
+		else		  setJacobianRow(&b_jacobian, 0, mthz::Vec3(0, 0, 0), -axis_b);
+		computeImpulseResponse(this, constraint_force_mixing);
+
+		target_val = -getConstraintValue(velAngToNVec(a->getVel(), a->getAngVel()), velAngToNVec(b->getVel(), b->getAngVel()));
+		psuedo_target_val = mthz::NVec<1>{ 0.0 };
+	}
+
 	////******************************
 	////*****SLIDER CONSTRAINT********
 	////******************************
 	SliderConstraint::SliderConstraint(RigidBody* a, RigidBody* b, mthz::Vec3 slider_point_a, mthz::Vec3 slider_point_b, mthz::Vec3 slider_axis_a, double pos_correct_hardness, double rot_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<5> warm_start_impulse, mthz::Vec3 source_u, mthz::Vec3 source_w)
-		: DegreedConstraint<5>(a, b, warm_start_impulse), rA(slider_point_a - a->getCOM()), rB(slider_point_b - b->getCOM())
+		: DegreedConstraint<5>(a, b, warm_start_impulse)
 	{
+		refresh(slider_point_a, slider_point_b, slider_axis_a, pos_correct_hardness, rot_correct_hardness, constraint_force_mixing, is_in_holonomic_system, warm_start_impulse, source_u, source_w);
+	}
+
+	void SliderConstraint::refresh(mthz::Vec3 slider_point_a, mthz::Vec3 slider_point_b, mthz::Vec3 slider_axis_a, double pos_correct_hardness, double rot_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<5> warm_start_impulse, mthz::Vec3 source_u, mthz::Vec3 source_w) {
 		this->is_in_holonomic_system = is_in_holonomic_system;
+		impulse = warm_start_impulse;
+		psuedo_impulse = mthz::NVec<5>{ 0.0 };
+		rA = slider_point_a - a->getCOM();
+		rB = slider_point_b - b->getCOM();
 		slider_axis_a = slider_axis_a.normalize();
 		slider_axis_a.getPerpendicularBasis(&u, &w);
 
 		impulse.v[0] = u.dot(source_u) * warm_start_impulse.v[0] + u.dot(source_w) * warm_start_impulse.v[1];
 		impulse.v[1] = w.dot(source_u) * warm_start_impulse.v[0] + w.dot(source_w) * warm_start_impulse.v[1];
 
-		mthz::Mat3 Ia_inv = a->getInvTensor();
-		mthz::Mat3 Ib_inv = b->getInvTensor();
-		mthz::NMat<3, 3> Ia_inv_mat = Ia_inv.toNMat();
-		mthz::NMat<3, 3> Ib_inv_mat = Ib_inv.toNMat();
-
 		mthz::Vec3 pos_error = slider_point_a - slider_point_b;
-		mthz::Vec3 rAxU = rA.cross(u);
-		mthz::Vec3 rAxW = rA.cross(w);
-		mthz::Vec3 rBxU = rB.cross(u);
-		mthz::Vec3 rBxW = rB.cross(w);
-		mthz::Vec3 UxPe = u.cross(pos_error);
-		mthz::Vec3 WxPe = w.cross(pos_error);
-
-		//IMPULSE TO ROTATION MATRICES
-		{
-			mthz::Vec3 l = Ia_inv * (rAxU + UxPe); //left block
-			mthz::Vec3 m = Ia_inv * (rAxW + WxPe); //middle block
-
-			rotDirA.v[0][0] = l.x; rotDirA.v[0][1] = m.x;
-			rotDirA.v[1][0] = l.y; rotDirA.v[1][1] = m.y;
-			rotDirA.v[2][0] = l.z; rotDirA.v[2][1] = m.z;
-			rotDirA.copyInto(Ia_inv_mat, 0, 2);
-		}
-		{
-			mthz::Vec3 l = Ib_inv * rBxU; //left block
-			mthz::Vec3 m = Ib_inv * rBxW; //middle block
-
-			rotDirB.v[0][0] = l.x; rotDirB.v[0][1] = m.x;
-			rotDirB.v[1][0] = l.y; rotDirB.v[1][1] = m.y;
-			rotDirB.v[2][0] = l.z; rotDirB.v[2][1] = m.z;
-			rotDirB.copyInto(Ib_inv_mat, 0, 2);
-		}
-
-		//INVERSE INERTIA MATRIX
-		{
-			mthz::NMat<1, 3> u_dot = { u.x, u.y, u.z };
-			mthz::NMat<1, 3> w_dot = { w.x, w.y, w.z };
-			mthz::NMat<1, 3> Pe_dot = { pos_error.x, pos_error.y, pos_error.z };
-			mthz::NMat<3, 3> rA_skew = mthz::crossMat(rA);
-			mthz::NMat<3, 3> rB_skew = mthz::crossMat(rB);
-			mthz::NMat<3, 3> u_skew = mthz::crossMat(u);
-			mthz::NMat<3, 3> w_skew = mthz::crossMat(w);
-
-			a_jacobian.copyInto(u_dot, 0, 0);
-			a_jacobian.copyInto(-u_dot * rA_skew - Pe_dot * u_skew, 0, 3);
-			b_jacobian.copyInto(-u_dot, 0, 0);
-			b_jacobian.copyInto(u_dot * rB_skew, 0, 3);
-
-			a_jacobian.copyInto(w_dot, 1, 0);
-			a_jacobian.copyInto(-w_dot * rA_skew - Pe_dot * w_skew, 1, 3);
-			b_jacobian.copyInto(-w_dot, 1, 0);
-			b_jacobian.copyInto(w_dot * rB_skew, 1, 3);
-
-			a_jacobian.copyInto(mthz::idenMat<3>(), 2, 3);
-			b_jacobian.copyInto(-mthz::idenMat<3>(), 2, 3);
-
-			impulse_to_a_velocity = aInvMass() * a_jacobian.transpose();
-			impulse_to_b_velocity = bInvMass() * b_jacobian.transpose();
-			
-			impulse_to_value = a_jacobian * impulse_to_a_velocity + b_jacobian * impulse_to_b_velocity;
-			impulse_to_value_inverse = applyCFM(impulse_to_value, constraint_force_mixing).inverse();
+		setJacobianRow(&a_jacobian, 0, u, rA.cross(u) + u.cross(pos_error));
+		setJacobianRow(&b_jacobian, 0, -u, u.cross(rB));
+		setJacobianRow(&a_jacobian, 1, w, rA.cross(w) + w.cross(pos_error));
+		setJacobianRow(&b_jacobian, 1, -w, w.cross(rB));
+		for (int i = 0; i < 3; i++) {
+			setJacobianRow(&a_jacobian, 2 + i, mthz::Vec3(), AXES[i]);
+			setJacobianRow(&b_jacobian, 2 + i, mthz::Vec3(), -AXES[i]);
 		}
+		computeImpulseResponse(this, constraint_force_mixing);
 
 		target_val = -getConstraintValue(velAngToNVec(a->getVel(), a->getAngVel()), velAngToNVec(b->getVel(), b->getAngVel()));
 		{
@@ -679,6 +1627,7 @@ namespace phyz {
 		impulse_to_b_velocity = bInvMass() * b_jacobian.transpose();
 
 		impulse_to_value = a_jacobian * impulse_to_a_velocity + b_jacobian * impulse_to_b_velocity;
+		this->constraint_force_mixing = constraint_force_mixing;
 		impulse_to_value_inverse = applyCFM(impulse_to_value, constraint_force_mixing).inverse();
 
 		double current_val = getConstraintValue(velAngToNVec(a->getVel(), a->getAngVel()), velAngToNVec(b->getVel(), b->getAngVel())).v[0];
@@ -722,6 +1671,7 @@ namespace phyz {
 		impulse_to_b_velocity = bInvMass() * b_jacobian.transpose();
 
 		impulse_to_value = a_jacobian * impulse_to_a_velocity + b_jacobian * impulse_to_b_velocity;
+		this->constraint_force_mixing = constraint_force_mixing;
 		impulse_to_value_inverse = applyCFM(impulse_to_value, constraint_force_mixing).inverse();
 
 		double current_val = getConstraintValue(velAngToNVec(a->getVel(), a->getAngVel()), velAngToNVec(b->getVel(), b->getAngVel())).v[0];
@@ -739,72 +1689,33 @@ namespace phyz {
 	//***SLIDING HINGE CONSTRAINT***
 	//******************************
 	SlidingHingeConstraint::SlidingHingeConstraint(RigidBody* a, RigidBody* b, mthz::Vec3 slide_pos_a, mthz::Vec3 slide_pos_b, mthz::Vec3 rot_axis_a, mthz::Vec3 rot_axis_b, double pos_correct_hardness, double rot_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<4> warm_start_impulse, mthz::Vec3 source_u, mthz::Vec3 source_w)
-		: DegreedConstraint<4>(a, b, warm_start_impulse), rA(slide_pos_a - a->getCOM()), rB(slide_pos_b - b->getCOM())
+		: DegreedConstraint<4>(a, b, warm_start_impulse)
 	{
+		refresh(slide_pos_a, slide_pos_b, rot_axis_a, rot_axis_b, pos_correct_hardness, rot_correct_hardness, constraint_force_mixing, is_in_holonomic_system, warm_start_impulse, source_u, source_w);
+	}
+
+	void SlidingHingeConstraint::refresh(mthz::Vec3 slide_pos_a, mthz::Vec3 slide_pos_b, mthz::Vec3 rot_axis_a, mthz::Vec3 rot_axis_b, double pos_correct_hardness, double rot_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<4> warm_start_impulse, mthz::Vec3 source_u, mthz::Vec3 source_w) {
 		this->is_in_holonomic_system = is_in_holonomic_system;
+		impulse = warm_start_impulse;
+		psuedo_impulse = mthz::NVec<4>{ 0.0 };
+		rA = slide_pos_a - a->getCOM();
+		rB = slide_pos_b - b->getCOM();
 		rot_axis_b.getPerpendicularBasis(&u, &w);
 		n = rot_axis_a;
 
 		impulse.v[2] = u.dot(source_u) * warm_start_impulse.v[2] + u.dot(source_w) * warm_start_impulse.v[3];
 		impulse.v[3] = w.dot(source_u) * warm_start_impulse.v[2] + w.dot(source_w) * warm_start_impulse.v[3];
 
-		mthz::Mat3 Ia_inv = a->getInvTensor();
-		mthz::Mat3 Ib_inv = b->getInvTensor();
-
-		mthz::Mat3 rA_skew = mthz::Mat3::cross_mat(rA);
-		mthz::Mat3 rB_skew = mthz::Mat3::cross_mat(rB);
-
 		mthz::Vec3 pos_diff = slide_pos_a - slide_pos_b;
-
-		//IMPULSE TO ROTATION MATRICES
-		{
-			mthz::Vec3 l = -Ia_inv * (u.cross(rA));		//left block
-			mthz::Vec3 lm = -Ia_inv * (w.cross(rA));    //left middle block
-			mthz::Vec3 rm = -Ia_inv * (u.cross(n));     //left middle block
-			mthz::Vec3 r = -Ia_inv * (w.cross(n));      //right block
-
-			rotDirA.v[0][0] = l.x; rotDirA.v[0][1] = lm.x; rotDirA.v[0][2] = rm.x; rotDirA.v[0][3] = r.x;
-			rotDirA.v[1][0] = l.y; rotDirA.v[1][1] = lm.y; rotDirA.v[1][2] = rm.y; rotDirA.v[1][3] = r.y;
-			rotDirA.v[2][0] = l.z; rotDirA.v[2][1] = lm.z; rotDirA.v[2][2] = rm.z; rotDirA.v[2][3] = r.z;
-		}
-		{
-			mthz::Vec3 l = Ib_inv * (u.cross(rB) - pos_diff.cross(u));  //left block
-			mthz::Vec3 lm = Ib_inv * (w.cross(rB) - pos_diff.cross(w)); //left middle block
-			mthz::Vec3 rm = Ib_inv * (u.cross(n));                      //left middle block
-			mthz::Vec3 r = Ib_inv * (w.cross(n));                       //right block
-
-			rotDirB.v[0][0] = l.x; rotDirB.v[0][1] = lm.x; rotDirB.v[0][2] = rm.x; rotDirB.v[0][3] = r.x;
-			rotDirB.v[1][0] = l.y; rotDirB.v[1][1] = lm.y; rotDirB.v[1][2] = rm.y; rotDirB.v[1][3] = r.y;
-			rotDirB.v[2][0] = l.z; rotDirB.v[2][1] = lm.z; rotDirB.v[2][2] = rm.z; rotDirB.v[2][3] = r.z;
-		}
-
-		//INVERSE INERTIA MATRIX
-		{
-			mthz::NMat<3, 3> ul = (mthz::Mat3::iden() * a->getInvMass() + mthz::Mat3::iden() * b->getInvMass() - rA_skew * Ia_inv * rA_skew - rB_skew * Ib_inv * rB_skew).toNMat(); //upper left
-			mthz::Vec3 um = -(rA_skew * Ia_inv + rB_skew * Ib_inv) * (n.cross(u)); //upper middle
-			mthz::Vec3 ur = -(rA_skew * Ia_inv + rB_skew * Ib_inv) * (n.cross(w)); //upper right
-
-			mthz::NMat<3, 3> rA_skew_mat = rA_skew.toNMat();
-			mthz::NMat<3, 3> rB_skew_mat = rB_skew.toNMat();
-			mthz::NMat<3, 3> u_skew = mthz::crossMat(u);
-			mthz::NMat<3, 3> w_skew = mthz::crossMat(w);
-			mthz::NMat<3, 3> n_skew = mthz::crossMat(n);
-			mthz::NMat<1, 3> u_dot = mthz::NMat<1, 3>{ {u.x, u.y, u.z} };
-			mthz::NMat<1, 3> w_dot = mthz::NMat<1, 3>{ {w.x, w.y, w.z} };
-			mthz::NMat<1, 3> n_dot = mthz::NMat<1, 3>{ {n.x, n.y, n.z} };
-			mthz::NMat<1, 3> pd_dot = mthz::NMat<1, 3>{ {pos_diff.x, pos_diff.y, pos_diff.z} };
-
-			a_jacobian.copyInto(u_dot, 0, 0); a_jacobian.copyInto(-u_dot * rA_skew_mat, 0, 3); b_jacobian.copyInto(-u_dot, 0, 0); b_jacobian.copyInto(u_dot * rB_skew_mat - pd_dot * u_skew, 0, 3);
-			a_jacobian.copyInto(w_dot, 1, 0); a_jacobian.copyInto(-w_dot * rA_skew_mat, 1, 3); b_jacobian.copyInto(-w_dot, 1, 0); b_jacobian.copyInto(w_dot * rB_skew_mat - pd_dot * w_skew, 1, 3);
-											  a_jacobian.copyInto(-u_dot * n_skew, 2, 3);										  b_jacobian.copyInto(-n_dot * u_skew, 2, 3);
-											  a_jacobian.copyInto(-w_dot * n_skew, 3, 3);										  b_jacobian.copyInto(-n_dot * w_skew, 3, 3);
-
-			impulse_to_a_velocity = aInvMass() * a_jacobian.transpose();
-			impulse_to_b_velocity = bInvMass() * b_jacobian.transpose();
-
-			impulse_to_value = a_jacobian * impulse_to_a_velocity + b_jacobian * impulse_to_b_velocity;
-			impulse_to_value_inverse = applyCFM(impulse_to_value, constraint_force_mixing).inverse();
-		}
+		setJacobianRow(&a_jacobian, 0, u, rA.cross(u));
+		setJacobianRow(&b_jacobian, 0, -u, u.cross(rB) - pos_diff.cross(u));
+		setJacobianRow(&a_jacobian, 1, w, rA.cross(w));
+		setJacobianRow(&b_jacobian, 1, -w, w.cross(rB) - pos_diff.cross(w));
+		setJacobianRow(&a_jacobian, 2, mthz::Vec3(), n.cross(u));
+		setJacobianRow(&b_jacobian, 2, mthz::Vec3(), u.cross(n));
+		setJacobianRow(&a_jacobian, 3, mthz::Vec3(), n.cross(w));
+		setJacobianRow(&b_jacobian, 3, mthz::Vec3(), w.cross(n));
+		computeImpulseResponse(this, constraint_force_mixing);
 
 		target_val = -getConstraintValue(velAngToNVec(a->getVel(), a->getAngVel()), velAngToNVec(b->getVel(), b->getAngVel()));
 		{
@@ -820,32 +1731,25 @@ namespace phyz {
 	////*******WELD CONSTRAINT********
 	////******************************
 	WeldConstraint::WeldConstraint(RigidBody* a, RigidBody* b, mthz::Vec3 pos_a, mthz::Vec3 pos_b, double pos_correct_hardness, double rot_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<6> warm_start_impulse)
-		: DegreedConstraint<6>(a, b, warm_start_impulse), rA(pos_a - a->getCOM()), rB(pos_b - b->getCOM())
+		: DegreedConstraint<6>(a, b, warm_start_impulse)
 	{
-		this->is_in_holonomic_system = is_in_holonomic_system;
-
-		mthz::Mat3 Ia_inv = a->getInvTensor();
-		mthz::Mat3 Ib_inv = b->getInvTensor();
-		mthz::NMat<3, 3> Ia_inv_mat = Ia_inv.toNMat();
-		mthz::NMat<3, 3> Ib_inv_mat = Ib_inv.toNMat();
-		mthz::NMat<3, 3> rA_skew = mthz::crossMat(rA);
-		mthz::NMat<3, 3> rB_skew = mthz::crossMat(rB);
-		mthz::NMat<3, 3> iden_mat = mthz::idenMat<3>();
-
-		rotDirA.copyInto(Ia_inv_mat * rA_skew, 0, 0); rotDirA.copyInto(Ia_inv_mat, 0, 3);
-
-		rotDirB.copyInto(Ib_inv_mat * rB_skew, 0, 0); rotDirB.copyInto(Ib_inv_mat, 0, 3);
-
-		a_jacobian.copyInto(mthz::idenMat<3>(), 0, 0); a_jacobian.copyInto(-rA_skew, 0, 3);
-												 a_jacobian.copyInto(mthz::idenMat<3>(), 3, 3);
-		b_jacobian.copyInto(-mthz::idenMat<3>(), 0, 0); b_jacobian.copyInto(rB_skew, 0, 3);
-												  b_jacobian.copyInto(-mthz::idenMat<3>(), 3, 3);
-
-		impulse_to_a_velocity = aInvMass() * a_jacobian.transpose();
-		impulse_to_b_velocity = bInvMass() * b_jacobian.transpose();
+		refresh(pos_a, pos_b, pos_correct_hardness, rot_correct_hardness, constraint_force_mixing, is_in_holonomic_system, warm_start_impulse);
+	}
 
-		impulse_to_value = a_jacobian * impulse_to_a_velocity + b_jacobian * impulse_to_b_velocity;
-		impulse_to_value_inverse = applyCFM(impulse_to_value, constraint_force_mixing).inverse();
+	void WeldConstraint::refresh(mthz::Vec3 pos_a, mthz::Vec3 pos_b, double pos_correct_hardness, double rot_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<6> warm_start_impulse) {
+		this->is_in_holonomic_system = is_in_holonomic_system;
+		impulse = warm_start_impulse;
+		psuedo_impulse = mthz::NVec<6>{ 0.0 };
+		rA = pos_a - a->getCOM();
+		rB = pos_b - b->getCOM();
+
+		for (int i = 0; i < 3; i++) {
+			setJacobianRow(&a_jacobian, i, AXES[i], rA.cross(AXES[i]));
+			setJacobianRow(&b_jacobian, i, -AXES[i], AXES[i].cross(rB));
+			setJacobianRow(&a_jacobian, 3 + i, mthz::Vec3(), AXES[i]);
+			setJacobianRow(&b_jacobian, 3 + i, mthz::Vec3(), -AXES[i]);
+		}
+		computeImpulseResponse(this, constraint_force_mixing);
 
 		target_val = -getConstraintValue(velAngToNVec(a->getVel(), a->getAngVel()), velAngToNVec(b->getVel(), b->getAngVel()));
 		{
@@ -2,35 +2,84 @@
 #include "ThreadManager.h"
 #include "RigidBody.h"
 #include "HolonomicBlockSolver.h"
+#include "ContactBatchSolver.h"
+#include "Articulation.h"
 #include "../../Math/src/NVec.h"
 #include "../../Math/src/NMat.h"
+#include <tuple>
+#include <cstdint>
 
 namespace phyz {
 
 	class Constraint;
 	class PhysicsEngine;
-	void PGS_solve(
+	class SolverRows;
+	class Cable;
+
+	//passed to PGS_solve to split the work of one large island between threads. As colored_solve, its rows are colored by the bodies they share
+	//and each color split between threads. As holonomic_threads, its holonomic systems are factorized and solved by subtrees of their elimination
+	//trees. Results are the same for any number of threads, or with thread_manager left null
+	struct SolverThreads {
+		ThreadManager* thread_manager;
+		int n_threads;
+	};
+
+	//velocity changes accumulated by the solver for the bodies of one island, stored densely and indexed by Constraint::a_solver_index
+	//and b_solver_index. Index 0 is shared by all non dynamic bodies, whose velocity can't change. Kept between steps to reuse allocations
+	struct SolverBodies {
+		std::vector<RigidBody*> bodies;
+		std::vector<mthz::NVec<6>> velocity_changes;
+		std::vector<mthz::NVec<6>> psuedo_velocity_changes;
+	};
+
+	//what a PGS_solve did: the sweeps each phase ran and the residual, the largest impulse change, of its last sweep.
+	//A phase stops early once its residual is at most the residual tolerance. A sub-stepped solve counts its substeps as velocity iterations and its
+	//relaxation sweep as a position iteration
+	struct PGSSolveStats {
+		int vel_iterations = 0;
+		int pos_iterations = 0;
+		double vel_residual = 0;
+		double pos_residual = 0;
+		bool vel_converged = true;
+		bool pos_converged = true;
+	};
+
+	PGSSolveStats PGS_solve(
 		PhysicsEngine* pEngine, 
 		const std::vector<Constraint*>& constraints, 
 		const std::vector<HolonomicSystem*>& holonomic_systems,
+		const std::vector<Cable*>& cables,
+		SolverBodies* solver_bodies,
+		SolverRows* solver_rows,
 		double holonomic_block_solver_CFM,
+		int holonomic_refactor_interval,
 		int n_itr_vel, int n_itr_pos, int n_itr_holonomic, 
-		ThreadManager::JobStatus* compute_inverse_status=nullptr
+		int n_substeps,
+		double residual_tolerance,
+		ThreadManager::JobStatus* compute_inverse_status=nullptr,
+		const SolverThreads* colored_solve=nullptr,
+		const SolverThreads* holonomic_threads=nullptr
 	);
 
 	class Constraint {
 	public:
-		Constraint() : a(nullptr), b(nullptr), a_velocity_change(nullptr), a_psuedo_velocity_change(nullptr), b_velocity_change(nullptr), b_psuedo_velocity_change(nullptr), is_in_holonomic_system(false) {}
-		Constraint(RigidBody* a, RigidBody* b) : a(a), b(b), a_velocity_change(nullptr), a_psuedo_velocity_change(nullptr), b_velocity_change(nullptr), b_psuedo_velocity_change(nullptr), is_in_holonomic_system(false) {}
+		Constraint() : a(nullptr), b(nullptr), a_solver_index(0), b_solver_index(0), a_velocity_change(nullptr), a_psuedo_velocity_change(nullptr), b_velocity_change(nullptr), b_psuedo_velocity_change(nullptr), is_in_holonomic_system(false) {}
+		Constraint(RigidBody* a, RigidBody* b) : a(a), b(b), a_solver_index(0), b_solver_index(0), a_velocity_change(nullptr), a_psuedo_velocity_change(nullptr), b_velocity_change(nullptr), b_psuedo_velocity_change(nullptr), is_in_holonomic_system(false) {}
 		virtual ~Constraint() {}
 
 		RigidBody* a;
 		RigidBody* b;
 		bool is_in_holonomic_system;
+		int a_solver_index;
+		int b_solver_index;
 		mthz::NVec<6>* a_velocity_change;
 		mthz::NVec<6>* a_psuedo_velocity_change;
 		mthz::NVec<6>* b_velocity_change;
 		mthz::NVec<6>* b_psuedo_velocity_change;
+		double constraint_force_mixing = 0;
+		//softness of a soft row: its value may miss its target by compliance times its accumulated impulse. Soft rows are solved through the generic
+		//interface, or on an articulation, which honor it
+		double compliance = 0;
 
 		virtual double getImpulseMag() = 0;
 		virtual double getPsuedoImpulseMag() = 0;
@@ -38,6 +87,10 @@ namespace phyz {
 		virtual bool isInequalityConstraint() = 0;
 		virtual bool needsPosCorrect() = 0;
 		virtual bool constraintWarmStarted() = 0;
+		//which of SolverRows' arrays the constraint is gathered into. Inequality constraints other than contacts keep their own projection, and soft rows
+		//their compliance, so are solved through this interface
+		enum RowType { CONTACT_ROW, FRICTION_ROW, JOINT_ROW, GENERIC_ROW };
+		virtual RowType getRowType() { return isInequalityConstraint() || compliance != 0 ? GENERIC_ROW : JOINT_ROW; }
 		virtual void applyWarmStartVelocityChange() = 0;
 	protected:
 		//these are pretty inefficient to multiply with, but nice for sanity checking
@@ -94,19 +147,21 @@ namespace phyz {
 	public:
 		ContactConstraint() {}
 		ContactConstraint(RigidBody* a, RigidBody* b, mthz::Vec3 norm, mthz::Vec3 contact_p, double bounce, double pen_depth, double pos_correct_hardness, double constraint_force_mixing, mthz::NVec<1> warm_start_impulse=mthz::NVec<1>{ 0.0 }, double cutoff_vel=0);
+
+		//recomputes the row in place for a new contact point, same as constructing the constraint again
+		void refresh(mthz::Vec3 norm, mthz::Vec3 contact_p, double bounce, double pen_depth, double pos_correct_hardness, double constraint_force_mixing, mthz::NVec<1> warm_start_impulse, double cutoff_vel);
 		
 		inline int getDegree() override { return 1; }
 		inline bool isInequalityConstraint() override { return true; }
 		mthz::NVec<1> projectValidImpulse(mthz::NVec<1> impulse) override;
 		inline bool needsPosCorrect() override { return true; }
+		inline RowType getRowType() override { return CONTACT_ROW; }
 
 	private:
 		
 		mthz::Vec3 norm;
 		mthz::Vec3 rA;
 		mthz::Vec3 rB;
-		mthz::Vec3 rotDirA;
-		mthz::Vec3 rotDirB;
 	};
 
 	class FrictionConstraint : public DegreedConstraint<2> {
@@ -114,20 +169,24 @@ namespace phyz {
 		FrictionConstraint() : normal_impulse(nullptr) {}
 		FrictionConstraint(RigidBody* a, RigidBody* b, mthz::Vec3 norm, mthz::Vec3 contact_p, double coeff_friction, ContactConstraint* normal, double constraint_force_mixing, mthz::NVec<2> warm_start_impulse = mthz::NVec<2>{ 0.0, 0.0 }, mthz::Vec3 source_u = mthz::Vec3(), mthz::Vec3 source_w = mthz::Vec3(), double normal_impulse_limit = std::numeric_limits<double>::infinity());
 
+		//keeps the normal constraint it was built with
+		void refresh(mthz::Vec3 norm, mthz::Vec3 contact_p, double coeff_friction, double constraint_force_mixing, mthz::NVec<2> warm_start_impulse, mthz::Vec3 source_u, mthz::Vec3 source_w, double normal_impulse_limit);
+
 		inline int getDegree() override { return 2; }
 		inline bool isInequalityConstraint() override { return true; }
 		mthz::NVec<2> projectValidImpulse(mthz::NVec<2> impulse) override;
 		inline bool needsPosCorrect() override { return false; }
+		inline RowType getRowType() override { return FRICTION_ROW; }
 
 		bool getStaticReady() { return static_ready; }
 
 		mthz::Vec3 u;
 		mthz::Vec3 w;
+
+		friend class SolverRows;
 	private:
 		mthz::Vec3 rA;
 		mthz::Vec3 rB;
-		mthz::NMat<3, 2> rotDirA;
-		mthz::NMat<3, 2> rotDirB;
 		double coeff_friction;
 		mthz::NVec<1>* normal_impulse;
 		double normal_impulse_limit;
@@ -137,8 +196,12 @@ namespace phyz {
 	class DistanceConstraint : public DegreedConstraint<1> {
 	public:
 		DistanceConstraint() {}
+		DistanceConstraint(RigidBody* a, RigidBody* b) : DegreedConstraint<1>(a, b, mthz::NVec<1>{ 0.0 }) {}
 		DistanceConstraint(RigidBody* a, RigidBody* b, mthz::Vec3 attach_pos_a, mthz::Vec3 attach_pos_b, double target_distance, double pos_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<1> warm_start_impulse = mthz::NVec<1>{ 0.0 });
 
+		//recomputes the rows in place for the new positions, same as constructing the constraint again
+		void refresh(mthz::Vec3 attach_pos_a, mthz::Vec3 attach_pos_b, double target_distance, double pos_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<1> warm_start_impulse);
+
 		inline int getDegree() override { return 1; }
 		inline bool isInequalityConstraint() override { return false; }
 		inline bool needsPosCorrect() override { return true; }
@@ -146,14 +209,35 @@ namespace phyz {
 	private:
 		mthz::Vec3 rA;
 		mthz::Vec3 rB;
-		mthz::Mat3 rotDirA;
-		mthz::Mat3 rotDirB;
+	};
+
+	//a damped spring as a soft row, integrated implicitly so it is stable at any stiffness. Stiffness and damping map to the fraction of the
+	//stretch pulled back each step, ERP, and the compliance, CFM, see Soft Constraints by Erin Catto. Solved as a generic row for its compliance.
+	//Stiffness beyond what the step time can resolve is capped, leaving very stiff springs nearly rigid
+	class SpringConstraint : public DegreedConstraint<1> {
+	public:
+		SpringConstraint() {}
+		SpringConstraint(RigidBody* a, RigidBody* b) : DegreedConstraint<1>(a, b, mthz::NVec<1>{ 0.0 }) {}
+
+		void refresh(mthz::Vec3 attach_pos_a, mthz::Vec3 attach_pos_b, double resting_length, double stiffness, double damping, double step_time, double constraint_force_mixing, mthz::NVec<1> warm_start_impulse);
+
+		inline int getDegree() override { return 1; }
+		inline bool isInequalityConstraint() override { return false; }
+		inline bool needsPosCorrect() override { return false; }
+		inline RowType getRowType() override { return GENERIC_ROW; }
+
+	private:
+		mthz::Vec3 rA;
+		mthz::Vec3 rB;
 	};
 
 	class BallSocketConstraint : public DegreedConstraint<3> {
 	public:
 		BallSocketConstraint() {}
+		BallSocketConstraint(RigidBody* a, RigidBody* b) : DegreedConstraint<3>(a, b, mthz::NVec<3>{ 0.0 }) {}
 		BallSocketConstraint(RigidBody* a, RigidBody* b, mthz::Vec3 socket_pos_a, mthz::Vec3 socket_pos_b, double pos_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<3> warm_start_impulse=mthz::NVec<3>{ 0.0 });
+
+		void refresh(mthz::Vec3 socket_pos_a, mthz::Vec3 socket_pos_b, double pos_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<3> warm_start_impulse);
 		
 		inline int getDegree() override { return 3; }
 		inline bool isInequalityConstraint() override { return false; }
@@ -162,15 +246,16 @@ namespace phyz {
 	private:
 		mthz::Vec3 rA;
 		mthz::Vec3 rB;
-		mthz::Mat3 rotDirA;
-		mthz::Mat3 rotDirB;
 	};
 
 	class SlidingHingeConstraint : public DegreedConstraint<4> {
 	public:
 		SlidingHingeConstraint() {}
+		SlidingHingeConstraint(RigidBody* a, RigidBody* b) : DegreedConstraint<4>(a, b, mthz::NVec<4>{ 0.0, 0.0, 0.0, 0.0 }) {}
 		SlidingHingeConstraint(RigidBody* a, RigidBody* b, mthz::Vec3 hinge_pos_a, mthz::Vec3 hinge_pos_b, mthz::Vec3 rot_axis_a, mthz::Vec3 rot_axis_b, double pos_correct_hardness, double rot_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<4> warm_start_impulse = mthz::NVec<4>{ 0.0, 0.0, 0.0, 0.0 }, mthz::Vec3 source_u = mthz::Vec3(), mthz::Vec3 source_w = mthz::Vec3());
 
+		void refresh(mthz::Vec3 hinge_pos_a, mthz::Vec3 hinge_pos_b, mthz::Vec3 rot_axis_a, mthz::Vec3 rot_axis_b, double pos_correct_hardness, double rot_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<4> warm_start_impulse, mthz::Vec3 source_u, mthz::Vec3 source_w);
+
 		inline int getDegree() override { return 4; }
 		inline bool isInequalityConstraint() override { return false; }
 		inline bool needsPosCorrect() override { return true; }
@@ -181,15 +266,16 @@ namespace phyz {
 		mthz::Vec3 rA;
 		mthz::Vec3 rB;
 		mthz::Vec3 n;
-		mthz::NMat<3, 4> rotDirA;
-		mthz::NMat<3, 4> rotDirB;
 	};
 
 	class HingeConstraint : public DegreedConstraint<5> {
 	public:
 		HingeConstraint() {}
+		HingeConstraint(RigidBody* a, RigidBody* b) : DegreedConstraint<5>(a, b, mthz::NVec<5>{ 0.0, 0.0, 0.0, 0.0, 0.0 }) {}
 		HingeConstraint(RigidBody* a, RigidBody* b, mthz::Vec3 hinge_pos_a, mthz::Vec3 hinge_pos_b, mthz::Vec3 rot_axis_a, mthz::Vec3 rot_axis_b, double pos_correct_hardness, double rot_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<5> warm_start_impulse=mthz::NVec<5>{ 0.0, 0.0, 0.0, 0.0, 0.0 }, mthz::Vec3 source_u=mthz::Vec3(), mthz::Vec3 source_w=mthz::Vec3());
 
+		void refresh(mthz::Vec3 hinge_pos_a, mthz::Vec3 hinge_pos_b, mthz::Vec3 rot_axis_a, mthz::Vec3 rot_axis_b, double pos_correct_hardness, double rot_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<5> warm_start_impulse, mthz::Vec3 source_u, mthz::Vec3 source_w);
+
 		inline int getDegree() override { return 5; }
 		inline bool isInequalityConstraint() override { return false; }
 		inline bool needsPosCorrect() override { return true; }
@@ -200,8 +286,6 @@ namespace phyz {
 		mthz::Vec3 rA;
 		mthz::Vec3 rB;
 		mthz::Vec3 n;
-		mthz::NMat<3, 5> rotDirA;
-		mthz::NMat<3, 5> rotDirB;
 	};
 
 	class MotorConstraint : public DegreedConstraint<1> {
@@ -224,11 +308,28 @@ namespace phyz {
 		mthz::Vec3 rotDirB;
 	};
 
+	//couples the rate b turns about its axis, or slides along it, to the rate a turns about its own: b_rate = ratio * a_rate. Rates are measured in
+	//world space rather than relative to whatever holds the bodies, and only velocities are coupled, so the two can slowly drift out of phase
+	class GearConstraint : public DegreedConstraint<1> {
+	public:
+		GearConstraint() {}
+		GearConstraint(RigidBody* a, RigidBody* b) : DegreedConstraint<1>(a, b, mthz::NVec<1>{ 0.0 }) {}
+
+		void refresh(mthz::Vec3 rot_axis_a, mthz::Vec3 axis_b, bool b_slides, double ratio, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<1> warm_start_impulse);
+
+		inline int getDegree() override { return 1; }
+		inline bool isInequalityConstraint() override { return false; }
+		inline bool needsPosCorrect() override { return false; }
+	};
+
 	class SliderConstraint : public DegreedConstraint<5> {
 	public:
 		SliderConstraint() {}
+		SliderConstraint(RigidBody* a, RigidBody* b) : DegreedConstraint<5>(a, b, mthz::NVec<5>{ 0.0, 0.0, 0.0, 0.0, 0.0 }) {}
 		SliderConstraint(RigidBody* a, RigidBody* b, mthz::Vec3 slider_point_a, mthz::Vec3 slider_point_b, mthz::Vec3 slider_axis_a, double pos_correct_hardness, double rot_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<5> warm_start_impulse = mthz::NVec<5>{ 0.0, 0.0, 0.0, 0.0, 0.0 }, mthz::Vec3 source_u = mthz::Vec3(), mthz::Vec3 source_w = mthz::Vec3());
 
+		void refresh(mthz::Vec3 slider_point_a, mthz::Vec3 slider_point_b, mthz::Vec3 slider_axis_a, double pos_correct_hardness, double rot_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<5> warm_start_impulse, mthz::Vec3 source_u, mthz::Vec3 source_w);
+
 		inline int getDegree() override { return 5; }
 		inline bool isInequalityConstraint() override { return false; }
 		inline bool needsPosCorrect() override { return true; }
@@ -238,8 +339,6 @@ namespace phyz {
 	private:
 		mthz::Vec3 rA;
 		mthz::Vec3 rB;
-		mthz::NMat<3, 5> rotDirA;
-		mthz::NMat<3, 5> rotDirB;
 	};
 
 	class PistonConstraint : public DegreedConstraint<1> {
@@ -282,8 +381,11 @@ namespace phyz {
 	class WeldConstraint : public DegreedConstraint<6> {
 	public:
 		WeldConstraint() {}
+		WeldConstraint(RigidBody* a, RigidBody* b) : DegreedConstraint<6>(a, b, mthz::NVec<6>{ 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 }) {}
 		WeldConstraint(RigidBody* a, RigidBody* b, mthz::Vec3 a_attach_point, mthz::Vec3 b_attach_point, double pos_correct_hardness, double rot_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<6> warm_start_impulse = mthz::NVec<6>{ 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 });
 
+		void refresh(mthz::Vec3 a_attach_point, mthz::Vec3 b_attach_point, double pos_correct_hardness, double rot_correct_hardness, double constraint_force_mixing, bool is_in_holonomic_system, mthz::NVec<6> warm_start_impulse);
+
 		inline int getDegree() override { return 6; }
 		inline bool isInequalityConstraint() override { return false; }
 		inline bool needsPosCorrect() override { return true; }
@@ -291,9 +393,6 @@ namespace phyz {
 	private:
 		mthz::Vec3 rA;
 		mthz::Vec3 rB;
-		mthz::Vec3 n;
-		mthz::NMat<3, 6> rotDirA;
-		mthz::NMat<3, 6> rotDirB;
 	};
 
 	class TestConstraint : public DegreedConstraint<6> {
@@ -305,4 +404,137 @@ namespace phyz {
 		inline bool isInequalityConstraint() override { return false; }
 		inline bool needsPosCorrect() override { return false; }
 	};
-}
\ No newline at end of file
+
+	//the solver data of a constraint, copied out of the constraint object so PGS iterations run over contiguous arrays without virtual calls
+	template<int n>
+	struct SolverRow {
+		DegreedConstraint<n>* source;
+		int a_index;
+		int b_index;
+		bool needs_pos_correct;
+		bool is_in_holonomic_system;
+		mthz::NVec<n> impulse;
+		mthz::NVec<n> psuedo_impulse;
+		mthz::NVec<n> target_val;
+		mthz::NVec<n> psuedo_target_val;
+		mthz::NMat<n, 6, solver_real> a_jacobian;
+		mthz::NMat<n, 6, solver_real> b_jacobian;
+		mthz::NMat<6, n, solver_real> impulse_to_a_velocity;
+		mthz::NMat<6, n, solver_real> impulse_to_b_velocity;
+		mthz::NMat<n, n, solver_real> impulse_to_value_inverse;
+	};
+
+	//a contact and the friction at the same point, solved one after the other
+	struct ContactRow {
+		SolverRow<1> normal;
+		SolverRow<2> friction;
+		bool has_friction;
+		double coeff_friction;
+		double normal_impulse_limit;
+		bool static_ready;
+	};
+
+	//a run of contacts between the same two bodies, up to a full manifold, whose normal rows are solved together
+	struct ContactBlock {
+		static const int MAX_CONTACTS = 4;
+		int first; //index in SolverRows::contacts
+		int n_contacts;
+		double impulse_to_value[MAX_CONTACTS][MAX_CONTACTS];
+	};
+
+	//rows of one island grouped by type. Like SolverBodies, kept between steps to reuse allocations
+	class SolverRows {
+	public:
+		void gather(const std::vector<Constraint*>& constraints);
+		//builds the rows of the constraints gather set aside for touching an articulation, and applies their warm starting. The rows point into
+		//solver_bodies, so this is called once its velocity changes are allocated
+		void gatherArticulated(SolverBodies* solver_bodies);
+		//write accumulated impulses back to the constraints, used for warm starting the next step
+		void scatter(bool include_holonomic_system_rows);
+		//split contact and joint rows into colors where no two rows of a color share a dynamic body
+		void color(int n_bodies);
+		//pack contact rows into batches of rows that share no dynamic body, to be solved with vector instructions
+		void batchContacts();
+		void unpackContactBatches();
+		//group consecutive contacts between the same bodies into blocks, whose normal rows are solved as one small LCP
+		void blockContacts();
+		//order contact normal rows bottom up for shock propagation, bodies[i] being the body at solver index i
+		void orderContactsByHeight(const std::vector<RigidBody*>& bodies, mthz::Vec3 up);
+
+		template<int n>
+		std::vector<SolverRow<n>>& joints() { return std::get<n - 1>(joint_rows); }
+
+		std::vector<ContactRow> contacts;
+		std::tuple<
+			std::vector<SolverRow<1>>, std::vector<SolverRow<2>>, std::vector<SolverRow<3>>,
+			std::vector<SolverRow<4>>, std::vector<SolverRow<5>>, std::vector<SolverRow<6>>
+		> joint_rows;
+		std::vector<Constraint*> generic;
+
+		//rows with a body moved by an articulation. The velocity changes of an articulation are those of its degrees of freedom, so each side of such a row
+		//has its own jacobian over the velocities it reads and response to each impulse component, stored in articulated_values. They are solved on the
+		//constraints directly
+		struct ArticulatedRow {
+			Constraint* source;
+			int degree;
+			int n_sides;
+			struct Side {
+				double* velocity_change;
+				double* psuedo_velocity_change;
+				int n_velocities;
+				int values; //offset in articulated_values of the degree x n_velocities jacobian, followed by the degree x n_velocities response
+			} sides[2];
+			int impulse_to_value_inverse; //offset in articulated_values
+		};
+		std::vector<Constraint*> articulated_sources;
+		std::vector<ArticulatedRow> articulated;
+		std::vector<double> articulated_values;
+		std::vector<Articulation*> articulations;
+
+		//when set, contacts are solved through contact_batches rather than one row at a time
+		bool use_contact_batches = false;
+		std::vector<ContactRowBatch> contact_batches;
+		//when set, contacts are solved through contact_blocks. Not used together with use_contact_batches
+		bool use_contact_blocks = false;
+		std::vector<ContactBlock> contact_blocks;
+		//when set, each sweep but the last of a phase is followed by a nonsmooth nonlinear conjugate gradient step over the impulses of the joint and
+		//contact rows. Not used together with use_contact_batches
+		bool use_nncg = false;
+		std::vector<double> nncg_start;
+		std::vector<double> nncg_direction;
+		double nncg_change_sqr = 0;
+		//when set, the velocity phase ends with a shock propagation sweep over the contacts, bottom up, with the lower body of each contact
+		//treated as immovable. Stacks are held up all the way to the top by that one sweep. Not used together with use_contact_batches
+		bool use_shock_propagation = false;
+		struct ShockContact {
+			int index; //in contacts
+			int upper_index;
+			bool a_is_upper;
+			double upper_height;
+			double upper_impulse_to_value_inverse;
+			mthz::NMat<2, 2> upper_friction_impulse_to_value_inverse;
+			//added by the current shock propagation sweep
+			double impulse;
+			mthz::NVec<2> friction_impulse;
+		};
+		std::vector<ShockContact> shock_order;
+
+		//degree 0 refers to a contact row, -1 to a contact batch, -2 to a contact block
+		struct RowRef {
+			int degree;
+			int index;
+		};
+		struct RowColor {
+			std::vector<RowRef> rows;
+			std::vector<int> chunk_begins;
+			bool conflicting; //the last color takes all rows that didn't fit in the others, they may share bodies so are solved on one thread
+		};
+		static const int MAX_COLORS = 64;
+		static const int COLOR_CHUNK_SIZE = 32;
+		std::vector<RowColor> colors;
+		int n_colors = 0;
+	private:
+		std::vector<uint64_t> body_color_masks;
+		std::vector<std::vector<int>> contact_colors;
+	};
+}
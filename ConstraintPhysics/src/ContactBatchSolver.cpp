@@ -0,0 +1,237 @@
+#include "ContactBatchSolver.h"
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CONTACT_BATCH_AVX
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AVX_TARGET
+#else
+#define AVX_TARGET __attribute__((target("avx")))
+#endif
+#endif
+
+namespace phyz {
+
+	//kept in the same order of operations as PGSConstraintStep so both give the same result
+	static double solveContactBatchScalar(ContactRowBatch* b, mthz::NVec<6>* velocity_changes, bool use_psuedo_values) {
+		double residual = 0;
+		for (int l = 0; l < b->n_lanes; l++) {
+			mthz::NVec<6> va = velocity_changes[b->a_index[l]];
+			mthz::NVec<6> vb = velocity_changes[b->b_index[l]];
+
+			double* accumulated_impulse = use_psuedo_values ? &b->psuedo_impulse[l] : &b->impulse[l];
+			double target_val = use_psuedo_values ? b->psuedo_target_val[l] : b->target_val[l];
+
+			double current_a = 0, current_b = 0;
+			for (int k = 0; k < 6; k++) {
+				current_a += va.v[k] * b->a_jacobian[k][l];
+				current_b += vb.v[k] * b->b_jacobian[k][l];
+			}
+			double impulse_new = *accumulated_impulse + (target_val - (current_a + current_b)) * b->impulse_to_value_inverse[l];
+			double impulse_diff = std::max<double>(impulse_new, 0) - *accumulated_impulse;
+			if (abs(impulse_diff) > CUTOFF) {
+				for (int k = 0; k < 6; k++) {
+					va.v[k] += impulse_diff * b->impulse_to_a_velocity[k][l];
+					vb.v[k] += impulse_diff * b->impulse_to_b_velocity[k][l];
+				}
+				*accumulated_impulse += impulse_diff;
+				residual = std::max<double>(residual, abs(impulse_diff));
+			}
+
+			if (!use_psuedo_values) {
+				double current_u_a = 0, current_u_b = 0, current_w_a = 0, current_w_b = 0;
+				for (int k = 0; k < 6; k++) {
+					current_u_a += va.v[k] * b->friction_a_jacobian[0][k][l];
+					current_u_b += vb.v[k] * b->friction_b_jacobian[0][k][l];
+					current_w_a += va.v[k] * b->friction_a_jacobian[1][k][l];
+					current_w_b += vb.v[k] * b->friction_b_jacobian[1][k][l];
+				}
+				double delta_u = b->friction_target_val[0][l] - (current_u_a + current_u_b);
+				double delta_w = b->friction_target_val[1][l] - (current_w_a + current_w_b);
+				double new_u = b->friction_impulse[0][l] + (delta_u * b->friction_impulse_to_value_inverse[0][0][l] + delta_w * b->friction_impulse_to_value_inverse[0][1][l]);
+				double new_w = b->friction_impulse[1][l] + (delta_u * b->friction_impulse_to_value_inverse[1][0][l] + delta_w * b->friction_impulse_to_value_inverse[1][1][l]);
+
+				double max_impulse_mag = b->coeff_friction[l] * std::min<double>(b->normal_impulse_limit[l], b->impulse[l]);
+				double current_impulse_mag = sqrt(new_u * new_u + new_w * new_w);
+				if (current_impulse_mag > max_impulse_mag) {
+					b->static_ready[l] = 0;
+					double r = max_impulse_mag / current_impulse_mag;
+					new_u *= r;
+					new_w *= r;
+				}
+				else {
+					b->static_ready[l] = 1;
+				}
+
+				double diff_u = new_u - b->friction_impulse[0][l];
+				double diff_w = new_w - b->friction_impulse[1][l];
+				if (abs(diff_u) > CUTOFF || abs(diff_w) > CUTOFF) {
+					for (int k = 0; k < 6; k++) {
+						va.v[k] += diff_u * b->friction_impulse_to_a_velocity[0][k][l] + diff_w * b->friction_impulse_to_a_velocity[1][k][l];
+						vb.v[k] += diff_u * b->friction_impulse_to_b_velocity[0][k][l] + diff_w * b->friction_impulse_to_b_velocity[1][k][l];
+					}
+					b->friction_impulse[0][l] += diff_u;
+					b->friction_impulse[1][l] += diff_w;
+					residual = std::max<double>(residual, std::max<double>(abs(diff_u), abs(diff_w)));
+				}
+			}
+
+			//index 0 is shared by the non dynamic bodies and always stays zero
+			if (b->a_index[l] != 0) velocity_changes[b->a_index[l]] = va;
+			if (b->b_index[l] != 0) velocity_changes[b->b_index[l]] = vb;
+		}
+		return residual;
+	}
+
+#ifdef CONTACT_BATCH_AVX
+	static_assert(ContactRowBatch::WIDTH == 4, "AVX contact batch kernel solves 4 lanes of doubles");
+
+	//row data is read in whatever precision it is stored in, the arithmetic is always double
+	AVX_TARGET static inline __m256d loadLanes(const double* p) {
+		return _mm256_loadu_pd(p);
+	}
+
+	AVX_TARGET static inline __m256d loadLanes(const float* p) {
+		return _mm256_cvtps_pd(_mm_loadu_ps(p));
+	}
+
+	AVX_TARGET static inline __m256d absolute(__m256d v) {
+		return _mm256_and_pd(v, _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFF)));
+	}
+
+	//changes smaller than CUTOFF are dropped, matching NVec::isZero
+	AVX_TARGET static inline __m256d significantChange(__m256d diff) {
+		return _mm256_cmp_pd(absolute(diff), _mm256_set1_pd(CUTOFF), _CMP_GT_OQ);
+	}
+
+	AVX_TARGET static double solveContactBatchAVX(ContactRowBatch* b, mthz::NVec<6>* velocity_changes, bool use_psuedo_values) {
+		const mthz::NVec<6>& a0 = velocity_changes[b->a_index[0]]; const mthz::NVec<6>& a1 = velocity_changes[b->a_index[1]];
+		const mthz::NVec<6>& a2 = velocity_changes[b->a_index[2]]; const mthz::NVec<6>& a3 = velocity_changes[b->a_index[3]];
+		const mthz::NVec<6>& b0 = velocity_changes[b->b_index[0]]; const mthz::NVec<6>& b1 = velocity_changes[b->b_index[1]];
+		const mthz::NVec<6>& b2 = velocity_changes[b->b_index[2]]; const mthz::NVec<6>& b3 = velocity_changes[b->b_index[3]];
+
+		__m256d va[6], vb[6];
+		for (int k = 0; k < 6; k++) {
+			va[k] = _mm256_set_pd(a3.v[k], a2.v[k], a1.v[k], a0.v[k]);
+			vb[k] = _mm256_set_pd(b3.v[k], b2.v[k], b1.v[k], b0.v[k]);
+		}
+
+		double* accumulated_impulse_p = use_psuedo_values ? b->psuedo_impulse : b->impulse;
+		__m256d accumulated_impulse = _mm256_loadu_pd(accumulated_impulse_p);
+		__m256d target_val = _mm256_loadu_pd(use_psuedo_values ? b->psuedo_target_val : b->target_val);
+
+		__m256d current_a = _mm256_setzero_pd(), current_b = _mm256_setzero_pd();
+		for (int k = 0; k < 6; k++) {
+			current_a = _mm256_add_pd(current_a, _mm256_mul_pd(va[k], loadLanes(b->a_jacobian[k])));
+			current_b = _mm256_add_pd(current_b, _mm256_mul_pd(vb[k], loadLanes(b->b_jacobian[k])));
+		}
+		__m256d delta = _mm256_sub_pd(target_val, _mm256_add_pd(current_a, current_b));
+		__m256d impulse_new = _mm256_add_pd(accumulated_impulse, _mm256_mul_pd(delta, loadLanes(b->impulse_to_value_inverse)));
+		__m256d impulse_diff = _mm256_sub_pd(_mm256_max_pd(impulse_new, _mm256_setzero_pd()), accumulated_impulse);
+		__m256d changed = significantChange(impulse_diff);
+		impulse_diff = _mm256_and_pd(impulse_diff, changed);
+		__m256d residual = absolute(impulse_diff);
+
+		for (int k = 0; k < 6; k++) {
+			va[k] = _mm256_add_pd(va[k], _mm256_mul_pd(impulse_diff, loadLanes(b->impulse_to_a_velocity[k])));
+			vb[k] = _mm256_add_pd(vb[k], _mm256_mul_pd(impulse_diff, loadLanes(b->impulse_to_b_velocity[k])));
+		}
+		accumulated_impulse = _mm256_add_pd(accumulated_impulse, impulse_diff);
+		_mm256_storeu_pd(accumulated_impulse_p, accumulated_impulse);
+
+		if (!use_psuedo_values) {
+			__m256d current_u_a = _mm256_setzero_pd(), current_u_b = _mm256_setzero_pd(), current_w_a = _mm256_setzero_pd(), current_w_b = _mm256_setzero_pd();
+			for (int k = 0; k < 6; k++) {
+				current_u_a = _mm256_add_pd(current_u_a, _mm256_mul_pd(va[k], loadLanes(b->friction_a_jacobian[0][k])));
+				current_u_b = _mm256_add_pd(current_u_b, _mm256_mul_pd(vb[k], loadLanes(b->friction_b_jacobian[0][k])));
+				current_w_a = _mm256_add_pd(current_w_a, _mm256_mul_pd(va[k], loadLanes(b->friction_a_jacobian[1][k])));
+				current_w_b = _mm256_add_pd(current_w_b, _mm256_mul_pd(vb[k], loadLanes(b->friction_b_jacobian[1][k])));
+			}
+			__m256d delta_u = _mm256_sub_pd(_mm256_loadu_pd(b->friction_target_val[0]), _mm256_add_pd(current_u_a, current_u_b));
+			__m256d delta_w = _mm256_sub_pd(_mm256_loadu_pd(b->friction_target_val[1]), _mm256_add_pd(current_w_a, current_w_b));
+			__m256d impulse_u = _mm256_loadu_pd(b->friction_impulse[0]);
+			__m256d impulse_w = _mm256_loadu_pd(b->friction_impulse[1]);
+			__m256d new_u = _mm256_add_pd(impulse_u, _mm256_add_pd(
+				_mm256_mul_pd(delta_u, loadLanes(b->friction_impulse_to_value_inverse[0][0])),
+				_mm256_mul_pd(delta_w, loadLanes(b->friction_impulse_to_value_inverse[0][1]))
+			));
+			__m256d new_w = _mm256_add_pd(impulse_w, _mm256_add_pd(
+				_mm256_mul_pd(delta_u, loadLanes(b->friction_impulse_to_value_inverse[1][0])),
+				_mm256_mul_pd(delta_w, loadLanes(b->friction_impulse_to_value_inverse[1][1]))
+			));
+
+			//min_pd returns its second operand on ties, same as std::min<double>(limit, impulse)
+			__m256d max_impulse_mag = _mm256_mul_pd(_mm256_loadu_pd(b->coeff_friction), _mm256_min_pd(accumulated_impulse, _mm256_loadu_pd(b->normal_impulse_limit)));
+			__m256d current_impulse_mag = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(new_u, new_u), _mm256_mul_pd(new_w, new_w)));
+			__m256d exceeded = _mm256_cmp_pd(current_impulse_mag, max_impulse_mag, _CMP_GT_OQ);
+			__m256d r = _mm256_div_pd(max_impulse_mag, current_impulse_mag);
+			new_u = _mm256_blendv_pd(new_u, _mm256_mul_pd(new_u, r), exceeded);
+			new_w = _mm256_blendv_pd(new_w, _mm256_mul_pd(new_w, r), exceeded);
+			_mm256_storeu_pd(b->static_ready, _mm256_andnot_pd(exceeded, _mm256_set1_pd(1.0)));
+
+			__m256d diff_u = _mm256_sub_pd(new_u, impulse_u);
+			__m256d diff_w = _mm256_sub_pd(new_w, impulse_w);
+			__m256d friction_changed = _mm256_or_pd(significantChange(diff_u), significantChange(diff_w));
+			diff_u = _mm256_and_pd(diff_u, friction_changed);
+			diff_w = _mm256_and_pd(diff_w, friction_changed);
+
+			for (int k = 0; k < 6; k++) {
+				va[k] = _mm256_add_pd(va[k], _mm256_add_pd(_mm256_mul_pd(diff_u, loadLanes(b->friction_impulse_to_a_velocity[0][k])), _mm256_mul_pd(diff_w, loadLanes(b->friction_impulse_to_a_velocity[1][k]))));
+				vb[k] = _mm256_add_pd(vb[k], _mm256_add_pd(_mm256_mul_pd(diff_u, loadLanes(b->friction_impulse_to_b_velocity[0][k])), _mm256_mul_pd(diff_w, loadLanes(b->friction_impulse_to_b_velocity[1][k]))));
+			}
+			_mm256_storeu_pd(b->friction_impulse[0], _mm256_add_pd(impulse_u, diff_u));
+			_mm256_storeu_pd(b->friction_impulse[1], _mm256_add_pd(impulse_w, diff_w));
+			residual = _mm256_max_pd(residual, _mm256_max_pd(absolute(diff_u), absolute(diff_w)));
+		}
+
+		double va_lanes[6][4], vb_lanes[6][4];
+		for (int k = 0; k < 6; k++) {
+			_mm256_storeu_pd(va_lanes[k], va[k]);
+			_mm256_storeu_pd(vb_lanes[k], vb[k]);
+		}
+		//index 0 is shared by the non dynamic bodies and always stays zero, it is also what unused lanes point to
+		for (int l = 0; l < b->n_lanes; l++) {
+			if (b->a_index[l] != 0) for (int k = 0; k < 6; k++) velocity_changes[b->a_index[l]].v[k] = va_lanes[k][l];
+			if (b->b_index[l] != 0) for (int k = 0; k < 6; k++) velocity_changes[b->b_index[l]].v[k] = vb_lanes[k][l];
+		}
+
+		double residual_lanes[4];
+		_mm256_storeu_pd(residual_lanes, residual);
+		return std::max<double>(std::max<double>(residual_lanes[0], residual_lanes[1]), std::max<double>(residual_lanes[2], residual_lanes[3]));
+	}
+
+	static bool cpuSupportsAVX() {
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		bool os_saves_ymm = (info[2] & (1 << 27)) != 0;
+		bool has_avx = (info[2] & (1 << 28)) != 0;
+		//the OS must also save the upper halves of the ymm registers on context switches
+		return os_saves_ymm && has_avx && (_xgetbv(0) & 6) == 6;
+#else
+		return __builtin_cpu_supports("avx");
+#endif
+	}
+#endif
+
+	typedef double (*ContactBatchKernel)(ContactRowBatch*, mthz::NVec<6>*, bool);
+
+	static ContactBatchKernel selectKernel() {
+#ifdef CONTACT_BATCH_AVX
+		if (cpuSupportsAVX()) return solveContactBatchAVX;
+#endif
+		return solveContactBatchScalar;
+	}
+
+	static const ContactBatchKernel contact_batch_kernel = selectKernel();
+
+	double solveContactBatch(ContactRowBatch* batch, mthz::NVec<6>* velocity_changes, bool use_psuedo_values) {
+		return contact_batch_kernel(batch, velocity_changes, use_psuedo_values);
+	}
+
+	bool contactBatchSolverVectorized() {
+		return contact_batch_kernel != solveContactBatchScalar;
+	}
+}
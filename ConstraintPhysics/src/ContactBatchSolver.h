@@ -0,0 +1,43 @@
+#pragma once
+#include "SolverPrecision.h"
+#include "../../Math/src/NVec.h"
+
+namespace phyz {
+
+	//up to WIDTH contact rows (a contact and its friction) that share no dynamic body, stored lane by lane so they can be solved
+	//together with vector instructions. Unused lanes and lanes without friction are zeroed, which makes them have no effect
+	struct ContactRowBatch {
+		static const int WIDTH = 4;
+
+		int n_lanes;
+		int contact_index[WIDTH]; //row in SolverRows::contacts
+		int a_index[WIDTH];
+		int b_index[WIDTH];
+
+		solver_real a_jacobian[6][WIDTH];
+		solver_real b_jacobian[6][WIDTH];
+		solver_real impulse_to_a_velocity[6][WIDTH];
+		solver_real impulse_to_b_velocity[6][WIDTH];
+		solver_real impulse_to_value_inverse[WIDTH];
+		double target_val[WIDTH];
+		double psuedo_target_val[WIDTH];
+		double impulse[WIDTH];
+		double psuedo_impulse[WIDTH];
+
+		solver_real friction_a_jacobian[2][6][WIDTH];
+		solver_real friction_b_jacobian[2][6][WIDTH];
+		solver_real friction_impulse_to_a_velocity[2][6][WIDTH];
+		solver_real friction_impulse_to_b_velocity[2][6][WIDTH];
+		solver_real friction_impulse_to_value_inverse[2][2][WIDTH];
+		double friction_target_val[2][WIDTH];
+		double friction_impulse[2][WIDTH];
+		double coeff_friction[WIDTH];
+		double normal_impulse_limit[WIDTH];
+		double static_ready[WIDTH]; //nonzero if the last friction impulse was inside the friction cone
+	};
+
+	//one PGS step of every lane of the batch, with the same arithmetic as solving the rows one at a time. Returns the largest impulse change.
+	//Uses AVX when the CPU supports it, otherwise a scalar loop over the lanes
+	double solveContactBatch(ContactRowBatch* batch, mthz::NVec<6>* velocity_changes, bool use_psuedo_values);
+	bool contactBatchSolverVectorized();
+}
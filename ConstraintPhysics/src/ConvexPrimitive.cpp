@@ -4,6 +4,7 @@
 #include <limits>
 #include <algorithm>
 #include <cassert>
+#include <set>
 
 namespace phyz {
 
@@ -94,6 +95,48 @@ namespace phyz {
 		return copy;
 	}
 
+	AABB ConvexPrimitive::gen_AABB(const mthz::Mat3& rot, mthz::Vec3 trans, AABBSupportHints* hints) const {
+		switch (type) {
+		case POLYHEDRON:
+		{
+			//world axis i seen from local coordinates is row i of the rotation. Extrema are found by hill climbing from the last ones
+			const Polyhedron& p = (const Polyhedron&)*geometry;
+			const std::vector<mthz::Vec3>& points = p.getPoints();
+			AABB out;
+			for (int i = 0; i < 3; i++) {
+				mthz::Vec3 axis(rot.v[i][0], rot.v[i][1], rot.v[i][2]);
+				hints->min_vertex[i] = p.getSupportPointIndex(-axis, hints->min_vertex[i]);
+				hints->max_vertex[i] = p.getSupportPointIndex(axis, hints->max_vertex[i]);
+				out.min[i] = points[hints->min_vertex[i]].dot(axis) + trans[i];
+				out.max[i] = points[hints->max_vertex[i]].dot(axis) + trans[i];
+			}
+			return out;
+		}
+		case SPHERE:
+		{
+			const Sphere& s = (const Sphere&)*geometry;
+			mthz::Vec3 center = rot * s.getCenter() + trans;
+			mthz::Vec3 r(s.getRadius(), s.getRadius(), s.getRadius());
+			return AABB{ center - r, center + r };
+		}
+		case CYLINDER:
+		{
+			//a disk of normal n extends r * sqrt(1 - n_i^2) along axis i. Uses the radius of the face approximations so they are contained too
+			const Cylinder& c = (const Cylinder&)*geometry;
+			mthz::Vec3 center = rot * c.getCenter() + trans;
+			mthz::Vec3 height_axis = rot * c.getHeightAxis();
+			double radius = c.getApproximationRadius();
+			mthz::Vec3 half_dim;
+			for (int i = 0; i < 3; i++) {
+				half_dim[i] = abs(height_axis[i]) * c.getHeight() / 2.0 + radius * sqrt(std::max<double>(0, 1 - height_axis[i] * height_axis[i]));
+			}
+			return AABB{ center - half_dim, center + half_dim };
+		}
+		}
+		assert(false);
+		return AABB();
+	}
+
 	RayQueryReturn ConvexPrimitive::testRayIntersection(mthz::Vec3 ray_origin, mthz::Vec3 ray_dir) const {
 		switch (type) {
 		case POLYHEDRON:	return ((Polyhedron*)geometry)->testRayIntersection(ray_origin, ray_dir);
@@ -143,6 +186,10 @@ namespace phyz {
 		}
 	}
 
+	double Cylinder::getApproximationRadius() const {
+		return radius / cos(PI / top_face_approximation.size());
+	}
+
 	Cylinder Cylinder::getRotated(const mthz::Quaternion q, mthz::Vec3 pivot_point) const {
 		mthz::Vec3 new_center = pivot_point + q.applyRotation(center - pivot_point);
 		mthz::Vec3 new_height_axis = q.applyRotation(height_axis);
@@ -348,17 +395,6 @@ namespace phyz {
 		return RayQueryReturn{ true, hit_p, norm, t };
 	}
 
-	Polyhedron::Polyhedron(const Polyhedron& c)
-		: gauss_map(c.gauss_map), points(c.points), interior_point(c.interior_point), adjacent_faces_to_vertex(c.adjacent_faces_to_vertex), adjacent_edges_to_vertex(c.adjacent_edges_to_vertex)
-	{
-		for (int i = 0; i < c.surfaces.size(); i++) {
-			surfaces.push_back(Surface(c.surfaces[i], this));
-		}
-		for (int i = 0; i < c.edges.size(); i++) {
-			edges.push_back(Edge(c.edges[i], this));
-		}
-	}
-
 	Polyhedron Polyhedron::getPolyAfterFindMergedCoplanarFaces(const Polyhedron& p) {
 		struct SurfaceGroup {
 			mthz::Vec3 shared_norm;
@@ -389,7 +425,7 @@ namespace phyz {
 		for (const SurfaceGroup& g : groups) {
 			std::vector<int> extrema_point_indices;
 
-			if (g.surfaces.size() == 1) extrema_point_indices = g.surfaces[0].point_indexes;
+			if (g.surfaces.size() == 1) extrema_point_indices = std::vector<int>(g.surfaces[0].point_indexes.begin(), g.surfaces[0].point_indexes.end());
 			else {
 				//since p is convex, then all surfaces are also convex. Treat vertices as a point cloud, and use gift wrapping to generate the outer surface
 				struct FaceCoordP {
@@ -481,8 +517,55 @@ namespace phyz {
 		return Polyhedron(remaining_vertices, surface_vertex_indices);
 	}
 
+	static mthz::Vec3 outwardSurfaceNormal(const std::vector<mthz::Vec3>& points, const std::vector<int>& s, mthz::Vec3 interior_point) {
+		mthz::Vec3 p0 = points[s[0]];
+		mthz::Vec3 p1 = points[s[1]];
+		int normal_calc_index = 2;
+		mthz::Vec3 v1 = (p1 - p0).normalize();
+		mthz::Vec3 v2 = (points[s[normal_calc_index]] - p0).normalize();
+		while (abs(v1.dot(v2)) > 0.99 && normal_calc_index + 1 < s.size()) {
+			v2 = (points[s[++normal_calc_index]] - p0).normalize();
+		}
+
+		mthz::Vec3 n = (p1 - p0).cross(points[s[normal_calc_index]] - p1).normalize();
+		return (n.dot(p0 - interior_point) < 0) ? -n : n;
+	}
+
+	//returns true if the winding was reversed
+	static bool setWindingAntiClockwise(const std::vector<mthz::Vec3>& points, std::vector<int>* s, mthz::Vec3 normal) {
+		//if winding is anti-clockwise to normal, greens theorem will yield a positive area
+		mthz::Vec3 u, w;
+		normal.getPerpendicularBasis(&u, &w);
+		double area = 0;
+		int n_points = s->size();
+		for (int i = 0; i < n_points; i++) {
+			mthz::Vec3 p1 = points[(*s)[i]];
+			mthz::Vec3 p2 = points[(*s)[(i + 1 == n_points) ? 0 : i + 1]];
+			area += (p2.dot(w) - p1.dot(w)) * (p2.dot(u) + p1.dot(u)) / 2.0;
+		}
+
+		//reverse if winding was clockwise
+		if (area < 0) {
+			std::reverse(s->begin(), s->end());
+			return true;
+		}
+		return false;
+	}
+
+	//appends an offset table for lists followed by the lists themselves, returns the index of the offset table
+	static uint32_t appendPackedLists(std::vector<uint32_t>* topology, const std::vector<std::vector<int>>& lists) {
+		uint32_t table = topology->size();
+		topology->resize(table + lists.size() + 1);
+		for (int i = 0; i < lists.size(); i++) {
+			(*topology)[table + i] = topology->size();
+			for (int j : lists[i]) topology->push_back(j);
+		}
+		(*topology)[table + lists.size()] = topology->size();
+		return table;
+	}
+
 	Polyhedron::Polyhedron(const std::vector<mthz::Vec3>& points, const std::vector<std::vector<int>>& surface_vertex_indices)
-		: points(points), adjacent_faces_to_vertex(points.size()), adjacent_edges_to_vertex(points.size())
+		: points(points), n_surfaces(surface_vertex_indices.size())
 	{
 		assert(points.size() >= 4);
 
@@ -493,55 +576,59 @@ namespace phyz {
 		}
 		interior_point /= points.size();
 
-		//create surfaces
-		int surfaceID = points.size();
-		surfaces.reserve(surface_vertex_indices.size());
-		for (int i = 0; i < surface_vertex_indices.size(); i++) {
-			const std::vector<int>& s = surface_vertex_indices[i];
-			for (int j : s) {
+		//orient surfaces
+		std::vector<std::vector<int>> surfaces = surface_vertex_indices;
+		std::vector<mthz::Vec3> surface_normals(n_surfaces);
+		std::vector<std::vector<int>> adjacent_faces_to_vertex(points.size());
+		int n_surface_vertices = 0;
+		for (int i = 0; i < n_surfaces; i++) {
+			assert(surfaces[i].size() >= 3);
+			for (int j : surfaces[i]) {
 				assert(j >= 0 && j < points.size());
 				adjacent_faces_to_vertex[j].push_back(i);
 			}
-			surfaces.push_back(Surface(s, this, interior_point, surfaceID++));
+			surface_normals[i] = outwardSurfaceNormal(points, surfaces[i], interior_point);
+			if (setWindingAntiClockwise(points, &surfaces[i], surface_normals[i])) {
+				surface_normals[i] = outwardSurfaceNormal(points, surfaces[i], interior_point);
+			}
+			n_surface_vertices += surfaces[i].size();
 		}
 
 		//create edges
-		struct Pair {
-			int p1;
-			int p2;
-
-			bool operator==(const Pair p) {
-				return (p1 == p.p1 && p2 == p.p2) || (p2 == p.p1 && p1 == p.p2);
-			}
-		};
-		std::vector<Pair> seen_pairs;
-		for (const Surface& s : surfaces) {
-			int n = s.point_indexes.size();
+		std::vector<std::pair<int, int>> edge_list;
+		std::set<std::pair<int, int>> seen_pairs;
+		for (const std::vector<int>& s : surfaces) {
+			int n = s.size();
 			for (int i = 0; i < n; i++) {
-				Pair p = Pair{ s.point_indexes[i], s.point_indexes[(i + 1) % n] };
-
-				bool seen = false;
-				for (const Pair pair : seen_pairs) {
-					if (p == pair) {
-						seen = true;
-						break;
-					}
-				}
-
-				if (!seen) {
-					seen_pairs.push_back(p);
+				int p1 = s[i];
+				int p2 = s[(i + 1) % n];
+				if (seen_pairs.insert({ std::min<int>(p1, p2), std::max<int>(p1, p2) }).second) {
+					edge_list.push_back({ p1, p2 });
 				}
 			}
 		}
-		edges = std::vector<Edge>(seen_pairs.size());
-		for (int i = 0; i < seen_pairs.size(); i++) {
-			Pair pair = seen_pairs[i];
-			edges[i] = Edge(pair.p1, pair.p2, this);
-			adjacent_edges_to_vertex[pair.p1].push_back(i);
-			adjacent_edges_to_vertex[pair.p2].push_back(i);
+		n_edges = edge_list.size();
+
+		std::vector<std::vector<int>> adjacent_edges_to_vertex(points.size());
+		for (int i = 0; i < n_edges; i++) {
+			adjacent_edges_to_vertex[edge_list[i].first].push_back(i);
+			adjacent_edges_to_vertex[edge_list[i].second].push_back(i);
+		}
+
+		//pack topology. Every surface vertex is also one face adjacency entry, and every edge two edge adjacency entries
+		std::shared_ptr<std::vector<uint32_t>> packed = std::make_shared<std::vector<uint32_t>>();
+		packed->reserve(3 * (points.size() + 1) + n_surfaces + 2 * n_surface_vertices + 4 * n_edges);
+		surface_vertices_table = appendPackedLists(packed.get(), surfaces);
+		edges_start = packed->size();
+		for (const std::pair<int, int>& e : edge_list) {
+			packed->push_back(e.first);
+			packed->push_back(e.second);
 		}
+		vertex_faces_table = appendPackedLists(packed.get(), adjacent_faces_to_vertex);
+		vertex_edges_table = appendPackedLists(packed.get(), adjacent_edges_to_vertex);
+		topology = packed;
 
-		gauss_map = computeGaussMap();
+		gauss_map = computeGaussMap(surface_normals);
 
 #ifndef ndebug
 		//confirm all surfaces are actually flat
@@ -630,8 +717,32 @@ namespace phyz {
 
 	}
 
+	//polyhedra are convex, so walking to any neighbor further along dir until none remain finds the extrema
+	int Polyhedron::getSupportPointIndex(mthz::Vec3 dir, int start_index) const {
+		int curr = (start_index >= 0 && start_index < points.size()) ? start_index : 0;
+		double curr_val = points[curr].dot(dir);
+
+		bool improved = true;
+		while (improved) {
+			improved = false;
+			for (int edge_index : getEdgeIndicesAdjacentToPointI(curr)) {
+				Edge e(this, edge_index);
+				int neighbor = (e.p1_indx == curr) ? e.p2_indx : e.p1_indx;
+				double neighbor_val = points[neighbor].dot(dir);
+				if (neighbor_val > curr_val) {
+					curr = neighbor;
+					curr_val = neighbor_val;
+					improved = true;
+					break;
+				}
+			}
+		}
+
+		return curr;
+	}
+
 	RayQueryReturn Polyhedron::testRayIntersection(mthz::Vec3 ray_origin, mthz::Vec3 ray_dir) {
-		for (const Surface& s : surfaces) {
+		for (const Surface& s : getSurfaces()) {
 			mthz::Vec3 sp = s.getPointI(0);
 			mthz::Vec3 n = s.normal();
 			double eps = 0.0001;
@@ -656,127 +767,26 @@ namespace phyz {
 		return { false };
 	}
 
-	Edge::Edge(int p1_indx, int p2_indx, Polyhedron* poly) {
-		this->poly = poly;
-		this->p1_indx = p1_indx;
-		this->p2_indx = p2_indx;
-	}
-
-	Edge::Edge(const Edge& e, Polyhedron* poly) {
-		this->poly = poly;
-		p1_indx = e.p1_indx;
-		p2_indx = e.p2_indx;
-	}
-	Edge::Edge() {
-		p1_indx = 0;
-		p2_indx = 0;
-		poly = nullptr;
-	}
-
-	Surface::Surface(const std::vector<int>& point_indexes, Polyhedron* poly, mthz::Vec3 interior_point, int surfaceID)
-		: point_indexes(point_indexes), poly(poly), surfaceID(surfaceID)
-	{
-		assert(point_indexes.size() >= 3);
-
-		findNormalCalcInfo(poly->points[point_indexes[0]] - interior_point);
-		setWindingAntiClockwise(normal());
-	}
-
-	Surface::Surface(const Surface& s, Polyhedron* poly)
-		: point_indexes(s.point_indexes), normalDirection(s.normalDirection), poly(poly), surfaceID(s.surfaceID),
-		normal_calc_index(s.normal_calc_index)
-	{}
-
-	Surface::Surface() {
-		poly = nullptr;
-	}
-
-	void Surface::findNormalCalcInfo(const mthz::Vec3& normalish) {
-		mthz::Vec3 p0 = poly->points[point_indexes[0]];
-		mthz::Vec3 p1 = poly->points[point_indexes[1]];
-		normal_calc_index = 2;
-		mthz::Vec3 v1 = (p1 - p0).normalize();
-		mthz::Vec3 v2 = (poly->points[point_indexes[normal_calc_index]] - p0).normalize();
-		while (abs(v1.dot(v2)) > 0.99 && normal_calc_index + 1 < point_indexes.size()) {
-			v2 = (poly->points[point_indexes[++normal_calc_index]] - p0).normalize();
-			assert(normal_calc_index < point_indexes.size());
-		}
-
-		normalDirection = 1; //initial guess
-		if (normalish.dot(normal()) < 0) {
-			normalDirection = -1;
-		}
-	}
-
-	mthz::Vec3 Surface::normal() const {
-		mthz::Vec3 p1 = poly->points[point_indexes[0]];
-		mthz::Vec3 p2 = poly->points[point_indexes[1]];
-		mthz::Vec3 p3 = poly->points[point_indexes[normal_calc_index]];
-
-		return (p2 - p1).cross(p3 - p2).normalize() * normalDirection;
-	}
-
-	int Surface::n_points() const {
-		return point_indexes.size();
-	}
-
-
-	mthz::Vec3 Surface::getPointI(int i) const {
-		assert(i >= 0 && i < point_indexes.size());
-		return poly->points[point_indexes[i]];
-	}
-
-	void Surface::setWindingAntiClockwise(const mthz::Vec3& normal) {
-		 //if winding is anti-clockwise to normal, greens theorem will yield a positive area
-		mthz::Vec3 u, w;
-		normal.getPerpendicularBasis(&u, &w);
-		double area = 0;
-		for (int i = 0; i < n_points(); i++) {
-			int i1 = i;
-			int i2 = (i + 1 == n_points()) ? 0 : i+1;
-
-			double p1_u, p1_w, p2_u, p2_w;
-			mthz::Vec3 p1 = getPointI(i1);
-			mthz::Vec3 p2 = getPointI(i2);
-			
-			p1_u = p1.dot(u);
-			p1_w = p1.dot(w);
-			p2_u = p2.dot(u);
-			p2_w = p2.dot(w);
-
-			area += (p2_w - p1_w) * (p2_u + p1_u) / 2.0;
-		}
-
-		//reverse if winding was clockwise
-		if (area < 0) {
-			for (int i = 0; i < point_indexes.size() / 2; i++) {
-				int j = point_indexes.size() - 1 - i;
-
-				int tmp = point_indexes[j];
-				point_indexes[j] = point_indexes[i];
-				point_indexes[i] = tmp;
-			}
-			findNormalCalcInfo(normal);
- 		}
-	}
-
-	GaussMap Polyhedron::computeGaussMap() const {
+	GaussMap Polyhedron::computeGaussMap(const std::vector<mthz::Vec3>& surface_normals) const {
 		GaussMap g;
-		for (int i = 0; i < surfaces.size(); i++) {
-			const Surface& s1 = surfaces[i];
+		std::shared_ptr<std::vector<GaussArc>> arcs = std::make_shared<std::vector<GaussArc>>();
+		g.face_verts.reserve(n_surfaces);
+		for (int i = 0; i < n_surfaces; i++) {
+			Surface s1(this, i);
+			mthz::Vec3 n1 = surface_normals[i];
 
 			bool redundant = false;
 			for (GaussVert& g : g.face_verts) {
-				if (s1.normal().dot(g.v) < -1 + EPS) {
+				if (n1.dot(g.v) < -1 + EPS) {
 					redundant = true;
 					break;
 				}
 			}
 			int reference_point_index = s1.point_indexes[0];
-			g.face_verts.push_back(GaussVert{ s1.normal(), redundant, findExtrema(*this, s1.normal()), reference_point_index, s1.normal().dot(points[reference_point_index]) });
+			g.face_verts.push_back(GaussVert{ n1, redundant, findExtrema(*this, n1), reference_point_index, n1.dot(points[reference_point_index]) });
 
-			for (int j = i + 1; j < surfaces.size(); j++) {
-				const Surface& s2 = surfaces[j];
+			for (int j = i + 1; j < n_surfaces; j++) {
+				Surface s2(this, j);
 
 				for (int k = 0; k < s1.n_points(); k++) {
 					for (int w = 0; w < s2.n_points(); w++) {
@@ -787,13 +797,14 @@ namespace phyz {
 
 						//if si and sj share an edge, there exists an arc between v1 and v2 on the gauss map
 						if ((s1_indx1 == s2_indx1 && s1_indx2 == s2_indx2) || (s1_indx1 == s2_indx2 && s1_indx2 == s2_indx1)) {
-							g.arcs.push_back(GaussArc{ (unsigned int)i, (unsigned int)j });
+							arcs->push_back(GaussArc{ (unsigned int)i, (unsigned int)j });
 							break;
 						}
 					}
 				}
 			}
 		}
+		g.arcs = arcs;
 		return g;
 	}
 }
\ No newline at end of file
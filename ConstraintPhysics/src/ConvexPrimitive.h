@@ -8,8 +8,12 @@
 #include "CollisionDetect.h"
 #include "AABB_Tree.h"
 #include <vector>
+#include <memory>
+#include <cinttypes>
+#include <cassert>
 
 namespace phyz {
+	class Polyhedron;
 	class Surface;
 	class Edge;
 	class RigidBody;
@@ -48,6 +52,12 @@ namespace phyz {
 		double intersection_dist;
 	};
 
+	//polyhedron vertices that were extremal along each world axis the last time a tight AABB was found, where the next search starts from
+	struct AABBSupportHints {
+		int min_vertex[3] = { 0, 0, 0 };
+		int max_vertex[3] = { 0, 0, 0 };
+	};
+
 	class ConvexPrimitive {
 	public:
 		ConvexPrimitive() {}
@@ -62,6 +72,7 @@ namespace phyz {
 		ConvexPrimitive getTranslated(mthz::Vec3 t) const;
 		ConvexPrimitive getScaled(double d, mthz::Vec3 center_of_dialtion) const;
 		inline AABB gen_AABB() const { return geometry->gen_AABB(); }
+		AABB gen_AABB(const mthz::Mat3& rot, mthz::Vec3 trans, AABBSupportHints* hints) const; //exact AABB of the primitive once transformed, without transforming it
 		inline void recomputeFromReference(const ConvexGeometry& reference, const mthz::Mat3& rot, mthz::Vec3 trans) { geometry->recomputeFromReference(reference, rot, trans); }
 		inline int getID() const { return id; }
 
@@ -118,7 +129,7 @@ namespace phyz {
 
 	struct GaussMap {
 		std::vector<GaussVert> face_verts;
-		std::vector<GaussArc> arcs;
+		std::shared_ptr<const std::vector<GaussArc>> arcs; //arcs never change with rotation, so copies of a polyhedron share them
 	};
 
 	class Cylinder : ConvexGeometry {
@@ -136,6 +147,7 @@ namespace phyz {
 
 		inline double getRadius() const { return radius; }
 		inline double getHeight() const { return height; }
+		double getApproximationRadius() const; //the polygons approximating the faces encapsulate the disks, so reach slightly further than radius
 		inline int getTopApproxPointIDOffset() const { return 0; }
 		inline int getBotApproxPointIDOffset() const { return top_face_approximation.size(); }
 		inline int getTopSurfaceID() const { return 2 * top_face_approximation.size(); }
@@ -170,10 +182,47 @@ namespace phyz {
 		double height;
 	};
 
+	//non-owning view of a run of a polyhedron's packed topology indices
+	struct IndexSpan {
+		const uint32_t* first;
+		uint32_t count;
+
+		inline uint32_t operator[](int i) const { return first[i]; }
+		inline int size() const { return count; }
+		inline const uint32_t* begin() const { return first; }
+		inline const uint32_t* end() const { return first + count; }
+	};
+
+	//Surfaces and Edges aren't stored anywhere, they are light views onto the polyhedron's packed arrays built when accessed
+	template<typename Feature>
+	class FeatureList {
+	public:
+		class Iterator {
+		public:
+			Iterator(const Polyhedron* poly, int index) : poly(poly), index(index) {}
+
+			inline Feature operator*() const { return Feature(poly, index); }
+			inline Iterator& operator++() { index++; return *this; }
+			inline bool operator!=(const Iterator& i) const { return index != i.index; }
+		private:
+			const Polyhedron* poly;
+			int index;
+		};
+
+		FeatureList(const Polyhedron* poly, int count) : poly(poly), count(count) {}
+
+		inline Feature operator[](int i) const { return Feature(poly, i); }
+		inline int size() const { return count; }
+		inline Iterator begin() const { return Iterator(poly, 0); }
+		inline Iterator end() const { return Iterator(poly, count); }
+	private:
+		const Polyhedron* poly;
+		int count;
+	};
+
 	class Polyhedron : ConvexGeometry {
 	public:
 		Polyhedron() {}
-		Polyhedron(const Polyhedron& c);
 		Polyhedron(const std::vector<mthz::Vec3>& points, const std::vector<std::vector<int>>& surface_vertex_indices);
 
 		//polyhedrons don't work well as colliders if they have coplanar faces. This method
@@ -189,11 +238,12 @@ namespace phyz {
 		ConvexGeometryType getType() const override { return POLYHEDRON; };
 
 		inline const std::vector<mthz::Vec3>& getPoints() const { return points; }
-		inline const std::vector<Surface>& getSurfaces() const { return surfaces; }
-		inline const std::vector<Edge>& getEdges() const { return edges; }
-		inline const std::vector<int>& getFaceIndicesAdjacentToPointI(int i) const { return adjacent_faces_to_vertex[i]; }
-		inline const std::vector<int>& getEdgeIndicesAdjacentToPointI(int i) const { return adjacent_edges_to_vertex[i]; }
+		inline FeatureList<Surface> getSurfaces() const;
+		inline FeatureList<Edge> getEdges() const;
+		inline IndexSpan getFaceIndicesAdjacentToPointI(int i) const { return packedList(vertex_faces_table, i); }
+		inline IndexSpan getEdgeIndicesAdjacentToPointI(int i) const { return packedList(vertex_edges_table, i); }
 		inline const GaussMap& getGaussMap() const { return gauss_map; }
+		int getSupportPointIndex(mthz::Vec3 dir, int start_index=0) const;
 
 		RayQueryReturn testRayIntersection(mthz::Vec3 ray_origin, mthz::Vec3 ray_dir);
 
@@ -202,55 +252,62 @@ namespace phyz {
 		friend class RigidBody;
 	private:
 
-		GaussMap computeGaussMap() const;
-		GaussMap gauss_map;
+		GaussMap computeGaussMap(const std::vector<mthz::Vec3>& surface_normals) const;
+		inline IndexSpan packedList(uint32_t table, int i) const {
+			const uint32_t* t = topology->data();
+			return IndexSpan{ t + t[table + i], t[table + i + 1] - t[table + i] };
+		}
 
-		std::vector<std::vector<int>> adjacent_faces_to_vertex;
-		std::vector<std::vector<int>> adjacent_edges_to_vertex;
+		//face normals are the vertices of the gauss map
+		GaussMap gauss_map;
 		std::vector<mthz::Vec3> points;
-		std::vector<Surface> surfaces;
-		std::vector<Edge> edges;
+
+		//all topology lives in this one array. Surface vertices, faces adjacent to each vertex and edges adjacent to each vertex are
+		//stored as runs located by an offset table of size n+1 at the given table index. Edges are stored as pairs of point indices at edges_start.
+		//topology is immutable once built and shared between every copy of the polyhedron, only points and normals are per copy.
+		std::shared_ptr<const std::vector<uint32_t>> topology;
+		uint32_t n_surfaces = 0;
+		uint32_t n_edges = 0;
+		uint32_t surface_vertices_table = 0;
+		uint32_t edges_start = 0;
+		uint32_t vertex_faces_table = 0;
+		uint32_t vertex_edges_table = 0;
 	public: mthz::Vec3 interior_point;
 	};
 
 	class Edge {
 	public:
-		Edge(int p1_indx, int p2_indx, Polyhedron* poly);
-		Edge(const Edge& e, Polyhedron* poly);
-		Edge();
+		Edge(const Polyhedron* poly, int edge_index)
+			: p1_indx((*poly->topology)[poly->edges_start + 2 * edge_index]), p2_indx((*poly->topology)[poly->edges_start + 2 * edge_index + 1]), poly(poly)
+		{}
 
 		inline mthz::Vec3 p1() const { return poly->points[p1_indx]; }
 		inline mthz::Vec3 p2() const { return poly->points[p2_indx]; }
 
 		int p1_indx;
 		int p2_indx;
-		friend class Polyhedron;
 	private:
-		Polyhedron* poly;
-		
+		const Polyhedron* poly;
 	};
 
 	class Surface {
 	public:
-		Surface(const std::vector<int>& point_indexes, Polyhedron* poly, mthz::Vec3 interior_point, int surfaceID = -1);
-		Surface(const Surface& s, Polyhedron* poly);
-		Surface();
+		Surface(const Polyhedron* poly, int surface_index)
+			: point_indexes(poly->packedList(poly->surface_vertices_table, surface_index)), poly(poly), surface_index(surface_index)
+		{}
 
-		int n_points() const;
-		mthz::Vec3 normal() const;
-		mthz::Vec3 getPointI(int i) const;
-		inline int getSurfaceID() const { return surfaceID; }
+		inline int n_points() const { return point_indexes.size(); }
+		inline mthz::Vec3 normal() const { return poly->gauss_map.face_verts[surface_index].v; }
+		inline mthz::Vec3 getPointI(int i) const { assert(i >= 0 && i < point_indexes.size()); return poly->points[point_indexes[i]]; }
+		inline int getSurfaceID() const { return poly->points.size() + surface_index; }
 
-		std::vector<int> point_indexes;
-		friend class Polyhedron;
+		IndexSpan point_indexes;
 	private:
-		void findNormalCalcInfo(const mthz::Vec3& normalish);
-		void setWindingAntiClockwise(const mthz::Vec3& normal);
-
-		Polyhedron* poly;
-		int normal_calc_index;
-		int surfaceID;
-		int normalDirection;
+		const Polyhedron* poly;
+		int surface_index;
 	};
 
+	FeatureList<Surface> Polyhedron::getSurfaces() const { return FeatureList<Surface>(this, n_surfaces); }
+	FeatureList<Edge> Polyhedron::getEdges() const { return FeatureList<Edge>(this, n_edges); }
+
 }
\ No newline at end of file
@@ -1,118 +1,132 @@
 #include "HolonomicBlockSolver.h"
 #include "ConstraintSolver.h"
-#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <set>
+#include "ThreadManager.h"
 
 namespace phyz {
 
-	static int get_edge_map_index(int num_constraints, int c1_index, int c2_index) {
-		return c1_index + c2_index * num_constraints;
-	}
+	//constraints are coupled when they act on a common body. Built from per body lists, so costs the number of couplings rather than n^2
+	static std::vector<std::vector<int>> couplingGraph(const std::vector<Constraint*>& constraints) {
+		std::unordered_map<RigidBody*, std::vector<int>> body_constraints;
+		for (int i = 0; i < constraints.size(); i++) {
+			assert(constraints[i]->a != nullptr && constraints[i]->b != nullptr);
+			body_constraints[constraints[i]->a].push_back(i);
+			if (constraints[i]->b != constraints[i]->a) body_constraints[constraints[i]->b].push_back(i);
+		}
 
-	HolonomicSystem::HolonomicSystem(std::vector<Constraint*> constraints_og_order)
-		: system_degree(0), buffer_capacity(0)
-	{
-		int n = constraints_og_order.size();
-		if (constraints_og_order.size() == 0) return;
-		//compute the proper ordering to have the most sparse system possible. Track which blocks we can ignore due to sparsity.
-		std::vector<bool> edge_map(n * n, false); //false means no edge
-		std::map<Constraint*, std::map<Constraint*, bool>> block_stays_empty;
-		std::vector<int> remaining_elimination_candidates(n);
-		//initialize edge_map which we use for finding the correct elimination order, and 
-		//block_stays_empty, which tracks which blocks we wil be able to ignore given our elimination order
-		for (int i = 0; i < n; i++) {
-			remaining_elimination_candidates[i] = i;
-			for (int j = 0; j < n; j++) {
-				Constraint* c1 = constraints_og_order[i];
-				Constraint* c2 = constraints_og_order[j];
-
-				assert(c1->a != nullptr && c1->b != nullptr);
-				if (c1->a == c2->a || c1->a == c2->b || c1->b == c2->a || c1->b == c2->b) {
-					block_stays_empty[c1][c2] = false;
-					block_stays_empty[c2][c1] = false;
-					edge_map[get_edge_map_index(n, i, j)] = true;
-					edge_map[get_edge_map_index(n, j, i)] = true;
-				}
-				else {
-					//assume true, might be overwritten to false later.
-					block_stays_empty[c1][c2] = true;
-					block_stays_empty[c2][c1] = true;
+		std::vector<std::vector<int>> coupling_graph(constraints.size());
+		for (const auto& kv : body_constraints) {
+			for (int i : kv.second) {
+				for (int j : kv.second) {
+					if (i != j) coupling_graph[i].push_back(j);
 				}
 			}
 		}
+		for (std::vector<int>& neighbors : coupling_graph) {
+			std::sort(neighbors.begin(), neighbors.end());
+			neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+		}
+		return coupling_graph;
+	}
 
-		while (!remaining_elimination_candidates.empty()) {
-			//find the next node to remove that creates the least new edges
-			int least_unconnected_neighbors_index = -1;
-			int least_unconnected_neighbors_count = INT_MAX;
-			std::vector<int> least_unconnected_neighbors;
-			for (int i = 0; i < remaining_elimination_candidates.size(); i++) {
-				//get all neighbors to constraint_i
-				std::vector<int> neighbors;
-				for (int j = 0; j < n; j++) {
-					if (j != remaining_elimination_candidates[i] && edge_map[get_edge_map_index(n, remaining_elimination_candidates[i], j)]) {
-						neighbors.push_back(j);
-					}
+	//approximate minimum degree ordering. Eliminated constraints become elements of a quotient graph that stand in for the fill edges
+	//between everything they couple, so the graph never grows. A constraint's degree is approximated by the number of its uneliminated
+	//neighbors plus the sizes of its elements, an upper bound that only needs the lists of the constraints next to the one eliminated
+	static std::vector<int> minimumDegreeOrder(const std::vector<std::vector<int>>& coupling_graph) {
+		int n = coupling_graph.size();
+		std::vector<std::vector<int>> variable_neighbors = coupling_graph;
+		std::vector<std::vector<int>> element_neighbors(n);
+		std::vector<std::vector<int>> element_variables(n);
+		std::vector<bool> eliminated(n, false);
+		std::vector<bool> absorbed(n, false);
+		std::vector<int> mark(n, -1);
+		std::vector<int> degree(n);
+
+		std::set<std::pair<int, int>> elimination_candidates; //ordered by degree, ties broken by index
+		for (int i = 0; i < n; i++) {
+			degree[i] = coupling_graph[i].size();
+			elimination_candidates.insert({ degree[i], i });
+		}
+
+		std::vector<int> order;
+		order.reserve(n);
+		while (!elimination_candidates.empty()) {
+			int p = elimination_candidates.begin()->second;
+			elimination_candidates.erase(elimination_candidates.begin());
+			eliminated[p] = true;
+			order.push_back(p);
+
+			//the new element couples everything p was coupled to, directly or through the elements it absorbs
+			std::vector<int>& variables = element_variables[p];
+			mark[p] = p;
+			for (int v : variable_neighbors[p]) {
+				if (!eliminated[v] && mark[v] != p) {
+					mark[v] = p;
+					variables.push_back(v);
 				}
-
-				//count number of neighbors not connected to each other
-				int unconnected_neighbor_count = 0;
-				for (int ni = 0; ni < neighbors.size(); ni++) {
-					for (int nj = ni + 1; nj < neighbors.size(); nj++) {
-						if (!edge_map[get_edge_map_index(n, neighbors[ni], neighbors[nj])]) unconnected_neighbor_count++;
+			}
+			for (int e : element_neighbors[p]) {
+				for (int v : element_variables[e]) {
+					if (!eliminated[v] && mark[v] != p) {
+						mark[v] = p;
+						variables.push_back(v);
 					}
 				}
-
-				if (unconnected_neighbor_count < least_unconnected_neighbors_count) {
-					least_unconnected_neighbors_count = unconnected_neighbor_count;
-					least_unconnected_neighbors_index = i;
-					least_unconnected_neighbors = neighbors;
-					if (unconnected_neighbor_count == 0) break; //not going to get better than 0
-				}
+				absorbed[e] = true;
+				element_variables[e].clear();
 			}
-
-			assert(least_unconnected_neighbors_index != -1);
-			//save ordering by pushing to constaints in the order of elimination
-			int least_unconnected = remaining_elimination_candidates[least_unconnected_neighbors_index];
-			constraints.push_back(constraints_og_order[least_unconnected]);
-			remaining_elimination_candidates.erase(remaining_elimination_candidates.begin() + least_unconnected_neighbors_index);
-			//remove node from graph
-			for (int j = 0; j < n; j++) {
-				edge_map[get_edge_map_index(n, least_unconnected, j)] = false;
-				edge_map[get_edge_map_index(n, j, least_unconnected)] = false;
-			}
-			//create edges among neighbors
-			for (int ni = 0; ni < least_unconnected_neighbors.size(); ni++) {
-				for (int nj = ni + 1; nj < least_unconnected_neighbors.size(); nj++) {
-					int ni_indx = least_unconnected_neighbors[ni];
-					int nj_indx = least_unconnected_neighbors[nj];
-
-					block_stays_empty[constraints_og_order[ni_indx]][constraints_og_order[nj_indx]] = false;
-					block_stays_empty[constraints_og_order[nj_indx]][constraints_og_order[ni_indx]] = false;
-					edge_map[get_edge_map_index(n, ni_indx, nj_indx)] = true;
-					edge_map[get_edge_map_index(n, nj_indx, ni_indx)] = true;
+			variable_neighbors[p].clear();
+			element_neighbors[p].clear();
+
+			for (int v : variables) {
+				//neighbors in the new element no longer need a direct edge
+				std::vector<int>& neighbors = variable_neighbors[v];
+				neighbors.erase(std::remove_if(neighbors.begin(), neighbors.end(), [&](int u) { return eliminated[u] || mark[u] == p; }), neighbors.end());
+				std::vector<int>& elements = element_neighbors[v];
+				elements.erase(std::remove_if(elements.begin(), elements.end(), [&](int e) { return absorbed[e]; }), elements.end());
+				elements.push_back(p);
+
+				int approximate_degree = neighbors.size();
+				for (int e : elements) approximate_degree += element_variables[e].size() - 1;
+				approximate_degree = std::min<int>(approximate_degree, n - order.size() - 1);
+
+				if (approximate_degree != degree[v]) {
+					elimination_candidates.erase({ degree[v], v });
+					degree[v] = approximate_degree;
+					elimination_candidates.insert({ degree[v], v });
 				}
 			}
 		}
 
-		//compute the required size of the buffer and fill in the block location table
-		for (int col = 0; col < constraints.size(); col++) {
+		return order;
+	}
 
-			vector_location_lookup.push_back(system_degree);
-			system_degree += constraints[col]->getDegree();
+	HolonomicSystem::HolonomicSystem(std::vector<Constraint*> constraints_og_order)
+		: system_degree(0), buffer_capacity(0), steps_since_factorization(-1), factorization_cfm(0)
+	{
+		int n = constraints_og_order.size();
+		if (constraints_og_order.size() == 0) return;
+		//order the constraints to keep the factorization as sparse as possible
+		std::vector<std::vector<int>> coupling_graph = couplingGraph(constraints_og_order);
+		std::vector<int> order = minimumDegreeOrder(coupling_graph);
 
-			for (int row = col; row < constraints.size(); row++) {
-				if (block_stays_empty[constraints[row]][constraints[col]]) {
-					block_location_table.push_back(BLOCK_EMPTY);
-				}
-				else {
-					block_location_table.push_back(buffer_capacity);
-					buffer_capacity += constraints[row]->getDegree() * constraints[col]->getDegree();
-				}
+		std::vector<int> ordered_index(n);
+		for (int i = 0; i < n; i++) {
+			ordered_index[order[i]] = i;
+			constraints.push_back(constraints_og_order[order[i]]);
+		}
+		std::vector<std::vector<int>> ordered_coupling_graph(n);
+		for (int i = 0; i < n; i++) {
+			for (int j : coupling_graph[order[i]]) {
+				ordered_coupling_graph[i].push_back(ordered_index[j]);
 			}
 		}
 
-		int MAX_CONSTRAINT_DEGREE = 6;
-		diagonal_elem_buffer_capacity = MAX_CONSTRAINT_DEGREE * system_degree;
+		computeSymbolicFactorization(ordered_coupling_graph);
+
+		diagonal_elem_buffer_capacity = buffer_capacity;
 
 #ifdef NDEBUG
 		buffer = new double[buffer_capacity + diagonal_elem_buffer_capacity];
@@ -131,6 +145,148 @@ namespace phyz {
 #endif
 	}
 
+	//builds the elimination tree, then the block structure of L from it. Below the diagonal, column j of L is non zero where the system is,
+	//plus wherever the columns of its children in the elimination tree are. Cost is proportional to the number of non zero blocks of L
+	void HolonomicSystem::computeSymbolicFactorization(const std::vector<std::vector<int>>& coupling_graph) {
+		int n = coupling_graph.size();
+
+		elimination_parent.assign(n, -1);
+		std::vector<int> ancestor(n, -1);
+		for (int j = 0; j < n; j++) {
+			for (int i : coupling_graph[j]) {
+				if (i >= j) continue;
+				//climb to the root of the subtree containing i, pointing the path straight at j on the way
+				int r = i;
+				while (ancestor[r] != -1 && ancestor[r] != j) {
+					int next = ancestor[r];
+					ancestor[r] = j;
+					r = next;
+				}
+				if (ancestor[r] == -1) {
+					ancestor[r] = j;
+					elimination_parent[r] = j;
+				}
+			}
+		}
+
+		std::vector<std::vector<int>> child_rows(n); //rows passed up from children, children always come before their parent
+		std::vector<int> mark(n, -1);
+		column_begin.resize(n + 1);
+		diagonal_locations.resize(n);
+		for (int col = 0; col < n; col++) {
+			std::vector<int> rows;
+			mark[col] = col;
+			for (int row : coupling_graph[col]) {
+				if (row > col && mark[row] != col) {
+					mark[row] = col;
+					rows.push_back(row);
+				}
+			}
+			for (int row : child_rows[col]) {
+				if (mark[row] != col) {
+					mark[row] = col;
+					rows.push_back(row);
+				}
+			}
+			std::vector<int>().swap(child_rows[col]);
+			std::sort(rows.begin(), rows.end());
+
+			int parent = elimination_parent[col];
+			assert(rows.empty() ? parent == -1 : parent == rows[0]);
+			for (int i = 1; i < rows.size(); i++) {
+				child_rows[parent].push_back(rows[i]);
+			}
+
+			//buffer holds each block column contiguously, diagonal block first
+			vector_location_lookup.push_back(system_degree);
+			system_degree += constraints[col]->getDegree();
+
+			diagonal_locations[col] = buffer_capacity;
+			buffer_capacity += constraints[col]->getDegree() * constraints[col]->getDegree();
+			column_begin[col] = block_rows.size();
+			for (int row : rows) {
+				block_rows.push_back(row);
+				block_locations.push_back(buffer_capacity);
+				buffer_capacity += constraints[row]->getDegree() * constraints[col]->getDegree();
+			}
+		}
+		column_begin[n] = block_rows.size();
+
+		row_entry_begin.assign(n + 1, 0);
+		for (int row : block_rows) row_entry_begin[row + 1]++;
+		for (int i = 0; i < n; i++) row_entry_begin[i + 1] += row_entry_begin[i];
+		row_entry_blocks.resize(block_rows.size());
+		row_entry_columns.resize(block_rows.size());
+		std::vector<int> row_fill(row_entry_begin.begin(), row_entry_begin.end() - 1);
+		for (int col = 0; col < n; col++) {
+			for (int k = column_begin[col]; k < column_begin[col + 1]; k++) {
+				int e = row_fill[block_rows[k]]++;
+				row_entry_blocks[e] = k;
+				row_entry_columns[e] = col;
+			}
+		}
+
+		//cut the elimination tree into subtrees small enough to balance between threads. Work is estimated by the block updates of each column
+		std::vector<double> subtree_work(n, 0);
+		double total_work = 0;
+		for (int col = 0; col < n; col++) {
+			int blocks = column_begin[col + 1] - column_begin[col] + 1;
+			subtree_work[col] += blocks * (blocks + 1) / 2;
+			total_work += blocks * (blocks + 1) / 2;
+			if (elimination_parent[col] != -1) subtree_work[elimination_parent[col]] += subtree_work[col];
+		}
+
+		double max_task_work = total_work / PARALLEL_SUBTREE_TASKS;
+		std::vector<int> subtree_task(n, -1); //-1 for columns joining the subtrees
+		schedule_levels.assign(1, {});
+		for (int col = n - 1; col >= 0; col--) {
+			int parent = elimination_parent[col];
+			if (subtree_work[col] > max_task_work) continue;
+
+			if (parent != -1 && subtree_task[parent] != -1) {
+				subtree_task[col] = subtree_task[parent];
+			}
+			else {
+				subtree_task[col] = schedule_levels[0].size();
+				schedule_levels[0].push_back({});
+			}
+		}
+
+		std::vector<int> level(n, 1);
+		for (int col = 0; col < n; col++) {
+			int parent = elimination_parent[col];
+			if (subtree_task[col] != -1) {
+				schedule_levels[0][subtree_task[col]].push_back(col);
+			}
+			else {
+				if (schedule_levels.size() <= level[col]) schedule_levels.resize(level[col] + 1);
+				schedule_levels[level[col]].push_back({ col });
+				if (parent != -1) level[parent] = std::max<int>(level[parent], level[col] + 1);
+			}
+		}
+	}
+
+	//runs column_action on every column after the columns below it in the elimination tree, or with reverse, after the columns above it.
+	//The order within each column's dependencies is the same either way, so results don't depend on the threads
+	template<typename Func>
+	static void forEachColumnScheduled(const std::vector<std::vector<std::vector<int>>>& schedule_levels, int n_columns, bool reverse, ThreadManager* thread_manager, int n_threads, const Func& column_action) {
+		if (thread_manager == nullptr || n_threads <= 1) {
+			if (reverse) for (int col = n_columns - 1; col >= 0; col--) column_action(col);
+			else         for (int col = 0; col < n_columns; col++) column_action(col);
+			return;
+		}
+
+		auto run_task = [&](const std::vector<int>& task) {
+			if (reverse) for (int i = task.size() - 1; i >= 0; i--) column_action(task[i]);
+			else         for (int col : task) column_action(col);
+		};
+		for (int l = 0; l < schedule_levels.size(); l++) {
+			const std::vector<std::vector<int>>& tasks = schedule_levels[reverse ? schedule_levels.size() - 1 - l : l];
+			if (tasks.size() == 1) run_task(tasks[0]);
+			else                   thread_manager->do_all(n_threads, tasks, run_task);
+		}
+	}
+
 	HolonomicSystem::~HolonomicSystem() {
 		if (constraints.size() > 0) {
 #ifdef NDEBUG
@@ -142,8 +298,11 @@ namespace phyz {
 	HolonomicSystem::HolonomicSystem(HolonomicSystem&& h)
 		: constraints(h.constraints), system_degree(h.system_degree), buffer(h.buffer), buffer_capacity(h.buffer_capacity), 
 		diagonal_elem_buffer(h.diagonal_elem_buffer), diagonal_elem_buffer_capacity(h.diagonal_elem_buffer_capacity), 
+		steps_since_factorization(h.steps_since_factorization), factorization_cfm(h.factorization_cfm),
 
-		block_location_table(std::move(h.block_location_table)), vector_location_lookup(std::move(h.vector_location_lookup))
+		column_begin(std::move(h.column_begin)), block_rows(std::move(h.block_rows)), block_locations(std::move(h.block_locations)), diagonal_locations(std::move(h.diagonal_locations)),
+		elimination_parent(std::move(h.elimination_parent)), row_entry_begin(std::move(h.row_entry_begin)), row_entry_blocks(std::move(h.row_entry_blocks)), 
+		row_entry_columns(std::move(h.row_entry_columns)), schedule_levels(std::move(h.schedule_levels)), vector_location_lookup(std::move(h.vector_location_lookup))
 #ifndef NDEBUG
 		,debug_buffer(std::move(h.debug_buffer)), debug_diagonal_elem_buffer(std::move(h.debug_diagonal_elem_buffer)), debug_inverse(std::move(h.debug_inverse))
 #endif
@@ -161,7 +320,17 @@ namespace phyz {
 		buffer_capacity = h.buffer_capacity;
 		diagonal_elem_buffer = h.diagonal_elem_buffer;
 		diagonal_elem_buffer_capacity = h.diagonal_elem_buffer_capacity;
-		block_location_table = std::move(h.block_location_table);
+		steps_since_factorization = h.steps_since_factorization;
+		factorization_cfm = h.factorization_cfm;
+		column_begin = std::move(h.column_begin);
+		block_rows = std::move(h.block_rows);
+		block_locations = std::move(h.block_locations);
+		diagonal_locations = std::move(h.diagonal_locations);
+		elimination_parent = std::move(h.elimination_parent);
+		row_entry_begin = std::move(h.row_entry_begin);
+		row_entry_blocks = std::move(h.row_entry_blocks);
+		row_entry_columns = std::move(h.row_entry_columns);
+		schedule_levels = std::move(h.schedule_levels);
 		vector_location_lookup = std::move(h.vector_location_lookup);
 #ifndef NDEBUG
 		debug_buffer = std::move(h.debug_buffer);
@@ -175,8 +344,8 @@ namespace phyz {
 	template<int n>
 	static void writeTargetDelta(DegreedConstraint<n>* constraint, std::vector<double>* target, int write_index, bool use_psuedo_values);
 
-	static void multMatWithVec(int block_width, int block_height, std::vector<double>* target, int write_index, std::vector<double>& source_vector, int source_index, double* matrix_source);
-	static void multMatTransposedWithVec(int block_width, int block_height, std::vector<double>* target, int write_index, std::vector<double>& source_vector, int source_index, double* matrix_source);
+	static void multMatWithVec(int block_width, int block_height, double* target, std::vector<double>& source_vector, int source_index, double* matrix_source);
+	static void multMatTransposedWithVec(int block_width, int block_height, double* target, std::vector<double>& source_vector, int source_index, double* matrix_source);
 
 	template<int n>
 	static void applyImpulseChange(DegreedConstraint<n>* constraint, const std::vector<double>& impulse_source, int source_index, bool use_psuedo_values) {
@@ -193,7 +362,7 @@ namespace phyz {
 		}
 	}
 
-	void HolonomicSystem::computeAndApplyImpulses(bool use_psuedo_values) {
+	void HolonomicSystem::computeAndApplyImpulses(bool use_psuedo_values, ThreadManager* thread_manager, int n_threads) {
 		//solving system d = A^-1(t - c)
 		//d: delta in impulses needed to satisfy all constraints
 		//A^1: inverse of the impulse to value matrix of this holonomic system
@@ -213,6 +382,17 @@ namespace phyz {
 			case 6: writeTargetDelta<6>((DegreedConstraint<6>*)constraints[i], &delta, pos, use_psuedo_values); break;
 			}
 		}
+
+		//a reused factorization should still shrink the error between holonomic iterations. If it doesn't, the constraints have moved too far
+		//since it was computed, which on poorly conditioned systems can blow up, so factorize again now
+		double error = 0;
+		for (double d : delta) error = std::max<double>(error, abs(d));
+		double& prev_error = last_error[use_psuedo_values ? 1 : 0];
+		if (steps_since_factorization > 0 && prev_error >= 0 && error > 0.00000001 && error > STALE_FACTORIZATION_ERROR_RATIO * prev_error) {
+			factorize(factorization_cfm, thread_manager, n_threads);
+			steps_since_factorization = 0;
+		}
+		prev_error = error;
 		
 #ifndef NDEBUG
 		if (USE_GAUSS_ELIM_FOR_INVERSE) {
@@ -231,62 +411,54 @@ namespace phyz {
 #endif
 
 		//A^-1 = (L^-t)(D^-1)(L^-1) 
-		//Multiply by L inverse (inversion is as simple as making non diagonal blocks negative)
-		std::vector<double> multByLEffect(system_degree);
-		for (int col = 0; col + 1 < constraints.size(); col++) {
-			multByLEffect = std::vector<double>(system_degree, 0); //set to zero
-
-			for (int row = col + 1; row < constraints.size(); row++) {
-				int loc = getBlockBufferLocation(row, col);
-				if (loc == BLOCK_EMPTY) continue;
-
+		//Multiply by L inverse (inversion is as simple as making non diagonal blocks negative). Each block row gathers from the columns before it
+		forEachColumnScheduled(schedule_levels, constraints.size(), false, thread_manager, n_threads, [&](int row) {
+			double multByLEffect[6];
+			int block_height = constraints[row]->getDegree();
+			int write_index = getVectorPos(row);
+
+			for (int e = row_entry_begin[row]; e < row_entry_begin[row + 1]; e++) {
+				int col = row_entry_columns[e];
 				int block_width = constraints[col]->getDegree();
-				int block_height = constraints[row]->getDegree();
-				double* block_pos = buffer + loc;
+				double* block_pos = buffer + block_locations[row_entry_blocks[e]];
 				int source_index = getVectorPos(col);
-				int write_index = getVectorPos(row);
 
-				multMatWithVec(block_width, block_height, &multByLEffect, write_index, delta, source_index, block_pos);
-			}
-
-			for (int i = 0; i < system_degree; i++) {
-				delta[i] -= multByLEffect[i];
+				multMatWithVec(block_width, block_height, multByLEffect, delta, source_index, block_pos);
+				for (int i = 0; i < block_height; i++) {
+					delta[write_index + i] -= multByLEffect[i];
+				}
 			}
-		}
+		});
 
 		//Multiply by D inverse
 		std::vector<double> multByDOut(system_degree);
 		for (int col = 0; col < constraints.size(); col++) {
 			int block_degree = constraints[col]->getDegree();
-			double* block_pos = buffer + getBlockBufferLocation(col, col);
+			double* block_pos = buffer + diagonal_locations[col];
 			int vec_index = getVectorPos(col);
-			multMatWithVec(block_degree, block_degree, &multByDOut, vec_index, delta, vec_index, block_pos);
+			multMatWithVec(block_degree, block_degree, multByDOut.data() + vec_index, delta, vec_index, block_pos);
 		}
 		delta = multByDOut;
 
-		//Multiply by L^-t
-
-		std::vector<double> multByLTEffect(6);
-		for (int col = constraints.size() - 2; col >= 0; col--) {
-			multByLTEffect = std::vector<double>(6, 0);
+		//Multiply by L^-t, each block column gathering from the rows after it
+		forEachColumnScheduled(schedule_levels, constraints.size(), true, thread_manager, n_threads, [&](int col) {
+			double multByLTEffect[6] = { 0 };
+			int block_width = constraints[col]->getDegree();
 
-			for (int row = col + 1; row < constraints.size(); row++) {
-				int loc = getBlockBufferLocation(row, col);
-				if (loc == BLOCK_EMPTY) continue;
-
-				int block_width = constraints[col]->getDegree();
+			for (int k = column_begin[col]; k < column_begin[col + 1]; k++) {
+				int row = block_rows[k];
 				int block_height = constraints[row]->getDegree();
-				double* block_pos = buffer + loc;
+				double* block_pos = buffer + block_locations[k];
 				int source_index = getVectorPos(row);
 
-				multMatTransposedWithVec(block_width, block_height, &multByLTEffect, 0, delta, source_index, block_pos);
+				multMatTransposedWithVec(block_width, block_height, multByLTEffect, delta, source_index, block_pos);
 			}
 
 			int write_pos = getVectorPos(col);
-			for (int i = 0; i < constraints[col]->getDegree(); i++) {
+			for (int i = 0; i < block_width; i++) {
 				delta[write_pos + i] -= multByLTEffect[i];
 			}
-		}
+		});
 
 #ifndef NDEBUG
 		}
@@ -379,7 +551,21 @@ namespace phyz {
 	template<int edge_width>
 	static void computeLowerDiagonalBlock(int block_width, int block_height, double* target, double* ldtb_source, double* ldtb_buffer_source);
 
-	void HolonomicSystem::computeInverse(double cfm) {
+	void HolonomicSystem::computeInverse(double cfm, int refactor_interval, ThreadManager* thread_manager, int n_threads) {
+		last_error[0] = -1;
+		last_error[1] = -1;
+
+		//the symbolic factorization only changes with the constraints, in which case the system is rebuilt
+		if (steps_since_factorization != -1 && cfm == factorization_cfm && steps_since_factorization + 1 < refactor_interval) {
+			steps_since_factorization++;
+			return;
+		}
+		steps_since_factorization = 0;
+		factorization_cfm = cfm;
+		factorize(cfm, thread_manager, n_threads);
+	}
+
+	void HolonomicSystem::factorize(double cfm, ThreadManager* thread_manager, int n_threads) {
 #ifndef NDEBUG
 		if (USE_GAUSS_ELIM_FOR_INVERSE) {
 			int row_offset = 0;
@@ -433,123 +619,93 @@ namespace phyz {
 		}
 #endif
 
-		//set initial values
-		for (int col = 0; col < constraints.size(); col++) {
+		forEachColumnScheduled(schedule_levels, constraints.size(), false, thread_manager, n_threads, [&](int col) {
+			factorizeColumn(col, cfm);
+		});
 
-			for (int row = col; row < constraints.size(); row++) {
-				Constraint* c1 = constraints[row];
-				Constraint* c2 = constraints[col];
-				int loc = getBlockBufferLocation(row, col);
-				if (loc == BLOCK_EMPTY) continue;
-
-				double* block_pos = buffer + loc;
-				computeBlockInitialValue(block_pos, c1, c2, cfm);
-			}
-		}
-
-		//debugPrintBuffer("BLOCK_VIEW", false);
-		//debugPrintBuffer("COPIED VALUES");
-
-		//compute LDL
-		for (int col = 0; col < constraints.size(); col++) {
-
-			//computing inverse of diagonal block
-			int block_loc = getBlockBufferLocation(col, col);
-			assert(block_loc != BLOCK_EMPTY);
-			double* diagonal_block = buffer + block_loc;
-			switch (constraints[col]->getDegree()) {
-			case 1: mthz::rowMajorOrderInverse<1>(diagonal_block, diagonal_block); break;
-			case 2: mthz::rowMajorOrderInverse<2>(diagonal_block, diagonal_block); break;
-			case 3: mthz::rowMajorOrderInverse<3>(diagonal_block, diagonal_block); break;
-			case 4: mthz::rowMajorOrderInverse<4>(diagonal_block, diagonal_block); break;
-			case 5: mthz::rowMajorOrderInverse<5>(diagonal_block, diagonal_block); break;
-			case 6: mthz::rowMajorOrderInverse<6>(diagonal_block, diagonal_block); break;
-			}
-
-			if (col + 1 == constraints.size()) continue; //no more blocks below or to the right of this.
+		//debugPrintBuffer("DONE");
+	}
 
-			//computing lower triagular element for this block
-			for (int row = col + 1; row < constraints.size(); row++) { //iterate per block in the column
-				int block_buffer_pos = getBlockBufferLocation(row, col);
-				if (block_buffer_pos == BLOCK_EMPTY) continue;
+	//left looking, so a column only writes to itself, reading the finished columns below it in the elimination tree
+	void HolonomicSystem::factorizeColumn(int col, double cfm) {
+		double* diagonal_block = buffer + diagonal_locations[col];
+		int begin = column_begin[col];
+		int end = column_begin[col + 1];
 
-				int target_loc = getBlockDiagonalElemBufferLocation(row, col);
-				double* diagonal_elem_target = diagonal_elem_buffer + target_loc; //we still need the old value in the lower block, so we are writing to a temporary buffer
-				int block_height = constraints[row]->getDegree();
-				int block_width = constraints[col]->getDegree();
+		//set initial values
+		computeBlockInitialValue(diagonal_block, constraints[col], constraints[col], cfm);
+		for (int k = begin; k < end; k++) {
+			computeBlockInitialValue(buffer + block_locations[k], constraints[block_rows[k]], constraints[col], cfm);
+		}
+
+		//subtract the updates from each earlier column with a block in this row. The structure of this column contains every row of
+		//that column below this one, so the targets are found walking both columns in order
+		for (int e = row_entry_begin[col]; e < row_entry_begin[col + 1]; e++) {
+			int source_col = row_entry_columns[e];
+			int source_block = row_entry_blocks[e];
+			double* ldtb_buffer_source = buffer + block_locations[source_block];
+			int target_k = begin;
+
+			for (int j = source_block; j < column_begin[source_col + 1]; j++) {
+				int ld_row = block_rows[j];
+				double* ldtb_source = diagonal_elem_buffer + block_locations[j];
+				double* target;
+				if (ld_row == col) {
+					target = diagonal_block;
+				}
+				else {
+					while (block_rows[target_k] < ld_row) target_k++;
+					assert(target_k < end && block_rows[target_k] == ld_row);
+					target = buffer + block_locations[target_k];
+				}
 
-				assert(target_loc >= 0 && target_loc + block_width * block_height <= diagonal_elem_buffer_capacity);
-				calculateLowerTriangleBlock(block_width, block_height, diagonal_elem_target, buffer + block_buffer_pos, diagonal_block);
-			}
-
-			//calculate subtraction in the lower diagonal block
-			for (int ld_col = col + 1; ld_col < constraints.size(); ld_col++) {
-				for (int ld_row = ld_col; ld_row < constraints.size(); ld_row++) {
-					int loc = getBlockBufferLocation(ld_row, col);
-					if (loc == BLOCK_EMPTY || getBlockBufferLocation(ld_col, col) == BLOCK_EMPTY) continue;
-
-					double* ldtb_source = buffer + loc;
-					double* ldtb_buffer_source = diagonal_elem_buffer + getBlockDiagonalElemBufferLocation(ld_col, col);
-					int target_loc = getBlockBufferLocation(ld_row, ld_col);
-					double* target = buffer + target_loc;
-					assert(target_loc != BLOCK_EMPTY);
-
-					switch (constraints[col]->getDegree()) {
-					case 1: computeLowerDiagonalBlock<1>(constraints[ld_col]->getDegree(), constraints[ld_row]->getDegree(), target, ldtb_source, ldtb_buffer_source); break;
-					case 2: computeLowerDiagonalBlock<2>(constraints[ld_col]->getDegree(), constraints[ld_row]->getDegree(), target, ldtb_source, ldtb_buffer_source); break;
-					case 3: computeLowerDiagonalBlock<3>(constraints[ld_col]->getDegree(), constraints[ld_row]->getDegree(), target, ldtb_source, ldtb_buffer_source); break;
-					case 4: computeLowerDiagonalBlock<4>(constraints[ld_col]->getDegree(), constraints[ld_row]->getDegree(), target, ldtb_source, ldtb_buffer_source); break;
-					case 5: computeLowerDiagonalBlock<5>(constraints[ld_col]->getDegree(), constraints[ld_row]->getDegree(), target, ldtb_source, ldtb_buffer_source); break;
-					case 6: computeLowerDiagonalBlock<6>(constraints[ld_col]->getDegree(), constraints[ld_row]->getDegree(), target, ldtb_source, ldtb_buffer_source); break;
-					}
+				switch (constraints[source_col]->getDegree()) {
+				case 1: computeLowerDiagonalBlock<1>(constraints[col]->getDegree(), constraints[ld_row]->getDegree(), target, ldtb_source, ldtb_buffer_source); break;
+				case 2: computeLowerDiagonalBlock<2>(constraints[col]->getDegree(), constraints[ld_row]->getDegree(), target, ldtb_source, ldtb_buffer_source); break;
+				case 3: computeLowerDiagonalBlock<3>(constraints[col]->getDegree(), constraints[ld_row]->getDegree(), target, ldtb_source, ldtb_buffer_source); break;
+				case 4: computeLowerDiagonalBlock<4>(constraints[col]->getDegree(), constraints[ld_row]->getDegree(), target, ldtb_source, ldtb_buffer_source); break;
+				case 5: computeLowerDiagonalBlock<5>(constraints[col]->getDegree(), constraints[ld_row]->getDegree(), target, ldtb_source, ldtb_buffer_source); break;
+				case 6: computeLowerDiagonalBlock<6>(constraints[col]->getDegree(), constraints[ld_row]->getDegree(), target, ldtb_source, ldtb_buffer_source); break;
 				}
 			}
-
-			//copy diagonal elem buffer back
-			int first_non_empty_loc = getFirstNonEmptyBlockBelowDiagonal(col);
-			if (first_non_empty_loc == BLOCK_EMPTY) continue;
-
-			assert(first_non_empty_loc >= 0 && first_non_empty_loc < buffer_capacity);
-			double* target = buffer + first_non_empty_loc;
-			int blocks_total_size = (getBlockBufferLocation(col + 1, col + 1) - first_non_empty_loc) * sizeof(double); //total size in memory of all blocks in the col beneath the diagonal.
-			assert(blocks_total_size >= 0 && (blocks_total_size / sizeof(double)) + first_non_empty_loc < buffer_capacity);
-			memcpy(target, diagonal_elem_buffer, blocks_total_size);
 		}
 
-		//debugPrintBuffer("DONE");
-	}
-
-	int HolonomicSystem::getBlockBufferLocation(int block_row, int block_column) {
-		int n = constraints.size();
-
-		assert(block_row >= 0 && block_row <= n);
-		assert(block_column <= block_row);
+		//computing inverse of diagonal block
+		switch (constraints[col]->getDegree()) {
+		case 1: mthz::rowMajorOrderInverse<1>(diagonal_block, diagonal_block); break;
+		case 2: mthz::rowMajorOrderInverse<2>(diagonal_block, diagonal_block); break;
+		case 3: mthz::rowMajorOrderInverse<3>(diagonal_block, diagonal_block); break;
+		case 4: mthz::rowMajorOrderInverse<4>(diagonal_block, diagonal_block); break;
+		case 5: mthz::rowMajorOrderInverse<5>(diagonal_block, diagonal_block); break;
+		case 6: mthz::rowMajorOrderInverse<6>(diagonal_block, diagonal_block); break;
+		}
 
-		int table_index = block_row - block_column + ((2 * n + 1) * block_column - block_column * block_column) / 2;
+		if (begin == end) return; //no blocks below this one
 
-		assert(table_index >= 0 && table_index < block_location_table.size());
+		//keep the unscaled blocks for the columns this one updates, then compute the lower triangular elements in their place
+		int first_block_loc = block_locations[begin];
+		int last_block_end = block_locations[end - 1] + constraints[block_rows[end - 1]]->getDegree() * constraints[col]->getDegree();
+		assert(last_block_end <= diagonal_elem_buffer_capacity);
+		memcpy(diagonal_elem_buffer + first_block_loc, buffer + first_block_loc, (last_block_end - first_block_loc) * sizeof(double));
 
-		return block_location_table[table_index];
-	}
-
-	int HolonomicSystem::getFirstNonEmptyBlockBelowDiagonal(int column) {
-		for (int row = column + 1; row < constraints.size(); row++) {
-			int loc = getBlockBufferLocation(row, column);
-			if (loc != BLOCK_EMPTY) return loc;
+		for (int k = begin; k < end; k++) {
+			int block_height = constraints[block_rows[k]]->getDegree();
+			int block_width = constraints[col]->getDegree();
+			calculateLowerTriangleBlock(block_width, block_height, buffer + block_locations[k], diagonal_elem_buffer + block_locations[k], diagonal_block);
 		}
-		return BLOCK_EMPTY;
 	}
 
-	int HolonomicSystem::getBlockDiagonalElemBufferLocation(int block_row, int block_column) {
-		assert(block_row >= 0 && block_row <= constraints.size());
-		assert(block_column < block_row);
+	int HolonomicSystem::getBlockBufferLocation(int block_row, int block_column) {
+		assert(block_row >= 0 && block_row < constraints.size());
+		assert(block_column <= block_row);
 
-		int loc = getBlockBufferLocation(block_row, block_column);
-		if (loc == BLOCK_EMPTY) return BLOCK_EMPTY;
+		if (block_row == block_column) return diagonal_locations[block_column];
 
-		int ret = loc - getFirstNonEmptyBlockBelowDiagonal(block_column);
-		assert(ret >= 0 && ret < diagonal_elem_buffer_capacity - constraints[block_row]->getDegree() * constraints[block_column]->getDegree());
-		return ret;
+		auto begin = block_rows.begin() + column_begin[block_column];
+		auto end = block_rows.begin() + column_begin[block_column + 1];
+		auto it = std::lower_bound(begin, end, block_row);
+		if (it == end || *it != block_row) return BLOCK_EMPTY;
+		return block_locations[it - block_rows.begin()];
 	}
 
 	template<int n>
@@ -567,38 +723,38 @@ namespace phyz {
 	}
 
 	template<int block_width, int block_height>
-	static void multMatWithVecDegreed(std::vector<double>* target, int write_index, std::vector<double>& source_vector, int source_index, double* matrix_source) {
+	static void multMatWithVecDegreed(double* target, std::vector<double>& source_vector, int source_index, double* matrix_source) {
 		double* vec_source = source_vector.data() + source_index;
 		for (int i = 0; i < block_height; i++) {
-			target->at(write_index + i) = dotProd<block_width>(matrix_source + i * block_width, vec_source);
+			target[i] = dotProd<block_width>(matrix_source + i * block_width, vec_source);
 		}
 	}
 
 	template<int block_width>
-	static void multMatWithVecDegreedHelper(int block_height, std::vector<double>* target, int write_index, std::vector<double>& source_vector, int source_index, double* matrix_source) {
+	static void multMatWithVecDegreedHelper(int block_height, double* target, std::vector<double>& source_vector, int source_index, double* matrix_source) {
 		switch (block_height) {
-		case 1: multMatWithVecDegreed<block_width, 1>(target, write_index, source_vector, source_index, matrix_source); break;
-		case 2: multMatWithVecDegreed<block_width, 2>(target, write_index, source_vector, source_index, matrix_source); break;
-		case 3: multMatWithVecDegreed<block_width, 3>(target, write_index, source_vector, source_index, matrix_source); break;
-		case 4: multMatWithVecDegreed<block_width, 4>(target, write_index, source_vector, source_index, matrix_source); break;
-		case 5: multMatWithVecDegreed<block_width, 5>(target, write_index, source_vector, source_index, matrix_source); break;
-		case 6: multMatWithVecDegreed<block_width, 6>(target, write_index, source_vector, source_index, matrix_source); break;
+		case 1: multMatWithVecDegreed<block_width, 1>(target, source_vector, source_index, matrix_source); break;
+		case 2: multMatWithVecDegreed<block_width, 2>(target, source_vector, source_index, matrix_source); break;
+		case 3: multMatWithVecDegreed<block_width, 3>(target, source_vector, source_index, matrix_source); break;
+		case 4: multMatWithVecDegreed<block_width, 4>(target, source_vector, source_index, matrix_source); break;
+		case 5: multMatWithVecDegreed<block_width, 5>(target, source_vector, source_index, matrix_source); break;
+		case 6: multMatWithVecDegreed<block_width, 6>(target, source_vector, source_index, matrix_source); break;
 		}
 	}
 
-	static void multMatWithVec(int block_width, int block_height, std::vector<double>* target, int write_index, std::vector<double>& source_vector, int source_index, double* matrix_source) {
+	static void multMatWithVec(int block_width, int block_height, double* target, std::vector<double>& source_vector, int source_index, double* matrix_source) {
 		switch (block_width) {
-		case 1: multMatWithVecDegreedHelper<1>(block_height, target, write_index, source_vector, source_index, matrix_source); break;
-		case 2: multMatWithVecDegreedHelper<2>(block_height, target, write_index, source_vector, source_index, matrix_source); break;
-		case 3: multMatWithVecDegreedHelper<3>(block_height, target, write_index, source_vector, source_index, matrix_source); break;
-		case 4: multMatWithVecDegreedHelper<4>(block_height, target, write_index, source_vector, source_index, matrix_source); break;
-		case 5: multMatWithVecDegreedHelper<5>(block_height, target, write_index, source_vector, source_index, matrix_source); break;
-		case 6: multMatWithVecDegreedHelper<6>(block_height, target, write_index, source_vector, source_index, matrix_source); break;
+		case 1: multMatWithVecDegreedHelper<1>(block_height, target, source_vector, source_index, matrix_source); break;
+		case 2: multMatWithVecDegreedHelper<2>(block_height, target, source_vector, source_index, matrix_source); break;
+		case 3: multMatWithVecDegreedHelper<3>(block_height, target, source_vector, source_index, matrix_source); break;
+		case 4: multMatWithVecDegreedHelper<4>(block_height, target, source_vector, source_index, matrix_source); break;
+		case 5: multMatWithVecDegreedHelper<5>(block_height, target, source_vector, source_index, matrix_source); break;
+		case 6: multMatWithVecDegreedHelper<6>(block_height, target, source_vector, source_index, matrix_source); break;
 		}
 	}
 
 	template<int block_width, int block_height>
-	static void multMatTransposedWithVecDegreed(std::vector<double>* target, int write_index, std::vector<double>& source_vector, int source_index, double* matrix_source) {
+	static void multMatTransposedWithVecDegreed(double* target, std::vector<double>& source_vector, int source_index, double* matrix_source) {
 		double* vec_source = source_vector.data() + source_index;
 		for (int i = 0; i < block_width; i++) {
 			double dotprod = 0;
@@ -607,30 +763,30 @@ namespace phyz {
 				double d2 = matrix_source[i + block_width * j];
 				dotprod += d1 * d2;
 			}
-			target->at(write_index + i) += dotprod;
+			target[i] += dotprod;
 		}
 	}
 
 	template<int block_width>
-	static void multMatTransposedWithVecDegreedHelper(int block_height, std::vector<double>* target, int write_index, std::vector<double>& source_vector, int source_index, double* matrix_source) {
+	static void multMatTransposedWithVecDegreedHelper(int block_height, double* target, std::vector<double>& source_vector, int source_index, double* matrix_source) {
 		switch (block_height) {
-		case 1: multMatTransposedWithVecDegreed<block_width, 1>(target, write_index, source_vector, source_index, matrix_source); break;
-		case 2: multMatTransposedWithVecDegreed<block_width, 2>(target, write_index, source_vector, source_index, matrix_source); break;
-		case 3: multMatTransposedWithVecDegreed<block_width, 3>(target, write_index, source_vector, source_index, matrix_source); break;
-		case 4: multMatTransposedWithVecDegreed<block_width, 4>(target, write_index, source_vector, source_index, matrix_source); break;
-		case 5: multMatTransposedWithVecDegreed<block_width, 5>(target, write_index, source_vector, source_index, matrix_source); break;
-		case 6: multMatTransposedWithVecDegreed<block_width, 6>(target, write_index, source_vector, source_index, matrix_source); break;
+		case 1: multMatTransposedWithVecDegreed<block_width, 1>(target, source_vector, source_index, matrix_source); break;
+		case 2: multMatTransposedWithVecDegreed<block_width, 2>(target, source_vector, source_index, matrix_source); break;
+		case 3: multMatTransposedWithVecDegreed<block_width, 3>(target, source_vector, source_index, matrix_source); break;
+		case 4: multMatTransposedWithVecDegreed<block_width, 4>(target, source_vector, source_index, matrix_source); break;
+		case 5: multMatTransposedWithVecDegreed<block_width, 5>(target, source_vector, source_index, matrix_source); break;
+		case 6: multMatTransposedWithVecDegreed<block_width, 6>(target, source_vector, source_index, matrix_source); break;
 		}
 	}
 
-	static void multMatTransposedWithVec(int block_width, int block_height, std::vector<double>* target, int write_index, std::vector<double>& source_vector, int source_index, double* matrix_source) {
+	static void multMatTransposedWithVec(int block_width, int block_height, double* target, std::vector<double>& source_vector, int source_index, double* matrix_source) {
 		switch (block_width) {
-		case 1: multMatTransposedWithVecDegreedHelper<1>(block_height, target, write_index, source_vector, source_index, matrix_source); break;
-		case 2: multMatTransposedWithVecDegreedHelper<2>(block_height, target, write_index, source_vector, source_index, matrix_source); break;
-		case 3: multMatTransposedWithVecDegreedHelper<3>(block_height, target, write_index, source_vector, source_index, matrix_source); break;
-		case 4: multMatTransposedWithVecDegreedHelper<4>(block_height, target, write_index, source_vector, source_index, matrix_source); break;
-		case 5: multMatTransposedWithVecDegreedHelper<5>(block_height, target, write_index, source_vector, source_index, matrix_source); break;
-		case 6: multMatTransposedWithVecDegreedHelper<6>(block_height, target, write_index, source_vector, source_index, matrix_source); break;
+		case 1: multMatTransposedWithVecDegreedHelper<1>(block_height, target, source_vector, source_index, matrix_source); break;
+		case 2: multMatTransposedWithVecDegreedHelper<2>(block_height, target, source_vector, source_index, matrix_source); break;
+		case 3: multMatTransposedWithVecDegreedHelper<3>(block_height, target, source_vector, source_index, matrix_source); break;
+		case 4: multMatTransposedWithVecDegreedHelper<4>(block_height, target, source_vector, source_index, matrix_source); break;
+		case 5: multMatTransposedWithVecDegreedHelper<5>(block_height, target, source_vector, source_index, matrix_source); break;
+		case 6: multMatTransposedWithVecDegreedHelper<6>(block_height, target, source_vector, source_index, matrix_source); break;
 		}
 	}
 
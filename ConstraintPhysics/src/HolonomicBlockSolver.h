@@ -4,16 +4,21 @@
 
 namespace phyz {
 	class Constraint;
+	class ThreadManager;
 
 	class HolonomicSystem {
 	public:
-		HolonomicSystem() : buffer(nullptr), diagonal_elem_buffer(nullptr) {}
+		HolonomicSystem() : buffer(nullptr), diagonal_elem_buffer(nullptr), steps_since_factorization(-1) {}
 		HolonomicSystem(std::vector<Constraint*> constraints);
 		HolonomicSystem(HolonomicSystem&& h);
 		~HolonomicSystem();
 		void operator=(HolonomicSystem&& h);
-		void computeInverse(double cfm);
-		void computeAndApplyImpulses(bool use_psuedo_velocities);
+		//numeric factorization into the buffers laid out when the system was built. With a refactor_interval above 1 the last factorization
+		//is reused for up to that many steps, unless it stops reducing the constraint error
+		//with a thread_manager, independent subtrees of the elimination tree are factorized and solved on different threads. Results are the same
+		//as without. Must be called from the main thread, since this waits on the workers
+		void computeInverse(double cfm, int refactor_interval = 1, ThreadManager* thread_manager = nullptr, int n_threads = 1);
+		void computeAndApplyImpulses(bool use_psuedo_velocities, ThreadManager* thread_manager = nullptr, int n_threads = 1);
 		inline int getDegree() { return system_degree; }
 		inline int getNumConstraints() { return constraints.size(); }
 
@@ -26,15 +31,34 @@ namespace phyz {
 		int system_degree;
 		
 		int buffer_capacity;
-		double* diagonal_elem_buffer;
+		double* diagonal_elem_buffer; //below diagonal blocks before scaling by the inverse diagonal, same layout as buffer. Read by later columns
 		int diagonal_elem_buffer_capacity;
+		int steps_since_factorization; //-1 until the first factorization
+		double factorization_cfm;
+		double last_error[2] = { -1, -1 }; //largest constraint error seen by the last solve this step, velocities and psuedo velocities. -1 at the start of a step
+		void factorize(double cfm, ThreadManager* thread_manager, int n_threads);
+		void factorizeColumn(int col, double cfm);
 
-		std::vector<int> block_location_table;
+		//symbolic factorization. Below the diagonal, block column j of L can only be non zero in the block rows
+		//block_rows[column_begin[j]] to block_rows[column_begin[j + 1] - 1], in increasing order, stored at the matching block_locations
+		std::vector<int> column_begin;
+		std::vector<int> block_rows;
+		std::vector<int> block_locations;
+		std::vector<int> diagonal_locations;
+		std::vector<int> elimination_parent; //parent of each block column in the elimination tree, -1 for roots
+		//the blocks in each block row of L, by increasing column. block_locations index and column of each
+		std::vector<int> row_entry_begin;
+		std::vector<int> row_entry_blocks;
+		std::vector<int> row_entry_columns;
+		//a column only depends on the columns below it in the elimination tree. Each level is a list of tasks that can run at the same time,
+		//each task a list of columns in increasing order. Level 0 holds small subtrees, the levels above it the columns joining them
+		std::vector<std::vector<std::vector<int>>> schedule_levels;
+		const static int PARALLEL_SUBTREE_TASKS = 32;
 		std::vector<int> vector_location_lookup;
 		const static int BLOCK_EMPTY = -1;
-		int getFirstNonEmptyBlockBelowDiagonal(int column);
+		constexpr static double STALE_FACTORIZATION_ERROR_RATIO = 1.0;
+		void computeSymbolicFactorization(const std::vector<std::vector<int>>& coupling_graph);
 		int getBlockBufferLocation(int block_row, int block_column);
-		int getBlockDiagonalElemBufferLocation(int block_row, int block_column);
 		int getVectorPos(int constraint_row);
 
 #ifndef NDEBUG
@@ -18,6 +18,14 @@ namespace phyz {
 	bool PhysicsEngine::use_multithread = false;
 	bool PhysicsEngine::print_performance_data = false;
 
+	//manifolds found in the local coordinates of a body are brought back to world coordinates
+	static void transformManifold(Manifold* m, const mthz::Mat3& rot, mthz::Vec3 trans) {
+		m->normal = rot * m->normal;
+		for (ContactP& p : m->points) {
+			p.pos = rot * p.pos + trans;
+		}
+	}
+
 	void PhysicsEngine::enableMultithreading(int n_threads) {
 		assert(n_threads >= 1);
 		PhysicsEngine::n_threads = n_threads;
@@ -35,6 +43,12 @@ namespace phyz {
 	}
 
 	PhysicsEngine::~PhysicsEngine() {
+		for (Articulation* a : articulations) {
+			delete a;
+		}
+		for (Cable* c : cables) {
+			delete c;
+		}
 		for (RigidBody* b : bodies) {
 			delete constraint_graph_nodes[b->getID()];
 			delete b;
@@ -87,10 +101,15 @@ namespace phyz {
 					}
 				}
 
-				b->vel += gravity * step_time;
+				//articulations apply their own gravity
+				if (b->articulation == nullptr) b->vel += gravity * step_time;
 			}
 		}
 
+		for (Articulation* a : articulations) {
+			a->stepVelocities(gravity, step_time);
+		}
+
 		maintainConstraintGraphApplyPoweredConstraints();
 
 		auto t2 = std::chrono::system_clock::now();
@@ -196,7 +215,21 @@ namespace phyz {
 								continue;
 							}
 
-							Manifold man = detectCollision(c1, c2);
+							Manifold man;
+							if (b1->local_space_geometry || b2->local_space_geometry) {
+								//c2 is brought into c1's coordinates, world space geometry is treated as having the identity transform
+								mthz::Quaternion b1_orientation = b1->local_space_geometry ? b1->orientation : mthz::Quaternion();
+								mthz::Quaternion b2_orientation = b2->local_space_geometry ? b2->orientation : mthz::Quaternion();
+								mthz::Vec3 b1_trans = b1->local_space_geometry ? b1->com : mthz::Vec3(0, 0, 0);
+								mthz::Vec3 b2_trans = b2->local_space_geometry ? b2->com : mthz::Vec3(0, 0, 0);
+								mthz::Mat3 b1_rot_conjugate = b1_orientation.conjugate().getRotMatrix();
+
+								man = detectCollision(c1, c2, (b1_orientation.conjugate() * b2_orientation).getRotMatrix(), b1_rot_conjugate * (b2_trans - b1_trans));
+								transformManifold(&man, b1_orientation.getRotMatrix(), b1_trans);
+							}
+							else {
+								man = detectCollision(c1, c2);
+							}
 
 							//no collision signified by pen_depth <= 0
 							if (man.max_pen_depth > 0) {
@@ -210,11 +243,23 @@ namespace phyz {
 						bool use_local_transformation_on_mesh = b2->getMovementType() == RigidBody::KINEMATIC;
 
 						std::vector<Manifold> detected_manifolds;
-						if (use_local_transformation_on_mesh) {
-							detected_manifolds = detectCollision(b1->geometry[i], b1->geometry_AABB[i], b2->reference_mesh, b2->getCOM(), b2->getOrientation());
+						if (b1->local_space_geometry) {
+							//mesh is brought into b1's local coordinates instead
+							mthz::Quaternion b1_orientation_conjugate = b1->orientation.conjugate();
+							mthz::Vec3 mesh_pos = use_local_transformation_on_mesh ? b2->getCOM() : mthz::Vec3(0, 0, 0);
+							mthz::Quaternion mesh_orientation = use_local_transformation_on_mesh ? b2->getOrientation() : mthz::Quaternion();
+							const StaticMeshGeometry& mesh = use_local_transformation_on_mesh ? b2->shape->getMesh() : b2->getWorldMesh();
+
+							detected_manifolds = detectCollision(b1->geometry[i], b1->shape->getPolyhedraAABBs()[i], mesh, b1_orientation_conjugate.getRotMatrix() * (mesh_pos - b1->com), b1_orientation_conjugate * mesh_orientation);
+							for (Manifold& m : detected_manifolds) {
+								transformManifold(&m, b1->orientation.getRotMatrix(), b1->com);
+							}
+						}
+						else if (use_local_transformation_on_mesh) {
+							detected_manifolds = detectCollision(b1->geometry[i], b1->geometry_AABB[i], b2->shape->getMesh(), b2->getCOM(), b2->getOrientation());
 						}
 						else {
-							detected_manifolds = detectCollision(b1->geometry[i], b1->geometry_AABB[i], b2->mesh, mthz::Vec3(), mthz::Quaternion());
+							detected_manifolds = detectCollision(b1->geometry[i], b1->geometry_AABB[i], b2->getWorldMesh(), mthz::Vec3(), mthz::Quaternion());
 						}
 
 						for (const Manifold& m : detected_manifolds) {
@@ -229,11 +274,22 @@ namespace phyz {
 						bool use_local_transformation_on_mesh = b1->getMovementType() == RigidBody::KINEMATIC;
 
 						std::vector<Manifold> detected_manifolds;
-						if (use_local_transformation_on_mesh) {
-							detected_manifolds = detectCollision(b1->reference_mesh, b1->getCOM(), b1->getOrientation(), b2->geometry[i], b2->geometry_AABB[i]);
+						if (b2->local_space_geometry) {
+							mthz::Quaternion b2_orientation_conjugate = b2->orientation.conjugate();
+							mthz::Vec3 mesh_pos = use_local_transformation_on_mesh ? b1->getCOM() : mthz::Vec3(0, 0, 0);
+							mthz::Quaternion mesh_orientation = use_local_transformation_on_mesh ? b1->getOrientation() : mthz::Quaternion();
+							const StaticMeshGeometry& mesh = use_local_transformation_on_mesh ? b1->shape->getMesh() : b1->getWorldMesh();
+
+							detected_manifolds = detectCollision(mesh, b2_orientation_conjugate.getRotMatrix() * (mesh_pos - b2->com), b2_orientation_conjugate * mesh_orientation, b2->geometry[i], b2->shape->getPolyhedraAABBs()[i]);
+							for (Manifold& m : detected_manifolds) {
+								transformManifold(&m, b2->orientation.getRotMatrix(), b2->com);
+							}
+						}
+						else if (use_local_transformation_on_mesh) {
+							detected_manifolds = detectCollision(b1->shape->getMesh(), b1->getCOM(), b1->getOrientation(), b2->geometry[i], b2->geometry_AABB[i]);
 						}
 						else {
-							detected_manifolds = detectCollision(b1->mesh, mthz::Vec3(), mthz::Quaternion(), b2->geometry[i], b2->geometry_AABB[i]);
+							detected_manifolds = detectCollision(b1->getWorldMesh(), mthz::Vec3(), mthz::Quaternion(), b2->geometry[i], b2->geometry_AABB[i]);
 						}
 						for (const Manifold& m : detected_manifolds) {
 							manifolds.push_back(m);
@@ -341,18 +397,58 @@ namespace phyz {
 			}
 		}
 
+		//collision actions may have changed the velocity of articulated bodies
+		for (Articulation* a : articulations) {
+			a->absorbBodyVelocityChanges();
+		}
+
 		ActiveConstraintData active_data = sleepOrSolveIslands();
 
 		auto t5 = std::chrono::system_clock::now();
 
-		if (use_multithread && compute_holonomic_inverse_in_parallel && using_holonomic_system_solver()) {
+		if (graph_colored_solver) {
+			SolverThreads colored_solve = { use_multithread ? &thread_manager : nullptr, n_threads };
+
+			std::vector<IslandConstraints> remaining_islands;
+			for (IslandConstraints& island_system : active_data.island_systems) {
+				if (island_system.constraints.size() >= graph_colored_min_constraints) {
+					*island_system.stats = PGS_solve(this, island_system.constraints, island_system.systems, island_system.cables, island_system.solver_bodies, island_system.solver_rows, holonomic_block_solver_CFM, holonomic_refactor_interval, island_system.n_itr_vel, island_system.n_itr_pos, pgsHolonomicIterations, pgs_substeps, pgs_residual_tolerance, nullptr, &colored_solve, parallel_holonomic_solver ? &colored_solve : nullptr);
+				}
+				else {
+					remaining_islands.push_back(std::move(island_system));
+				}
+			}
+			active_data.island_systems = std::move(remaining_islands);
+		}
+
+		if (parallel_holonomic_solver && use_multithread) {
+			SolverThreads holonomic_threads = { &thread_manager, n_threads };
+
+			std::vector<IslandConstraints> remaining_islands;
+			for (IslandConstraints& island_system : active_data.island_systems) {
+				bool has_large_system = false;
+				for (HolonomicSystem* h : island_system.systems) {
+					has_large_system |= h->getNumConstraints() >= parallel_holonomic_min_constraints;
+				}
+
+				if (has_large_system) {
+					*island_system.stats = PGS_solve(this, island_system.constraints, island_system.systems, island_system.cables, island_system.solver_bodies, island_system.solver_rows, holonomic_block_solver_CFM, holonomic_refactor_interval, island_system.n_itr_vel, island_system.n_itr_pos, pgsHolonomicIterations, pgs_substeps, pgs_residual_tolerance, nullptr, nullptr, &holonomic_threads);
+				}
+				else {
+					remaining_islands.push_back(std::move(island_system));
+				}
+			}
+			active_data.island_systems = std::move(remaining_islands);
+		}
+
+		if (use_multithread && compute_holonomic_inverse_in_parallel && using_holonomic_system_solver() && pgs_substeps == 1) {
 			std::vector<ThreadManager::JobStatus> compute_holonomic_inverses_status(active_data.island_systems.size());
 
 			int islands_with_holonomic_systems_count = 0;
 
 			thread_manager.enqueue_do_all_tasks<IslandConstraints>(n_threads, &active_data.island_systems,
 				[&](IslandConstraints island_system, int index) {
-					PGS_solve(this, island_system.constraints, island_system.systems, holonomic_block_solver_CFM, pgsVelIterations, pgsPosIterations, pgsHolonomicIterations, &compute_holonomic_inverses_status[index]);
+					*island_system.stats = PGS_solve(this, island_system.constraints, island_system.systems, island_system.cables, island_system.solver_bodies, island_system.solver_rows, holonomic_block_solver_CFM, holonomic_refactor_interval, island_system.n_itr_vel, island_system.n_itr_pos, pgsHolonomicIterations, pgs_substeps, pgs_residual_tolerance, &compute_holonomic_inverses_status[index]);
 				}
 			);
 			for (int i = 0; i < active_data.island_systems.size(); i++) {
@@ -364,7 +460,7 @@ namespace phyz {
 				int size = island_system.systems.size();
 				thread_manager.enqueue_do_all_tasks<HolonomicSystem*>(n_threads, &island_system.systems,
 					[&, size, i](HolonomicSystem* h, int index) {
-						h->computeInverse(holonomic_block_solver_CFM);
+						h->computeInverse(holonomic_block_solver_CFM, holonomic_refactor_interval);
 						auto donet = std::chrono::system_clock::now();
 						//printf("Compute inverse done. Took %f milliseconds\n", 1000 * std::chrono::duration<float>(donet - t5).count());
 					}, &compute_holonomic_inverses_status[i]
@@ -376,20 +472,24 @@ namespace phyz {
 		else if (use_multithread) {
 			thread_manager.do_all<IslandConstraints>(n_threads, active_data.island_systems,
 				[&](IslandConstraints island_system) {
-					PGS_solve(this, island_system.constraints, island_system.systems, holonomic_block_solver_CFM, pgsVelIterations, pgsPosIterations, pgsHolonomicIterations);
+					*island_system.stats = PGS_solve(this, island_system.constraints, island_system.systems, island_system.cables, island_system.solver_bodies, island_system.solver_rows, holonomic_block_solver_CFM, holonomic_refactor_interval, island_system.n_itr_vel, island_system.n_itr_pos, pgsHolonomicIterations, pgs_substeps, pgs_residual_tolerance);
 				}
 			);
 		}
 		else {
 			for (IslandConstraints& island_system : active_data.island_systems) {
-				PGS_solve(this, island_system.constraints, island_system.systems, holonomic_block_solver_CFM, pgsVelIterations,  pgsPosIterations, pgsHolonomicIterations);
+				*island_system.stats = PGS_solve(this, island_system.constraints, island_system.systems, island_system.cables, island_system.solver_bodies, island_system.solver_rows, holonomic_block_solver_CFM, holonomic_refactor_interval, island_system.n_itr_vel, island_system.n_itr_pos, pgsHolonomicIterations, pgs_substeps, pgs_residual_tolerance);
 			}
 		}
 
+		for (int i = 0; i < island_solve_stats.size(); i++) {
+			recordSolveStats(island_solver_bodies[i], island_solve_stats[i]);
+		}
+
 		auto t6 = std::chrono::system_clock::now();
 
 		auto update_positions = [&](RigidBody* b) {
-			if ((b->getMovementType() != RigidBody::FIXED) && !b->getAsleep()) {
+			if ((b->getMovementType() != RigidBody::FIXED) && !b->getAsleep() && b->getArticulation() == nullptr) {
 				b->prev_com = b->getCOM();
 				b->prev_orientation = b->getOrientation();
 
@@ -417,6 +517,11 @@ namespace phyz {
 			}
 		}
 
+		//after the bodies, so links follow a kinematic root to where it moved
+		for (Articulation* a : articulations) {
+			a->integratePositions(step_time);
+		}
+
 		applyMasterSlavePosCorrect(active_data);
 
 		auto update_geometry = [&](RigidBody* b) {
@@ -585,26 +690,29 @@ namespace phyz {
 		}
 	}
 
-	RigidBody* PhysicsEngine::createRigidBody(const ConvexUnionGeometry& geometry, RigidBody::MovementType movement_type, mthz::Vec3 position, mthz::Quaternion orientation, bool override_center_of_mass, mthz::Vec3 center_of_mass_override) {
-		RigidBody* r = new RigidBody(geometry, position, orientation, next_id++, override_center_of_mass, center_of_mass_override);
-		r->setMovementType(movement_type);
-		bodies.push_back(r);
-		constraint_graph_nodes[r->getID()] = new ConstraintGraphNode(r);
+	std::shared_ptr<const RigidBodyShape> PhysicsEngine::createShape(const ConvexUnionGeometry& geometry, bool override_center_of_mass, mthz::Vec3 center_of_mass_override) {
+		return std::make_shared<const RigidBodyShape>(geometry, override_center_of_mass, center_of_mass_override);
+	}
 
-		if (broadphase == AABB_TREE || broadphase == TEST_COMPARE) {
-			aabb_tree.add(r, r->getMovementType() == RigidBody::DYNAMIC, r->getID(), r->aabb);
-		}
-		return r;
+	std::shared_ptr<const RigidBodyShape> PhysicsEngine::createShape(const StaticMeshGeometry& geometry) {
+		return std::make_shared<const RigidBodyShape>(geometry);
+	}
+
+	RigidBody* PhysicsEngine::createRigidBody(const ConvexUnionGeometry& geometry, RigidBody::MovementType movement_type, mthz::Vec3 position, mthz::Quaternion orientation, bool override_center_of_mass, mthz::Vec3 center_of_mass_override) {
+		return createRigidBody(createShape(geometry, override_center_of_mass, center_of_mass_override), movement_type, position, orientation);
 	}
 
 	RigidBody* PhysicsEngine::createRigidBody(const StaticMeshGeometry& geometry, bool fixed) {
-		RigidBody* r = new RigidBody(geometry, next_id++);
-		if (fixed) {
-			r->setMovementType(RigidBody::FIXED);
-		}
-		else {
-			r->setMovementType(RigidBody::KINEMATIC);
-		}
+		return createRigidBody(createShape(geometry), fixed? RigidBody::FIXED : RigidBody::KINEMATIC);
+	}
+
+	RigidBody* PhysicsEngine::createRigidBody(std::shared_ptr<const RigidBodyShape> shape, RigidBody::MovementType movement_type, mthz::Vec3 position, mthz::Quaternion orientation) {
+		assert(!shape->isStaticMesh() || movement_type != RigidBody::DYNAMIC);
+
+		RigidBody* r = new RigidBody(shape, position, orientation, next_id++);
+		r->setMovementType(movement_type);
+		r->setLocalSpaceGeometry(local_space_narrowphase);
+		r->setTightAABBs(tight_AABBs);
 		bodies.push_back(r);
 		constraint_graph_nodes[r->getID()] = new ConstraintGraphNode(r);
 
@@ -620,6 +728,13 @@ namespace phyz {
 	}
 
 	void PhysicsEngine::deleteRigidBody(RigidBody* r) {
+		if (r->articulation != nullptr) {
+			removeArticulation(r->articulation);
+		}
+		for (int i = 0; i < cables.size();) {
+			if (cables[i]->involves(r)) removeCable(cables[i]);
+			else						i++;
+		}
 		if (broadphase == AABB_TREE || broadphase == TEST_COMPARE) {
 			aabb_tree.remove(r->getID());
 		}
@@ -628,6 +743,11 @@ namespace phyz {
 		bodies.erase(std::remove(bodies.begin(), bodies.end(), r));
 		ConstraintGraphNode* n = constraint_graph_nodes[r->getID()];
 		constraint_graph_nodes.erase(r->getID());
+		for (auto it = distance_query_caches.begin(); it != distance_query_caches.end();) {
+			uint64_t id = r->getID();
+			if ((it->first >> 32) == id || (it->first & 0x00000000FFFFFFFF) == id) it = distance_query_caches.erase(it);
+			else it++;
+		}
 		delete n;
 		delete r;
 	}
@@ -670,6 +790,8 @@ namespace phyz {
 	}
 
 	bool PhysicsEngine::collisionAllowed(RigidBody* b1, RigidBody* b2) {
+		//links of an articulation don't collide with each other
+		if (b1->articulation != nullptr && b1->articulation == b2->articulation) return false;
 		return !b1->no_collision && !b2->no_collision && b1->no_collision_set.find(b2) == b1->no_collision_set.end();
 	}
 
@@ -710,6 +832,151 @@ namespace phyz {
 		return closest_hit_info;
 	}
 
+	static ClosestPointsInfo flipClosestPoints(const ClosestPointsInfo& c) {
+		return ClosestPointsInfo{ c.valid, c.distance, c.b2_point, c.b1_point, -c.normal };
+	}
+
+	ClosestPointsInfo PhysicsEngine::closestPoints(RigidBody* b1, RigidBody* b2) {
+		assert(b1 != b2);
+		OrderedBodyPair p(b1, b2);
+		ClosestPointsInfo out = computeClosestPoints(p.t1, p.t2, getDistanceQueryCache(p.t1, p.t2));
+		return (p.t1 == b1) ? out : flipClosestPoints(out);
+	}
+
+	std::vector<ClosestPointsInfo> PhysicsEngine::closestPoints(const std::vector<std::pair<RigidBody*, RigidBody*>>& body_pairs) {
+		std::vector<ClosestPointsInfo> out(body_pairs.size());
+		if (!use_multithread) {
+			for (int i = 0; i < body_pairs.size(); i++) {
+				out[i] = closestPoints(body_pairs[i].first, body_pairs[i].second);
+			}
+			return out;
+		}
+
+		//caches are all looked up before the parallel section so worker threads never modify distance_query_caches.
+		//A pair repeated in the batch would have two threads sharing a cache, so repeats are done afterwards.
+		struct DistanceQuery {
+			RigidBody* b1;
+			RigidBody* b2;
+			DistanceQueryCache* cache;
+			int index;
+		};
+		std::vector<DistanceQuery> queries;
+		std::vector<int> repeated_queries;
+		std::set<DistanceQueryCache*> claimed_caches;
+		queries.reserve(body_pairs.size());
+		for (int i = 0; i < body_pairs.size(); i++) {
+			assert(body_pairs[i].first != body_pairs[i].second);
+			OrderedBodyPair p(body_pairs[i].first, body_pairs[i].second);
+			DistanceQueryCache* cache = getDistanceQueryCache(p.t1, p.t2);
+			if (claimed_caches.insert(cache).second) {
+				queries.push_back(DistanceQuery{ p.t1, p.t2, cache, i });
+			}
+			else {
+				repeated_queries.push_back(i);
+			}
+		}
+
+		thread_manager.do_all(n_threads, queries, [&](const DistanceQuery& q) {
+			ClosestPointsInfo c = computeClosestPoints(q.b1, q.b2, q.cache);
+			out[q.index] = (q.b1 == body_pairs[q.index].first) ? c : flipClosestPoints(c);
+		});
+
+		for (int i : repeated_queries) {
+			out[i] = closestPoints(body_pairs[i].first, body_pairs[i].second);
+		}
+		return out;
+	}
+
+	PhysicsEngine::DistanceQueryCache* PhysicsEngine::getDistanceQueryCache(RigidBody* b1, RigidBody* b2) {
+		assert(b1->getID() < b2->getID());
+		uint64_t key = (uint64_t(b1->getID()) << 32) | uint64_t(b2->getID());
+		return &distance_query_caches[key];
+	}
+
+	ClosestPointsInfo PhysicsEngine::computeClosestPoints(RigidBody* b1, RigidBody* b2, DistanceQueryCache* cache) const {
+		ClosestPointsInfo out = { false, std::numeric_limits<double>::infinity() };
+		if (b1->getGeometryType() == RigidBody::STATIC_MESH && b2->getGeometryType() == RigidBody::STATIC_MESH) return out;
+
+		//primitives are visited nearest AABB first, so the search can end once no remaining AABB could hold anything closer.
+		//Overlapping shapes keep being checked to find the deepest penetration.
+		struct PrimitiveCandidate {
+			int i;
+			int j;
+			double lower_bound;
+		};
+		std::vector<PrimitiveCandidate> candidates;
+		auto nearest_first = [](const PrimitiveCandidate& c1, const PrimitiveCandidate& c2) { return c1.lower_bound < c2.lower_bound; };
+
+		if (b1->getGeometryType() == RigidBody::CONVEX_UNION && b2->getGeometryType() == RigidBody::CONVEX_UNION) {
+			int n1 = b1->geometry.size();
+			int n2 = b2->geometry.size();
+			if (cache->primitive_caches.size() != n1 * n2) {
+				cache->primitive_caches = std::vector<SimplexCache>(n1 * n2);
+			}
+
+			candidates.reserve(n1 * n2);
+			for (int i = 0; i < n1; i++) {
+				for (int j = 0; j < n2; j++) {
+					candidates.push_back(PrimitiveCandidate{ i, j, AABB::distanceBetween(b1->geometry_AABB[i], b2->geometry_AABB[j]) });
+				}
+			}
+			std::sort(candidates.begin(), candidates.end(), nearest_first);
+
+			for (const PrimitiveCandidate& c : candidates) {
+				if (c.lower_bound > std::max<double>(out.distance, 0)) break;
+
+				std::unique_ptr<ConvexPrimitive> c1_world_copy, c2_world_copy;
+				const ConvexPrimitive& c1 = b1->getWorldSpacePrimitive(c.i, &c1_world_copy);
+				const ConvexPrimitive& c2 = b2->getWorldSpacePrimitive(c.j, &c2_world_copy);
+
+				DistanceInfo d = computeDistance(c1, c2, &cache->primitive_caches[c.i * n2 + c.j]);
+				if (d.found && d.distance < out.distance) {
+					out = ClosestPointsInfo{ true, d.distance, d.a_point, d.b_point, d.normal };
+				}
+			}
+		}
+		else {
+			bool b1_is_mesh = b1->getGeometryType() == RigidBody::STATIC_MESH;
+			RigidBody* convex_body = b1_is_mesh ? b2 : b1;
+			RigidBody* mesh_body = b1_is_mesh ? b1 : b2;
+
+			//same as narrowphase, the BVH of kinematic meshes stays in local coordinates
+			bool use_local_transformation_on_mesh = mesh_body->getMovementType() == RigidBody::KINEMATIC;
+			const StaticMeshGeometry& mesh = use_local_transformation_on_mesh ? mesh_body->shape->getMesh() : mesh_body->getWorldMesh();
+			mthz::Vec3 mesh_position = use_local_transformation_on_mesh ? mesh_body->getCOM() : mthz::Vec3();
+			mthz::Quaternion mesh_orientation = use_local_transformation_on_mesh ? mesh_body->getOrientation() : mthz::Quaternion();
+
+			int n = convex_body->geometry.size();
+			if (cache->mesh_caches.size() != n) {
+				cache->mesh_caches = std::vector<MeshDistanceCache>(n);
+			}
+
+			candidates.reserve(n);
+			for (int i = 0; i < n; i++) {
+				candidates.push_back(PrimitiveCandidate{ i, -1, AABB::distanceBetween(convex_body->geometry_AABB[i], mesh_body->aabb) });
+			}
+			std::sort(candidates.begin(), candidates.end(), nearest_first);
+
+			for (const PrimitiveCandidate& c : candidates) {
+				if (c.lower_bound > std::max<double>(out.distance, 0)) break;
+
+				std::unique_ptr<ConvexPrimitive> world_copy;
+				const ConvexPrimitive& convex = convex_body->getWorldSpacePrimitive(c.i, &world_copy);
+
+				DistanceInfo d = computeDistance(convex, convex_body->geometry_AABB[c.i], mesh, mesh_position, mesh_orientation, &cache->mesh_caches[c.i]);
+				if (d.found && d.distance < out.distance) {
+					out = ClosestPointsInfo{ true, d.distance, d.a_point, d.b_point, d.normal };
+				}
+			}
+
+			if (b1_is_mesh) {
+				out = flipClosestPoints(out);
+			}
+		}
+
+		return out;
+	}
+
 	std::vector<RigidBody*> PhysicsEngine::getBodies() {
 		std::vector<RigidBody*> out;
 		for (RigidBody* b : bodies) {
@@ -738,7 +1005,7 @@ namespace phyz {
 
 		Distance* d = new Distance{
 			b1, b2,
-			DistanceConstraint(),
+			DistanceConstraint(b1, b2),
 			target_distance,
 			b1_key,
 			b2_key,
@@ -772,7 +1039,7 @@ namespace phyz {
 		disallowCollision(b1, b2);
 		BallSocket* bs = new BallSocket{
 			b1, b2,
-			BallSocketConstraint(),
+			BallSocketConstraint(b1, b2),
 			b1->trackPoint(b1_attach_pos_local),
 			b2->trackPoint(b2_attach_pos_local),
 			CFM{USE_GLOBAL},
@@ -807,7 +1074,7 @@ namespace phyz {
 
 		Hinge* h = new Hinge{
 			b1, b2,
-			HingeConstraint(),
+			HingeConstraint(b1, b2),
 			Motor(b1, b2, b1_rot_axis_local, b2_rot_axis_local, min_angle, max_angle),
 			b1->trackPoint(b1_attach_pos_local),
 			b2->trackPoint(b2_attach_pos_local),
@@ -850,7 +1117,7 @@ namespace phyz {
 
 		Slider* s = new Slider {
 			b1, b2,
-			SliderConstraint(),
+			SliderConstraint(b1, b2),
 			Piston(b1, b2, b1->getTrackedP(b1_point_key), b2->getTrackedP(b2_point_key), slide_axis, negative_slide_limit, positive_slide_limit),
 			b1_point_key,
 			b2_point_key,
@@ -892,7 +1159,7 @@ namespace phyz {
 
 		SlidingHinge* s = new SlidingHinge{
 			b1, b2,
-			SlidingHingeConstraint(),
+			SlidingHingeConstraint(b1, b2),
 			Piston(b1, b2, b1->getTrackedP(b1_point_key), b2->getTrackedP(b2_point_key), slide_axis, negative_slide_limit, positive_slide_limit),
 			Motor(b1, b2, b1_slider_axis_local, b2_slider_axis_local, min_angle, max_angle),
 			b1_point_key,
@@ -930,7 +1197,7 @@ namespace phyz {
 
 		Weld* w = new Weld{
 			b1, b2,
-			WeldConstraint(),
+			WeldConstraint(b1, b2),
 			b1->trackPoint(b1_attach_point_local),
 			b2->trackPoint(b2_attach_point_local),
 			CFM{USE_GLOBAL},
@@ -962,6 +1229,7 @@ namespace phyz {
 
 		Spring* s = new Spring{
 			b1, b2,
+			SpringConstraint(b1, b2),
 			b1_key,
 			b2_key,
 			stiffness,
@@ -980,6 +1248,47 @@ namespace phyz {
 
 	}
 
+	ConstraintID PhysicsEngine::addGearConstraint(RigidBody* b1, RigidBody* b2, mthz::Vec3 b1_rot_axis_local, mthz::Vec3 b2_rot_axis_local, double ratio) {
+		return addGear(b1, b2, b1_rot_axis_local, b2_rot_axis_local, false, ratio);
+	}
+
+	ConstraintID PhysicsEngine::addRackAndPinionConstraint(RigidBody* pinion, RigidBody* rack, mthz::Vec3 pinion_rot_axis_local, mthz::Vec3 rack_slide_axis_local, double pinion_radius) {
+		return addGear(pinion, rack, pinion_rot_axis_local, rack_slide_axis_local, true, pinion_radius);
+	}
+
+	ConstraintID PhysicsEngine::addBeltConstraint(RigidBody* b1, RigidBody* b2, mthz::Vec3 b1_rot_axis_local, mthz::Vec3 b2_rot_axis_local, double b1_radius, double b2_radius) {
+		assert(b2_radius > 0);
+		return addGear(b1, b2, b1_rot_axis_local, b2_rot_axis_local, false, b1_radius / b2_radius);
+	}
+
+	ConstraintID PhysicsEngine::addGear(RigidBody* b1, RigidBody* b2, mthz::Vec3 b1_rot_axis_local, mthz::Vec3 b2_axis_local, bool b2_slides, double ratio) {
+		disallowCollision(b1, b2);
+		int uniqueID = nextConstraintID++;
+
+		Gear* g = new Gear{
+			b1, b2,
+			GearConstraint(b1, b2),
+			b1_rot_axis_local.normalize(),
+			b2_axis_local.normalize(),
+			b2_slides,
+			ratio,
+			CFM{USE_GLOBAL},
+			uniqueID
+		};
+
+		ConstraintGraphNode* n1 = constraint_graph_nodes[b1->getID()];
+		ConstraintGraphNode* n2 = constraint_graph_nodes[b2->getID()];
+		SharedConstraintsEdge* e = n1->getOrCreateEdgeTo(n2);
+
+		if (e->h != nullptr) e->h->constraints_changed_flag = true;
+		else				 e->holonomic_system_scan_needed = true;
+
+		e->gears.push_back(g);
+
+		constraint_map[uniqueID] = e;
+		return ConstraintID{ ConstraintID::GEAR, uniqueID };
+	}
+
 	void PhysicsEngine::setConstraintPosCorrectMethod(ConstraintID id, PosErrorResolutionMode error_correct_method, bool b1_master) {
 		assert(constraint_map.find(id.uniqueID) != constraint_map.end());
 
@@ -1101,6 +1410,14 @@ namespace phyz {
 				}
 			}
 			break;
+		case ConstraintID::GEAR:
+			for (int i = 0; i < e->gears.size(); i++) {
+				Gear* g = e->gears[i];
+				if (g->uniqueID == id.uniqueID) {
+					g->cfm = CFM{ USE_CUSTOM, custom_cfm };
+				}
+			}
+			break;
 		}
 	}
 
@@ -1159,6 +1476,14 @@ namespace phyz {
 				}
 			}
 			break;
+		case ConstraintID::GEAR:
+			for (int i = 0; i < e->gears.size(); i++) {
+				Gear* g = e->gears[i];
+				if (g->uniqueID == id.uniqueID) {
+					g->cfm = CFM{ USE_GLOBAL, 0.0 };
+				}
+			}
+			break;
 		}
 	}
 
@@ -1244,6 +1569,15 @@ namespace phyz {
 
 			}
 			break;
+		case ConstraintID::GEAR:
+			for (int i = 0; i < e->gears.size(); i++) {
+				Gear* g = e->gears[i];
+				if (g->uniqueID == id.uniqueID) {
+					delete g;
+					e->gears.erase(e->gears.begin() + i);
+				}
+			}
+			break;
 		}
 
 		constraint_map.erase(id.uniqueID);
@@ -1265,36 +1599,32 @@ namespace phyz {
 		RigidBody* b1 = n1->b;
 		RigidBody* b2 = n2->b;
 
-		for (Contact* c : e->contact_constraints) {
-			if (c->magic == magic) {
-				double friction = c->friction.getStaticReady() ? static_friction : kinetic_friction;
-				mthz::NVec<1> contact_impulse = warm_start_disabled ? mthz::NVec<1>{ 0.0 } : warm_start_coefficient * c->contact.impulse;
-				mthz::NVec<2> friction_impulse = warm_start_disabled ? mthz::NVec<2> { 0.0 } : warm_start_coefficient * c->friction.impulse;
-				//In niche circumstances two pairs of friction and contact constraints can oppose each other, and if friction is greater than one this can cause a loop of increasing impulses.
-				//Limiting the friction the the normal impulse from the last update helps mitigate this. Still not great if friction is high though.
-				double normal_impulse_limit = (warm_start_disabled || !friction_impulse_limit_enabled) ? std::numeric_limits<double>::infinity() : c->contact.impulse.v[0];
-
-				c->contact = ContactConstraint(b1, b2, norm, p, bounce, pen_depth, hardness, cfm.getCFMValue(global_cfm), contact_impulse, cutoff_vel);
-				c->friction = FrictionConstraint(b1, b2, norm, p, friction, &c->contact, cfm.getCFMValue(global_cfm), friction_impulse, c->friction.u, c->friction.w, normal_impulse_limit);
-				c->memory_life = contact_life;
-				c->is_live_contact = true;
-				c->cfm = cfm;
-				return;
-			}
+		Contact* c = e->findContact(magic);
+		if (c != nullptr) {
+			double friction = c->friction.getStaticReady() ? static_friction : kinetic_friction;
+			mthz::NVec<1> contact_impulse = warm_start_disabled ? mthz::NVec<1>{ 0.0 } : warm_start_coefficient * c->contact.impulse;
+			mthz::NVec<2> friction_impulse = warm_start_disabled ? mthz::NVec<2> { 0.0 } : warm_start_coefficient * c->friction.impulse;
+			//In niche circumstances two pairs of friction and contact constraints can oppose each other, and if friction is greater than one this can cause a loop of increasing impulses.
+			//Limiting the friction the the normal impulse from the last update helps mitigate this. Still not great if friction is high though.
+			double normal_impulse_limit = (warm_start_disabled || !friction_impulse_limit_enabled) ? std::numeric_limits<double>::infinity() : c->contact.impulse.v[0];
+
+			c->contact.refresh(norm, p, bounce, pen_depth, hardness, cfm.getCFMValue(global_cfm), contact_impulse, cutoff_vel);
+			c->friction.refresh(norm, p, friction, cfm.getCFMValue(global_cfm), friction_impulse, c->friction.u, c->friction.w, normal_impulse_limit);
+			c->memory_life = contact_life;
+			c->is_live_contact = true;
+			c->cfm = cfm;
+			return;
 		}
 
 		//if no warm start existed
-		Contact* c = new Contact();
+		c = e->createContact(magic);
 		c->b1 = b1;
 		c->b2 = b2;
 		c->contact = ContactConstraint(b1, b2, norm, p, bounce, pen_depth, hardness, cfm.getCFMValue(global_cfm), mthz::NVec<1>{0.0}, cutoff_vel);
 		c->friction = FrictionConstraint(b1, b2, norm, p, kinetic_friction, &c->contact, cfm.getCFMValue(global_cfm));
-		c->magic = magic;
 		c->memory_life = contact_life;
 		c->is_live_contact = true;
 		c->cfm = cfm;
-
-		e->contact_constraints.push_back(c);
 	}
 
 	void PhysicsEngine::applyVelocityChange(RigidBody* b, const mthz::Vec3& delta_vel, const mthz::Vec3& delta_ang_vel, const mthz::Vec3& delta_psuedo_vel, const mthz::Vec3& delta_psuedo_ang_vel) {
@@ -1370,6 +1700,20 @@ namespace phyz {
 		warm_start_disabled = b;
 	}
 
+	void PhysicsEngine::setTightAABBs(bool b) {
+		tight_AABBs = b;
+		for (RigidBody* r : bodies) {
+			r->setTightAABBs(b);
+		}
+	}
+
+	void PhysicsEngine::setLocalSpaceNarrowphase(bool b) {
+		local_space_narrowphase = b;
+		for (RigidBody* r : bodies) {
+			r->setLocalSpaceGeometry(b);
+		}
+	}
+
 	void PhysicsEngine::setSleepParameters(double vel_sensitivity, double ang_vel_sensitivity, double aceleration_sensitivity, double sleep_assesment_time, int non_sleepy_tick_threshold) {
 		vel_sleep_coeff = vel_sensitivity;
 		ang_vel_eps = ang_vel_sensitivity;
@@ -1418,6 +1762,12 @@ namespace phyz {
 			for (Weld* w : e->weld_constraints) {
 				w->constraint.impulse = mthz::NVec<6>{ 0.0 };
 			}
+			for (Spring* s : e->springs) {
+				s->constraint.impulse = mthz::NVec<1>{ 0.0 };
+			}
+			for (Gear* g : e->gears) {
+				g->constraint.impulse = mthz::NVec<1>{ 0.0 };
+			}
 		}
 	}
 
@@ -1439,6 +1789,8 @@ namespace phyz {
 	bool PhysicsEngine::bodySleepy(RigidBody* r) {
 		//not ideal as it prevents all other bodies in the same island from sleeping as well, but to make work otherwise would require a lot of reworking, and its a pretty niche use case
 		if (r->sleep_disabled) return false;	
+		//articulations don't sleep, as they are stepped whole outside of their islands
+		if (r->getArticulation() != nullptr) return false;
 
 		const std::vector<RigidBody::MovementState>& body_history = r->history;
 		int n = body_history.size();
@@ -1497,6 +1849,18 @@ namespace phyz {
 					to_visit.push_back(n);
 				}
 			}
+
+			//the links of an articulation all move together, so are always in the same island. The first dynamic link brings in all the others, the rest only it
+			Articulation* a = visiting_node->b->getArticulation();
+			if (a != nullptr) {
+				int first = (a->getRoot()->getMovementType() == RigidBody::DYNAMIC) ? 0 : 1;
+				int begin = (visiting_node->b == a->getLink(first)) ? first + 1 : first;
+				int end = (visiting_node->b == a->getLink(first)) ? a->getNumLinks() : first + 1;
+				for (int i = begin; i < end; i++) {
+					ConstraintGraphNode* n = constraint_graph_nodes[a->getLink(i)->getID()];
+					if (visited->find(n) == visited->end()) to_visit.push_back(n);
+				}
+			}
 		}
 	}
 
@@ -1663,55 +2027,17 @@ namespace phyz {
 	void PhysicsEngine::maintainConstraintGraphApplyPoweredConstraints() {
 		if (using_holonomic_system_solver()) shatterFracturedHolonomicSystems();
 
-		static int current_visit_tag_value = 0;
-		current_visit_tag_value++; //used to avoid visiting same constraint twice
-
-		//Spring forces are not included in the PGS solver, so in order for other constraints to be aware of their influence they must be applied before the target velocities of constraints are calculated
-		for (const auto& kv_pair : constraint_graph_nodes) {
-			ConstraintGraphNode* n = kv_pair.second;
-			for (auto i = 0; i < n->constraints.size(); i++) {
-				SharedConstraintsEdge* e = n->constraints[i];
-				if (using_holonomic_system_solver()) maintainAllHolonomicSystemStuffRelatedToThisEdge(e);
-
-				if (e->visited_tag == current_visit_tag_value)
-					continue; //skip
-				e->visited_tag = current_visit_tag_value;
-
-				for (Spring* s : e->springs) {
-					mthz::Vec3 b1_pos = s->b1->getTrackedP(s->b1_point_key);
-					mthz::Vec3 b2_pos = s->b2->getTrackedP(s->b2_point_key);
-					mthz::Vec3 diff = b2_pos - b1_pos;
-					double distance = diff.mag();
-					mthz::Vec3 dir = (distance != 0) ? (b2_pos - b1_pos).normalize() : mthz::Vec3(0, -1, 0);
-					double expand_force = s->stiffness * (distance - s->resting_length);
-
-					s->b1->applyImpulse(dir * expand_force * step_time, b1_pos);
-					s->b2->applyImpulse(-dir * expand_force * step_time, b2_pos);
-
-					mthz::Vec3 rA = b1_pos - s->b1->getCOM();
-					mthz::Vec3 rB = b2_pos - s->b2->getCOM();
-					mthz::Vec3 rotDirA = s->b1->getInvTensor() * dir.cross(rA);
-					mthz::Vec3 rotDirB = s->b2->getInvTensor() * dir.cross(rB);
-					//how easily force translates into velocity change
-					double velocity_sensitivity = 1.0 / (s->b1->getInvMass() + s->b2->getInvMass() + rA.cross(rotDirA).dot(dir) + rB.cross(rotDirB).dot(dir));
-
-					double velocity = s->b2->getVelOfPoint(b1_pos).dot(dir) - s->b1->getVelOfPoint(b2_pos).dot(dir);
-					double dampen = s->damping * velocity;
-					double max_dampen = velocity * velocity_sensitivity / step_time; //max brings to standstill, more would overshoot and push in the opposite direction
-					if (velocity > 0 && dampen > max_dampen) {
-						dampen = max_dampen;
-					}
-					else if (velocity < 0 && dampen < max_dampen) {
-						dampen = max_dampen;
-					}
-
-					s->b1->applyImpulse(dir * dampen * step_time, b1_pos);
-					s->b2->applyImpulse(-dir * dampen * step_time, b2_pos);
+		if (using_holonomic_system_solver()) {
+			for (const auto& kv_pair : constraint_graph_nodes) {
+				ConstraintGraphNode* n = kv_pair.second;
+				for (auto i = 0; i < n->constraints.size(); i++) {
+					maintainAllHolonomicSystemStuffRelatedToThisEdge(n->constraints[i]);
 				}
 			}
 		}
 
-		current_visit_tag_value++; //need to update this value again
+		static int current_visit_tag_value = 0;
+		current_visit_tag_value++; //used to avoid visiting same constraint twice
 		for (const auto& kv_pair : constraint_graph_nodes) {
 			ConstraintGraphNode* n = kv_pair.second;
 			for (auto i = 0; i < n->constraints.size(); i++) {
@@ -1722,12 +2048,11 @@ namespace phyz {
 					continue; //skip
 				e->visited_tag = current_visit_tag_value;
 
-				for (auto j = e->contact_constraints.begin(); j != e->contact_constraints.end();) {
-					Contact* contact = *j;
+				for (int j = 0; j < e->contact_constraints.size();) {
+					Contact* contact = e->contact_constraints[j];
 					contact->is_live_contact = false;
 					if (!contact->b1->getAsleep() && !contact->b2->getAsleep() && contact->memory_life-- < 0) {
-						delete contact;
-						j = e->contact_constraints.erase(j);
+						e->removeContact(j);
 					}
 					else {
 						j++;
@@ -1738,7 +2063,7 @@ namespace phyz {
 					mthz::Vec3 b2_pos = d->b2->getTrackedP(d->b2_point_key);
 					mthz::NVec<1> starting_impulse = warm_start_disabled ? mthz::NVec<1>{ 0.0} : warm_start_coefficient * d->constraint.impulse;
 					double pos_correct_coeff = d->pos_error_mode == PSUEDO_VELOCITY || true ? posCorrectCoeff(d->pos_correct_hardness, step_time) : 0;
-					d->constraint = DistanceConstraint(d->b1, d->b2, b1_pos, b2_pos, d->target_distance, pos_correct_coeff, d->cfm.getCFMValue(global_cfm), is_in_holonomic_system, starting_impulse);
+					d->constraint.refresh(b1_pos, b2_pos, d->target_distance, pos_correct_coeff, d->cfm.getCFMValue(global_cfm), is_in_holonomic_system, starting_impulse);
 				}
 				for (BallSocket* bs: e->ball_socket_constraints) {
 					//update constraint for new positions
@@ -1746,7 +2071,7 @@ namespace phyz {
 					mthz::Vec3 b2_pos = bs->b2->getTrackedP(bs->b2_point_key);
 					mthz::NVec<3> starting_impulse = warm_start_disabled ? mthz::NVec<3>{ 0.0} : warm_start_coefficient * bs->constraint.impulse;
 					double pos_correct_coeff = bs->pos_error_mode == PSUEDO_VELOCITY || true ? posCorrectCoeff(bs->pos_correct_hardness, step_time) : 0;
-					bs->constraint = BallSocketConstraint(bs->b1, bs->b2, b1_pos, b2_pos, pos_correct_coeff, bs->cfm.getCFMValue(global_cfm), is_in_holonomic_system, starting_impulse);
+					bs->constraint.refresh(b1_pos, b2_pos, pos_correct_coeff, bs->cfm.getCFMValue(global_cfm), is_in_holonomic_system, starting_impulse);
 				}
 				for (Hinge* h : e->hinge_constraints) {
 					mthz::Vec3 b1_pos = h->b1->getTrackedP(h->b1_point_key);
@@ -1766,7 +2091,7 @@ namespace phyz {
 					double rot_correct_coeff = h->pos_error_mode == PSUEDO_VELOCITY || true ? posCorrectCoeff(h->rot_correct_hardness, step_time) : 0;
 
 					mthz::NVec<5> starting_impulse = warm_start_disabled ? mthz::NVec<5>{ 0.0} : warm_start_coefficient * h->constraint.impulse;
-					h->constraint = HingeConstraint(h->b1, h->b2, b1_pos, b2_pos, b1_hinge_axis, b2_hinge_axis, pos_correct_coeff, rot_correct_coeff, h->cfm.getCFMValue(global_cfm), is_in_holonomic_system, starting_impulse, h->constraint.u, h->constraint.w);
+					h->constraint.refresh(b1_pos, b2_pos, b1_hinge_axis, b2_hinge_axis, pos_correct_coeff, rot_correct_coeff, h->cfm.getCFMValue(global_cfm), is_in_holonomic_system, starting_impulse, h->constraint.u, h->constraint.w);
 				}
 				for (Slider* s : e->slider_constraints) {
 					mthz::Vec3 b1_pos = s->b1->getTrackedP(s->b1_point_key);
@@ -1792,7 +2117,7 @@ namespace phyz {
 					double rot_correct_coeff = s->pos_error_mode == PSUEDO_VELOCITY || true ? posCorrectCoeff(s->rot_correct_hardness, step_time) : 0;
 
 					mthz::NVec<5> starting_impulse = warm_start_disabled ? mthz::NVec<5>{ 0.0} : warm_start_coefficient * s->constraint.impulse;
-					s->constraint = SliderConstraint(s->b1, s->b2, b1_pos, b2_pos, b1_slide_axis, pos_correct_coeff, pos_correct_coeff, s->cfm.getCFMValue(global_cfm), is_in_holonomic_system, starting_impulse, s->constraint.u, s->constraint.w);
+					s->constraint.refresh(b1_pos, b2_pos, b1_slide_axis, pos_correct_coeff, pos_correct_coeff, s->cfm.getCFMValue(global_cfm), is_in_holonomic_system, starting_impulse, s->constraint.u, s->constraint.w);
 				}
 				for (SlidingHinge* s : e->sliding_hinge_constraints) {
 					mthz::Vec3 b1_pos = s->b1->getTrackedP(s->b1_point_key);
@@ -1825,7 +2150,7 @@ namespace phyz {
 					double rot_correct_coeff = s->pos_error_mode == PSUEDO_VELOCITY || true ? posCorrectCoeff(s->rot_correct_hardness, step_time) : 0;
 
 					mthz::NVec<4> starting_impulse = warm_start_disabled ? mthz::NVec<4>{ 0.0} : warm_start_coefficient * s->constraint.impulse;
-					s->constraint = SlidingHingeConstraint(s->b1, s->b2, b1_pos, b2_pos, b1_slide_axis, b2_slide_axis, pos_correct_coeff, rot_correct_coeff, s->cfm.getCFMValue(global_cfm), is_in_holonomic_system, starting_impulse, s->constraint.u, s->constraint.w);
+					s->constraint.refresh(b1_pos, b2_pos, b1_slide_axis, b2_slide_axis, pos_correct_coeff, rot_correct_coeff, s->cfm.getCFMValue(global_cfm), is_in_holonomic_system, starting_impulse, s->constraint.u, s->constraint.w);
 				}
 				for (Weld* w : e->weld_constraints) {
 					mthz::Vec3 b1_pos = w->b1->getTrackedP(w->b1_point_key);
@@ -1835,7 +2160,22 @@ namespace phyz {
 					double rot_correct_coeff = w->pos_error_mode == PSUEDO_VELOCITY || true ? posCorrectCoeff(w->rot_correct_hardness, step_time) : 0;
 
 					mthz::NVec<6> starting_impulse = warm_start_disabled ? mthz::NVec<6>{ 0.0} : warm_start_coefficient * w->constraint.impulse;
-					w->constraint = WeldConstraint(w->b1, w->b2, b1_pos, b2_pos, pos_correct_coeff, rot_correct_coeff, w->cfm.getCFMValue(global_cfm), is_in_holonomic_system, w->constraint.impulse);
+					w->constraint.refresh(b1_pos, b2_pos, pos_correct_coeff, rot_correct_coeff, w->cfm.getCFMValue(global_cfm), is_in_holonomic_system, starting_impulse);
+				}
+				for (Spring* s : e->springs) {
+					mthz::Vec3 b1_pos = s->b1->getTrackedP(s->b1_point_key);
+					mthz::Vec3 b2_pos = s->b2->getTrackedP(s->b2_point_key);
+					mthz::NVec<1> starting_impulse = warm_start_disabled ? mthz::NVec<1>{ 0.0} : warm_start_coefficient * s->constraint.impulse;
+					s->constraint.refresh(b1_pos, b2_pos, s->resting_length, s->stiffness, s->damping, step_time, global_cfm, starting_impulse);
+				}
+				for (Gear* g : e->gears) {
+					mthz::Vec3 b1_axis = g->b1->orientation.applyRotation(g->b1_rot_axis_body_space);
+					mthz::Vec3 b2_axis = g->b2->orientation.applyRotation(g->b2_axis_body_space);
+					//see recalculateSystem, only the first gear of an edge without joints is part of the system
+					bool gear_in_holonomic_system = is_in_holonomic_system && g == e->gears[0] && !e->hasHolonomicJoint();
+
+					mthz::NVec<1> starting_impulse = warm_start_disabled ? mthz::NVec<1>{ 0.0} : warm_start_coefficient * g->constraint.impulse;
+					g->constraint.refresh(b1_axis, b2_axis, g->b2_slides, g->ratio, g->cfm.getCFMValue(global_cfm), gear_in_holonomic_system, starting_impulse);
 				}
 
 				if (e->noConstraintsLeft()) {
@@ -1844,6 +2184,10 @@ namespace phyz {
 				}
 			}
 		}
+
+		for (Cable* c : cables) {
+			c->refresh(posCorrectCoeff(c->pos_correct_hardness, step_time), global_cfm, warm_start_disabled ? 0 : warm_start_coefficient, step_time);
+		}
 	}
 
 	void PhysicsEngine::shatterFracturedHolonomicSystems() {
@@ -1867,6 +2211,9 @@ namespace phyz {
 	void PhysicsEngine::maintainAllHolonomicSystemStuffRelatedToThisEdge(SharedConstraintsEdge* e) {
 		//when a new constraint is added, or is suddenly made able to connect systems together (e.g. was fixed, was just made dynamic)
 		//we need to check if we can either include this constraint in a new system, potentially merging multiple systems together.
+		//constraints on articulated bodies are solved with their articulation instead
+		if (edgeTouchesArticulation(e)) return;
+
 		if (e->holonomic_system_scan_needed) {
 			e->holonomic_system_scan_needed = false;
 
@@ -1937,6 +2284,7 @@ namespace phyz {
 			struct InStruct {
 				bool* all_ready_to_sleep;
 				std::vector<HolonomicSystem*>* island_systems;
+				std::vector<Cable*>* island_cables;
 				std::vector<Constraint*>* island_constraints;
 				std::vector<RigidBody*>* island_bodies;
 				std::vector<Distance*>* mast_slav_ds;
@@ -1947,7 +2295,7 @@ namespace phyz {
 				std::vector<Weld*>* mast_slav_ws;
 			};
 			
-			InStruct in = { &all_ready_to_sleep, &island_constraints.systems, &island_constraints.constraints, &island_bodies, & out.mast_slav_ds, &out.mast_slav_bss, &out.mast_slav_hs, &out.mast_slav_ss, &out.mast_slav_shs, &out.mast_slav_ws };
+			InStruct in = { &all_ready_to_sleep, &island_constraints.systems, &island_constraints.cables, &island_constraints.constraints, &island_bodies, & out.mast_slav_ds, &out.mast_slav_bss, &out.mast_slav_hs, &out.mast_slav_ss, &out.mast_slav_shs, &out.mast_slav_ws };
 			int new_contact_life = this->contact_life;
 			bfsVisitAll(n, &visited, (void*)&in, [&visited, new_contact_life, this](ConstraintGraphNode* curr, void* in) {
 				InStruct* output = (InStruct*)in;
@@ -1964,6 +2312,11 @@ namespace phyz {
 					if (using_holonomic_system_solver() && e->h != nullptr && std::find(output->island_systems->begin(), output->island_systems->end(), &e->h->system) == output->island_systems->end()) {
 						output->island_systems->push_back(&e->h->system);
 					}
+					for (Cable* c : e->cables) {
+						if (std::find(output->island_cables->begin(), output->island_cables->end(), c) == output->island_cables->end()) {
+							output->island_cables->push_back(c);
+						}
+					}
 
 					for (Contact* c: e->contact_constraints) {
 						if (c->is_live_contact) {
@@ -2013,6 +2366,12 @@ namespace phyz {
 						if (w->pos_error_mode == MASTER_SLAVE) output->mast_slav_ws->push_back(w);
 						output->island_constraints->push_back(&w->constraint);
 					}
+					for (Spring* s : e->springs) {
+						output->island_constraints->push_back(&s->constraint);
+					}
+					for (Gear* g : e->gears) {
+						output->island_constraints->push_back(&g->constraint);
+					}
 					
 				}
 
@@ -2020,12 +2379,19 @@ namespace phyz {
 					*output->all_ready_to_sleep = false;
 				}
 			});
+			//sub-stepped solves have no place for the direct solve, so there cables are ordinary rows
+			for (Cable* c : island_constraints.cables) {
+				if (pgs_substeps > 1) c->getAllRows(&island_constraints.constraints);
+				else				  c->getLooseRows(&island_constraints.constraints);
+			}
+			if (pgs_substeps > 1) island_constraints.cables.clear();
+
 			if (sleeping_enabled && all_ready_to_sleep) {
 				for (RigidBody* b : island_bodies) {
 					b->sleep();
 				}
 			}
-			else if (island_constraints.constraints.size() > 0) {
+			else if (island_constraints.constraints.size() > 0 || !island_constraints.cables.empty()) {
 				/*printf("\nIsland Contains %d holonomic systems, %d constraints:\n", island_constraints.systems.size(), island_constraints.constraints.size());
 				for (HolonomicSystem* h : island_constraints.systems) {
 					printf("\tSystem of degree: %d composed of %d constraints\n", h->getDegree(), h->getNumConstraints());
@@ -2034,9 +2400,103 @@ namespace phyz {
 			}
 		}
 
+		if (island_solver_bodies.size() < out.island_systems.size()) {
+			island_solver_bodies.resize(out.island_systems.size());
+			island_solver_rows.resize(out.island_systems.size());
+		}
+		island_solve_stats.assign(out.island_systems.size(), PGSSolveStats());
+		for (int i = 0; i < out.island_systems.size(); i++) {
+			IslandConstraints& island = out.island_systems[i];
+			island.solver_bodies = &island_solver_bodies[i];
+			island.solver_rows = &island_solver_rows[i];
+			island.solver_rows->use_contact_blocks = block_contact_solver;
+			island.solver_rows->use_nncg = nncg_solver && island.constraints.size() >= nncg_min_constraints;
+			island.solver_rows->use_shock_propagation = shock_propagation && island.constraints.size() >= shock_propagation_min_constraints;
+			island.solver_rows->use_contact_batches = simd_contact_solver && !block_contact_solver && !island.solver_rows->use_nncg && !island.solver_rows->use_shock_propagation;
+			island.stats = &island_solve_stats[i];
+			assignSolverBodies(island.constraints, island.cables, island.solver_bodies);
+			assignIterationBudget(&island);
+		}
+
 		return out;
 	}
 
+	//dynamic bodies belong to exactly one island, so their solver index can be stored on the body itself
+	void PhysicsEngine::assignSolverBodies(const std::vector<Constraint*>& constraints, const std::vector<Cable*>& cables, SolverBodies* solver_bodies) {
+		std::vector<Constraint*> cable_rows;
+		for (Cable* c : cables) {
+			c->getBandRows(&cable_rows);
+		}
+
+		for (Constraint* c : constraints) {
+			c->a->solver_index = -1;
+			c->b->solver_index = -1;
+		}
+		for (Constraint* c : cable_rows) {
+			c->a->solver_index = -1;
+			c->b->solver_index = -1;
+		}
+
+		solver_bodies->bodies.clear();
+		solver_bodies->bodies.push_back(nullptr);
+
+		//articulated bodies are moved by their articulation's velocity changes instead
+		auto get_index = [&](RigidBody* b) {
+			if (b->getMovementType() != RigidBody::DYNAMIC || b->getArticulation() != nullptr) {
+				return 0;
+			}
+			if (b->solver_index == -1) {
+				b->solver_index = solver_bodies->bodies.size();
+				solver_bodies->bodies.push_back(b);
+			}
+			return b->solver_index;
+		};
+
+		for (Constraint* c : constraints) {
+			c->a_solver_index = get_index(c->a);
+			c->b_solver_index = get_index(c->b);
+		}
+		for (Constraint* c : cable_rows) {
+			c->a_solver_index = get_index(c->a);
+			c->b_solver_index = get_index(c->b);
+		}
+	}
+
+	//last_iterations is what the island needed to converge last step, -1 if it didn't and 0 if there is no history. Gauss-Seidel moves an impulse
+	//one constraint further through the island per sweep, so an island that isn't converging is given up to one iteration per constraint
+	int PhysicsEngine::pgsIterationBudget(int last_iterations, int n_constraints, int n_itr, int max_itr) {
+		if (!adaptive_pgs_iterations || last_iterations == 0) {
+			return n_itr;
+		}
+		else if (last_iterations == -1) {
+			return std::max<int>(n_itr, std::min<int>(n_constraints, max_itr));
+		}
+		else {
+			return std::max<int>(pgsMinIterations, std::min<int>(last_iterations + 2, max_itr));
+		}
+	}
+
+	//bodies keep the convergence history, as islands don't persist between steps. An island takes the worst history among its bodies
+	void PhysicsEngine::assignIterationBudget(IslandConstraints* island) {
+		int last_vel_iterations = 0;
+		int last_pos_iterations = 0;
+		const std::vector<RigidBody*>& bodies = island->solver_bodies->bodies;
+		for (int i = 1; i < bodies.size(); i++) {
+			if (last_vel_iterations != -1) last_vel_iterations = (bodies[i]->solver_vel_iterations == -1) ? -1 : std::max<int>(last_vel_iterations, bodies[i]->solver_vel_iterations);
+			if (last_pos_iterations != -1) last_pos_iterations = (bodies[i]->solver_pos_iterations == -1) ? -1 : std::max<int>(last_pos_iterations, bodies[i]->solver_pos_iterations);
+		}
+
+		island->n_itr_vel = pgsIterationBudget(last_vel_iterations, island->constraints.size(), pgsVelIterations, pgsMaxVelIterations);
+		island->n_itr_pos = pgsIterationBudget(last_pos_iterations, island->constraints.size(), pgsPosIterations, pgsMaxPosIterations);
+	}
+
+	void PhysicsEngine::recordSolveStats(const SolverBodies& solver_bodies, const PGSSolveStats& stats) {
+		for (int i = 1; i < solver_bodies.bodies.size(); i++) {
+			solver_bodies.bodies[i]->solver_vel_iterations = stats.vel_converged ? stats.vel_iterations : -1;
+			solver_bodies.bodies[i]->solver_pos_iterations = stats.pos_converged ? stats.pos_iterations : -1;
+		}
+	}
+
 	CollisionTarget CollisionTarget::with(RigidBody* r) {
 		return CollisionTarget(false, r->getID());
 	}
@@ -2142,6 +2602,123 @@ namespace phyz {
 
 	}
 
+	Articulation* PhysicsEngine::createArticulation(RigidBody* root) {
+		assert(root->articulation == nullptr);
+		Articulation* a = new Articulation(root);
+		articulations.push_back(a);
+		return a;
+	}
+
+	void PhysicsEngine::addArticulationHinge(Articulation* a, RigidBody* parent, RigidBody* child, mthz::Vec3 pivot, mthz::Vec3 rot_axis) {
+		addArticulationJoint(a, parent, child, Articulation::HINGE, pivot, rot_axis.normalize());
+	}
+
+	void PhysicsEngine::addArticulationSlider(Articulation* a, RigidBody* parent, RigidBody* child, mthz::Vec3 pivot, mthz::Vec3 slide_axis) {
+		addArticulationJoint(a, parent, child, Articulation::SLIDER, pivot, slide_axis.normalize());
+	}
+
+	void PhysicsEngine::addArticulationBallJoint(Articulation* a, RigidBody* parent, RigidBody* child, mthz::Vec3 pivot) {
+		addArticulationJoint(a, parent, child, Articulation::BALL, pivot, mthz::Vec3());
+	}
+
+	void PhysicsEngine::addArticulationJoint(Articulation* a, RigidBody* parent, RigidBody* child, Articulation::JointType joint, mthz::Vec3 pivot, mthz::Vec3 axis) {
+		a->addJoint(parent, child, joint, pivot, axis);
+
+		//any holonomic system the links were part of is broken up and rebuilt without them
+		for (RigidBody* b : { parent, child }) {
+			for (SharedConstraintsEdge* e : constraint_graph_nodes[b->getID()]->constraints) {
+				if (e->h != nullptr) e->h->edge_removed_flag = true;
+			}
+		}
+	}
+
+	void PhysicsEngine::removeArticulation(Articulation* a) {
+		for (int i = 0; i < a->getNumLinks(); i++) {
+			a->getLink(i)->articulation = nullptr;
+		}
+
+		//constraints on the links may now be part of holonomic systems
+		for (int i = 0; i < a->getNumLinks(); i++) {
+			for (SharedConstraintsEdge* e : constraint_graph_nodes[a->getLink(i)->getID()]->constraints) {
+				if (e->hasHolonomicConstraint() && e->h == nullptr) e->holonomic_system_scan_needed = true;
+			}
+		}
+
+		articulations.erase(std::find(articulations.begin(), articulations.end(), a));
+		delete a;
+	}
+
+	Articulation::Link* PhysicsEngine::fetchArticulationJoint(RigidBody* link) {
+		Articulation* a = link->articulation;
+		assert(a != nullptr && link->articulation_link != 0);
+		return &a->links[link->articulation_link];
+	}
+
+	double PhysicsEngine::getArticulationJointPosition(RigidBody* link) {
+		return fetchArticulationJoint(link)->position;
+	}
+
+	void PhysicsEngine::setArticulationJointForce(RigidBody* link, double force) {
+		Articulation::Link* l = fetchArticulationJoint(link);
+		assert(l->joint == Articulation::HINGE || l->joint == Articulation::SLIDER);
+		l->joint_force = force;
+	}
+
+	Cable* PhysicsEngine::createCable(const std::vector<RigidBody*>& segments, double bending_stiffness, double pos_correct_strength) {
+		for (RigidBody* b : segments) {
+			assert(b->getMovementType() == RigidBody::DYNAMIC && b->articulation == nullptr);
+		}
+
+		Cable* c = new Cable(segments, bending_stiffness, pos_correct_strength);
+		for (int i = 0; i < segments.size() - 1; i++) {
+			disallowCollision(segments[i], segments[i + 1]);
+			if (i + 2 < segments.size()) disallowCollision(segments[i], segments[i + 2]);
+
+			//edges keep the segments in one island
+			constraint_graph_nodes[segments[i]->getID()]->getOrCreateEdgeTo(constraint_graph_nodes[segments[i + 1]->getID()])->cables.push_back(c);
+		}
+
+		cables.push_back(c);
+		return c;
+	}
+
+	void PhysicsEngine::attachCable(Cable* c, RigidBody* b, mthz::Vec3 attach_pos_local, bool at_start) {
+		assert(b->articulation == nullptr);
+		RigidBody* end = at_start ? c->segments.front() : c->segments.back();
+
+		c->attach(b, b->trackPoint(attach_pos_local), at_start);
+		disallowCollision(b, end);
+		constraint_graph_nodes[b->getID()]->getOrCreateEdgeTo(constraint_graph_nodes[end->getID()])->cables.push_back(c);
+
+		b->alertWakingAction();
+		end->alertWakingAction();
+	}
+
+	void PhysicsEngine::removeCable(Cable* c) {
+		//the same pairs createCable and attachCable disallowed, whether or not there are bending links between them
+		const std::vector<RigidBody*>& segments = c->segments;
+		for (int i = 0; i < segments.size() - 1; i++) {
+			reallowCollision(segments[i], segments[i + 1]);
+			if (i + 2 < segments.size()) reallowCollision(segments[i], segments[i + 2]);
+		}
+		if (c->start_attachment != -1) reallowCollision(c->links[c->start_attachment].b1, segments.front());
+		if (c->end_attachment != -1)   reallowCollision(c->links[c->end_attachment].b1, segments.back());
+
+		for (const Cable::Link& l : c->links) {
+			l.b1->alertWakingAction();
+			l.b2->alertWakingAction();
+
+			//edges left empty are deleted with the rest in maintainConstraintGraphApplyPoweredConstraints
+			if (!l.bending) {
+				SharedConstraintsEdge* e = constraint_graph_nodes[l.b1->getID()]->getOrCreateEdgeTo(constraint_graph_nodes[l.b2->getID()]);
+				e->cables.erase(std::find(e->cables.begin(), e->cables.end(), c));
+			}
+		}
+
+		cables.erase(std::find(cables.begin(), cables.end(), c));
+		delete c;
+	}
+
 	std::vector<PhysicsEngine::SharedConstraintsEdge*> PhysicsEngine::getAllEdgesConnectedHolonomically(SharedConstraintsEdge* e) {
 		std::set<SharedConstraintsEdge*> visited;
 		std::vector<SharedConstraintsEdge*> to_visit = { e };
@@ -2168,7 +2745,7 @@ namespace phyz {
 				
 				if (visited.find(neighbor) != visited.end()) continue;
 
-				if (neighbor->hasHolonomicConstraint()) {
+				if (neighbor->hasHolonomicConstraint() && !edgeTouchesArticulation(neighbor)) {
 					to_visit.push_back(neighbor);
 				}
 			}
@@ -2233,6 +2810,13 @@ namespace phyz {
 				constraints.push_back(&c->constraint);
 				continue;
 			}
+			if (!e->gears.empty()) {
+				Gear* c = e->gears[0];
+				c->constraint.a = c->b1;
+				c->constraint.b = c->b2;
+				constraints.push_back(&c->constraint);
+				continue;
+			}
 		}
 
 		system = HolonomicSystem(constraints);
@@ -2405,9 +2989,71 @@ namespace phyz {
 			if (h->member_edges.size() <= 1) delete h;
 		}
 		for (Contact* c : contact_constraints) delete c;
+		for (Contact* c : contact_pool) delete c;
 		for (BallSocket* b : ball_socket_constraints) delete b;
 		for (Hinge* h : hinge_constraints) delete h;
 		for (Slider* s : slider_constraints) delete s;
+		for (Gear* g : gears) delete g;
+	}
+
+	PhysicsEngine::Contact* PhysicsEngine::SharedConstraintsEdge::findContact(const MagicID& magic) {
+		if (contact_lookup.empty()) return nullptr;
+
+		size_t mask = contact_lookup.size() - 1;
+		for (size_t i = std::hash<MagicID>()(magic) & mask; contact_lookup[i] != nullptr; i = (i + 1) & mask) {
+			if (contact_lookup[i]->magic == magic) return contact_lookup[i];
+		}
+		return nullptr;
+	}
+
+	PhysicsEngine::Contact* PhysicsEngine::SharedConstraintsEdge::createContact(const MagicID& magic) {
+		Contact* c;
+		if (contact_pool.empty()) {
+			c = new Contact();
+		}
+		else {
+			c = contact_pool.back();
+			contact_pool.pop_back();
+		}
+		c->magic = magic;
+		contact_constraints.push_back(c);
+
+		if (2 * contact_constraints.size() > contact_lookup.size()) {
+			contact_lookup.assign(std::max<size_t>(8, 2 * contact_lookup.size()), nullptr);
+			for (Contact* existing : contact_constraints) insertIntoLookup(existing);
+		}
+		else {
+			insertIntoLookup(c);
+		}
+		return c;
+	}
+
+	void PhysicsEngine::SharedConstraintsEdge::insertIntoLookup(Contact* c) {
+		size_t mask = contact_lookup.size() - 1;
+		size_t i = std::hash<MagicID>()(c->magic) & mask;
+		while (contact_lookup[i] != nullptr) i = (i + 1) & mask;
+		contact_lookup[i] = c;
+	}
+
+	void PhysicsEngine::SharedConstraintsEdge::removeContact(int i) {
+		Contact* c = contact_constraints[i];
+
+		//backward shift deletion. Following entries move into the hole if it is on their probe sequence, so lookups never need tombstones
+		size_t mask = contact_lookup.size() - 1;
+		size_t hole = std::hash<MagicID>()(c->magic) & mask;
+		while (contact_lookup[hole] != c) hole = (hole + 1) & mask;
+		for (size_t j = (hole + 1) & mask; contact_lookup[j] != nullptr; j = (j + 1) & mask) {
+			size_t home = std::hash<MagicID>()(contact_lookup[j]->magic) & mask;
+			if (((j - home) & mask) >= ((j - hole) & mask)) {
+				contact_lookup[hole] = contact_lookup[j];
+				hole = j;
+			}
+		}
+		contact_lookup[hole] = nullptr;
+
+		contact_constraints[i] = contact_constraints.back();
+		contact_constraints.pop_back();
+		contact_pool.push_back(c);
 	}
 
 	PhysicsEngine::ConstraintGraphNode::~ConstraintGraphNode() {
@@ -3,6 +3,8 @@
 #include "CollisionDetect.h"
 #include "ConstraintSolver.h"
 #include "HolonomicBlockSolver.h"
+#include "Articulation.h"
+#include "Cable.h"
 #include "ThreadManager.h"
 #include "Octree.h"
 #include "AABB_Tree.h"
@@ -40,7 +42,7 @@ namespace phyz {
 
 	struct ConstraintID {
 		ConstraintID() : uniqueID(-1) {}
-		enum Type { DISTANCE, BALL, HINGE, SLIDER, SPRING, SLIDING_HINGE, WELD };
+		enum Type { DISTANCE, BALL, HINGE, SLIDER, SPRING, SLIDING_HINGE, WELD, GEAR };
 		inline Type getType() { return type; }
 
 		friend class PhysicsEngine;
@@ -59,6 +61,14 @@ namespace phyz {
 		double hit_distance;
 	};
 
+	struct ClosestPointsInfo {
+		bool valid; //false if there is no geometry to measure between, e.g. two static meshes
+		double distance; //negative penetration depth if the bodies overlap
+		mthz::Vec3 b1_point;
+		mthz::Vec3 b2_point;
+		mthz::Vec3 normal; //facing away from b1
+	};
+
 	enum BroadPhaseStructure { NONE, OCTREE, AABB_TREE, TEST_COMPARE };
 
 	class PhysicsEngine {
@@ -73,6 +83,11 @@ namespace phyz {
 		void extrapolateObjectPositions(double time_elapsed);
 		RigidBody* createRigidBody(const ConvexUnionGeometry& geometry, RigidBody::MovementType movement_type=RigidBody::DYNAMIC, mthz::Vec3 position=mthz::Vec3(), mthz::Quaternion orientation=mthz::Quaternion(), bool override_center_of_mass=false, mthz::Vec3 center_of_mass_override=mthz::Vec3());
 		RigidBody* createRigidBody(const StaticMeshGeometry& geometry, bool fixed=true);
+		//bodies created from the same shape share its reference geometry instead of each holding a copy. Use for many identical bodies
+		static std::shared_ptr<const RigidBodyShape> createShape(const ConvexUnionGeometry& geometry, bool override_center_of_mass=false, mthz::Vec3 center_of_mass_override=mthz::Vec3());
+		static std::shared_ptr<const RigidBodyShape> createShape(const StaticMeshGeometry& geometry);
+		//position places the shapes local origin and orientation rotates it about its center of mass. Static meshes are only copied out of the shared geometry when posed away from where they were defined
+		RigidBody* createRigidBody(std::shared_ptr<const RigidBodyShape> shape, RigidBody::MovementType movement_type=RigidBody::DYNAMIC, mthz::Vec3 position=mthz::Vec3(), mthz::Quaternion orientation=mthz::Quaternion());
 		void removeRigidBody(RigidBody* r);
 		void applyVelocityChange(RigidBody* b, const mthz::Vec3& delta_vel, const mthz::Vec3& delta_ang_vel, const mthz::Vec3& delta_psuedo_vel=mthz::Vec3(), const mthz::Vec3&delta_psuedo_ang_vel=mthz::Vec3());
 		void disallowCollisionSet(const std::initializer_list<RigidBody*>& bodies);
@@ -84,6 +99,8 @@ namespace phyz {
 		void reallowCollision(RigidBody* b1, RigidBody* b2);
 		
 		RayHitInfo raycastFirstIntersection(mthz::Vec3 ray_origin, mthz::Vec3 ray_dir, std::vector<RigidBody*> ignore_list = std::vector<RigidBody*>()) const;
+		ClosestPointsInfo closestPoints(RigidBody* b1, RigidBody* b2);
+		std::vector<ClosestPointsInfo> closestPoints(const std::vector<std::pair<RigidBody*, RigidBody*>>& body_pairs);
 
 		inline int getNumBodies() { return bodies.size(); }
 		inline mthz::Vec3 getGravity() { return gravity; }
@@ -92,6 +109,37 @@ namespace phyz {
 		unsigned int getNextBodyID();
 
 		void setPGSIterations(int n_vel, int n_pos, int n_holonomic = 3) { pgsVelIterations = n_vel; pgsPosIterations = n_pos; pgsHolonomicIterations = n_holonomic; }
+		//islands with at least min_island_constraints constraints are solved one at a time with their constraints split between threads by graph coloring,
+		//rather than each island on a single thread. Results don't depend on the number of threads
+		void setGraphColoredSolver(bool enabled, int min_island_constraints = 256) { graph_colored_solver = enabled; graph_colored_min_constraints = min_island_constraints; }
+		//contacts are packed into batches that share no body and solved several at a time with AVX when the CPU supports it, otherwise with an equivalent scalar loop.
+		//Not used when the block contact solver is enabled, nor on islands that use NNCG or shock propagation
+		void setSIMDContactSolver(bool enabled) { simd_contact_solver = enabled; }
+		//the normal rows of each contact manifold are solved together, exactly, rather than one at a time. Stacks need far fewer iterations to settle.
+		//Friction is still solved per contact
+		void setBlockContactSolver(bool enabled) { block_contact_solver = enabled; }
+		//islands with at least min_island_constraints constraints are solved with nonsmooth nonlinear conjugate gradient, each PGS sweep followed by a step
+		//along the changes of earlier sweeps. Tall stacks converge in far fewer sweeps
+		void setNNCGSolver(bool enabled, int min_island_constraints = 0) { nncg_solver = enabled; nncg_min_constraints = min_island_constraints; }
+		//islands with at least min_island_constraints constraints end the velocity phase of each step with a shock propagation sweep, solving
+		//contacts bottom up along gravity with the lower body of each treated as immovable. Tall stacks stay up with about half the iterations
+		void setShockPropagation(bool enabled, int min_island_constraints = 0) { shock_propagation = enabled; shock_propagation_min_constraints = min_island_constraints; }
+		//holonomic systems with at least min_system_constraints constraints are factorized and solved with independent subtrees of their elimination tree
+		//on different threads, their islands solved one at a time. Results don't depend on the number of threads
+		void setParallelHolonomicSolver(bool enabled, int min_system_constraints = 128) { parallel_holonomic_solver = enabled; parallel_holonomic_min_constraints = min_system_constraints; }
+		//a PGS phase ends once no impulse changes by more than tolerance in a sweep. At 0 it ends only when nothing changes
+		void setPGSResidualTolerance(double tolerance) { pgs_residual_tolerance = tolerance; }
+		//each island's iteration count comes from how it converged last step rather than the fixed setPGSIterations counts. Islands that converged get
+		//a little more than they used, islands that didn't get one iteration per constraint, bounded by setPGSIterations and the maximums given here
+		void setAdaptivePGSIterations(bool enabled, int max_vel_iterations = 60, int max_pos_iterations = 45, int min_iterations = 2) { 
+			adaptive_pgs_iterations = enabled; pgsMaxVelIterations = max_vel_iterations; pgsMaxPosIterations = max_pos_iterations; pgsMinIterations = min_iterations;
+		}
+		//with n above 1 each island is solved in n substeps of one sweep each, the position error of its rows re-estimated from how far the substeps
+		//have moved their bodies, followed by one sweep that removes the velocity the position correction added. Stiff rigs need far fewer sweeps
+		//than the setPGSIterations counts, which are not used while sub-stepping. Holonomic systems are solved as ordinary rows
+		void setSubsteps(int n) { pgs_substeps = std::max<int>(n, 1); }
+		//iterations used and final residuals of each island solved in the last step
+		const std::vector<PGSSolveStats>& getIslandSolveStats() { return island_solve_stats; }
 		void setSleepingEnabled(bool sleeping);
 		void setStep_time(double d);
 		void setGravity(const mthz::Vec3& v);
@@ -101,9 +149,15 @@ namespace phyz {
 		void setAngleVelUpdateTickCount(int n);
 		void setInternalGyroscopicForcesDisabled(bool b);
 		void setWarmStartDisabled(bool b);
+		//collision detection works from each body's local geometry plus the relative transform of the pair, so moving bodies don't rebuild world space geometry every step
+		void setLocalSpaceNarrowphase(bool b);
+		//exact, rather than loose but constant time, world AABBs for rotated primitives. Fewer false broadphase pairs for a small cost per primitive
+		void setTightAABBs(bool b);
 		void setSleepParameters(double vel_sensitivity, double ang_vel_sensitivity, double aceleration_sensitivity, double sleep_assesment_time, int non_sleepy_tick_threshold);
 		void setGlobalConstraintForceMixing(double cfm);
 		void setHolonomicSolverCFM(double cfm);
+		//holonomic systems are refactorized every n_steps steps rather than every step. Cheaper for large jointed systems whose jacobians change slowly
+		void setHolonomicRefactorInterval(int n_steps) { holonomic_refactor_interval = std::max<int>(n_steps, 1); }
 
 		//really only exists for debugging
 		void deleteWarmstartData(RigidBody* r);
@@ -140,9 +194,19 @@ namespace phyz {
 			double positive_slide_limit = std::numeric_limits<double>::infinity(), double min_angle = -std::numeric_limits<double>::infinity(), double max_angle = std::numeric_limits<double>::infinity(), 
 			double pos_correct_strength = 1000, double rot_correct_strength = 1000);
 
+		//solved implicitly as a soft row alongside the other constraints, so it stays stable at the usual step time however stiff it is
 		ConstraintID addSpring(RigidBody* b1, RigidBody* b2, mthz::Vec3 b1_attach_pos_local, mthz::Vec3 b2_attach_pos_local, double damping, double stiffness, double resting_length = -1);
 		ConstraintID addWeldConstraint(RigidBody* b1, RigidBody* b2, mthz::Vec3 attach_point_local, double pos_correct_strength = 1000, double rot_correct_strength = 1000);
 
+		//couplings between the axes of two bodies, each usually held to a common body by a hinge or slider. A single row stands in for the contacts
+		//of toothed geometry, and the pair doesn't collide. Only rates are coupled, measured in world space, see GearConstraint
+		//b2 turns ratio times as fast as b1 about their axes. Meshing gears with the same axis direction have a ratio of minus b1's teeth over b2's
+		ConstraintID addGearConstraint(RigidBody* b1, RigidBody* b2, mthz::Vec3 b1_rot_axis_local, mthz::Vec3 b2_rot_axis_local, double ratio);
+		//the rack slides along its axis by pinion_radius for each radian the pinion turns about its own
+		ConstraintID addRackAndPinionConstraint(RigidBody* pinion, RigidBody* rack, mthz::Vec3 pinion_rot_axis_local, mthz::Vec3 rack_slide_axis_local, double pinion_radius);
+		//pulleys joined by a belt turn the same way, at the inverse ratio of their radii
+		ConstraintID addBeltConstraint(RigidBody* b1, RigidBody* b2, mthz::Vec3 b1_rot_axis_local, mthz::Vec3 b2_rot_axis_local, double b1_radius, double b2_radius);
+
 		void setConstraintPosCorrectMethod(ConstraintID id, PosErrorResolutionMode error_correct_method, bool b1_master = true);
 		void setConstraintUseCustomCFM(ConstraintID id, double custom_cfm);
 		void setConstraintUseGlobalCFM(ConstraintID id);
@@ -165,6 +229,25 @@ namespace phyz {
 		void setDistanceConstraintTargetDistance(ConstraintID id, double target_distance);
 		double getDistanceConstraintTargetDistance(ConstraintID id);
 
+		//a tree of bodies joined in reduced coordinates, see Articulation. Joints are added parent first, pivots and axes given in world coordinates.
+		//A dynamic root moves freely, any other root is a base the tree is mounted on. Links of the same articulation don't collide with each other
+		Articulation* createArticulation(RigidBody* root);
+		void addArticulationHinge(Articulation* a, RigidBody* parent, RigidBody* child, mthz::Vec3 pivot, mthz::Vec3 rot_axis);
+		void addArticulationSlider(Articulation* a, RigidBody* parent, RigidBody* child, mthz::Vec3 pivot, mthz::Vec3 slide_axis);
+		void addArticulationBallJoint(Articulation* a, RigidBody* parent, RigidBody* child, mthz::Vec3 pivot);
+		void removeArticulation(Articulation* a);
+		//angle of the hinge, or offset of the slider, joining link to its parent
+		double getArticulationJointPosition(RigidBody* link);
+		//constant torque of the hinge, or force of the slider, joining link to its parent
+		void setArticulationJointForce(RigidBody* link, double force);
+
+		//a chain of dynamic segments solved directly in O(n), see Cable. Neighbouring segments, and segments one apart, don't collide. Bending stiffness
+		//is that of springs between every other segment, 0 for none. Either end can be attached to a body that isn't articulated, kept at its current
+		//distance from the attach point. Removing any of its bodies removes the cable
+		Cable* createCable(const std::vector<RigidBody*>& segments, double bending_stiffness = 0, double pos_correct_strength = 1000);
+		void attachCable(Cable* c, RigidBody* b, mthz::Vec3 attach_pos_local, bool at_start);
+		void removeCable(Cable* c);
+
 		//just makes debugging easier
 		friend class DebugDemo;
 	private:
@@ -180,6 +263,22 @@ namespace phyz {
 		int pgsPosIterations = 15;
 		int pgsHolonomicIterations = 3;
 		bool using_holonomic_system_solver() { return pgsHolonomicIterations > 0; }
+		bool graph_colored_solver = false;
+		int graph_colored_min_constraints = 256;
+		bool simd_contact_solver = false;
+		bool block_contact_solver = false;
+		bool nncg_solver = false;
+		int nncg_min_constraints = 0;
+		bool shock_propagation = false;
+		int shock_propagation_min_constraints = 0;
+		bool parallel_holonomic_solver = false;
+		int parallel_holonomic_min_constraints = 128;
+		double pgs_residual_tolerance = 0;
+		bool adaptive_pgs_iterations = false;
+		int pgsMaxVelIterations = 60;
+		int pgsMaxPosIterations = 45;
+		int pgsMinIterations = 2;
+		int pgs_substeps = 1;
 
 		BroadPhaseStructure broadphase = AABB_TREE;
 		double aabbtree_margin_size = 0.1;
@@ -189,6 +288,7 @@ namespace phyz {
 		double octree_minsize = 1;
 	
 		double holonomic_block_solver_CFM = 0.00001;
+		int holonomic_refactor_interval = 1;
 		bool compute_holonomic_inverse_in_parallel = true;
 
 		int angle_velocity_update_tick_count = 4;
@@ -207,9 +307,20 @@ namespace phyz {
 
 		inline double posCorrectCoeff(double pos_correct_strength, double step_time) { return std::min<double>(pos_correct_strength * step_time, 1.0 / step_time); }
 
+		//warm start data for closestPoints, kept per body pair across calls
+		struct DistanceQueryCache {
+			std::vector<SimplexCache> primitive_caches;
+			std::vector<MeshDistanceCache> mesh_caches;
+		};
+		std::unordered_map<uint64_t, DistanceQueryCache> distance_query_caches;
+		DistanceQueryCache* getDistanceQueryCache(RigidBody* b1, RigidBody* b2);
+		ClosestPointsInfo computeClosestPoints(RigidBody* b1, RigidBody* b2, DistanceQueryCache* cache) const;
+
 		std::vector<RigidBody*> bodies;
 		std::vector<RigidBody*> bodies_to_delete;
 		std::vector<HolonomicSystem> holonomic_systems;
+		std::vector<Articulation*> articulations;
+		std::vector<Cable*> cables;
 		mthz::Vec3 gravity = mthz::Vec3(0, -6, 0);
 		double step_time = 1.0 / 90;
 		double cutoff_vel = 0;
@@ -224,6 +335,8 @@ namespace phyz {
 		double accel_sleep_coeff = 0.044;
 
 		bool warm_start_disabled = false;
+		bool local_space_narrowphase = false;
+		bool tight_AABBs = false;
 		double warm_start_coefficient = 0.975;
 
 		//Constraint Graph
@@ -388,6 +501,7 @@ namespace phyz {
 		struct Spring {
 			RigidBody* b1;
 			RigidBody* b2;
+			SpringConstraint constraint;
 			RigidBody::PKey b1_point_key;
 			RigidBody::PKey b2_point_key;
 			double stiffness;
@@ -396,9 +510,27 @@ namespace phyz {
 			int uniqueID;
 		};
 
+		struct Gear {
+			RigidBody* b1;
+			RigidBody* b2;
+			GearConstraint constraint;
+			mthz::Vec3 b1_rot_axis_body_space;
+			mthz::Vec3 b2_axis_body_space;
+			bool b2_slides;
+			double ratio;
+			CFM cfm;
+			int uniqueID;
+		};
+
 		struct IslandConstraints {
 			std::vector<Constraint*> constraints;
 			std::vector<HolonomicSystem*> systems;
+			std::vector<Cable*> cables;
+			SolverBodies* solver_bodies;
+			SolverRows* solver_rows;
+			int n_itr_vel;
+			int n_itr_pos;
+			PGSSolveStats* stats;
 		};
 
 		struct ActiveConstraintData {
@@ -412,6 +544,13 @@ namespace phyz {
 		};
 
 		ActiveConstraintData sleepOrSolveIslands();
+		void assignSolverBodies(const std::vector<Constraint*>& constraints, const std::vector<Cable*>& cables, SolverBodies* solver_bodies);
+		std::vector<SolverBodies> island_solver_bodies;
+		std::vector<SolverRows> island_solver_rows;
+		std::vector<PGSSolveStats> island_solve_stats;
+		int pgsIterationBudget(int last_iterations, int n_constraints, int n_itr, int max_itr);
+		void assignIterationBudget(IslandConstraints* island);
+		void recordSolveStats(const SolverBodies& solver_bodies, const PGSSolveStats& stats);
 		void applyMasterSlavePosCorrect(const ActiveConstraintData& a);
 
 		struct HolonomicSystemNodes;
@@ -425,6 +564,10 @@ namespace phyz {
 			HolonomicSystemNodes* h = nullptr;
 			bool holonomic_system_scan_needed = false;
 			std::vector<Contact*> contact_constraints;
+			//open addressing table of the contacts keyed by MagicID, kept at most half full. Empty slots are nullptr
+			std::vector<Contact*> contact_lookup;
+			//contacts that expired, reused for the next new contacts on this edge
+			std::vector<Contact*> contact_pool;
 			std::vector<Distance*> distance_constraints;
 			std::vector<BallSocket*> ball_socket_constraints;
 			std::vector<Hinge*> hinge_constraints;
@@ -432,10 +575,18 @@ namespace phyz {
 			std::vector<SlidingHinge*> sliding_hinge_constraints;
 			std::vector<Weld*> weld_constraints;
 			std::vector<Spring*> springs;
+			std::vector<Gear*> gears;
+			//cables joining the pair by a stretch or attachment row, owned by the engine
+			std::vector<Cable*> cables;
 
 			int visited_tag = 0;
 
 			inline ConstraintGraphNode* other(ConstraintGraphNode* c) { return (c->b == n1->b ? n2 : n1); }
+			Contact* findContact(const MagicID& magic);
+			//takes a contact from the pool if there is one. Everything but the magic ID is left for the caller to fill in
+			Contact* createContact(const MagicID& magic);
+			//moves the last contact into index i
+			void removeContact(int i);
 			bool noConstraintsLeft() { 
 				return contact_constraints.empty()
 					&& ball_socket_constraints.empty()
@@ -444,10 +595,17 @@ namespace phyz {
 					&& slider_constraints.empty()
 					&& sliding_hinge_constraints.empty()
 					&& weld_constraints.empty()
-					&& springs.empty();
+					&& springs.empty()
+					&& gears.empty()
+					&& cables.empty();
 			}
 
 			bool hasHolonomicConstraint() {
+				return hasHolonomicJoint() || !gears.empty();
+			}
+
+			//a gear is only taken into the holonomic system on edges without one of these
+			bool hasHolonomicJoint() {
 				return !(ball_socket_constraints.empty()
 					  && distance_constraints.empty()
 					  && hinge_constraints.empty()
@@ -455,6 +613,9 @@ namespace phyz {
 					  && sliding_hinge_constraints.empty()
 					  && weld_constraints.empty());
 			}
+
+		private:
+			void insertIntoLookup(Contact* c);
 		};
 
 		struct HolonomicSystemNodes {
@@ -484,6 +645,12 @@ namespace phyz {
 			void insertNewEdge(SharedConstraintsEdge* e);
 		};
 
+		Articulation::Link* fetchArticulationJoint(RigidBody* link);
+		void addArticulationJoint(Articulation* a, RigidBody* parent, RigidBody* child, Articulation::JointType joint, mthz::Vec3 pivot, mthz::Vec3 axis);
+		bool edgeTouchesArticulation(SharedConstraintsEdge* e) { return e->n1->b->getArticulation() != nullptr || e->n2->b->getArticulation() != nullptr; }
+
+		//b2's rate about, or along when it slides, its axis held at ratio times b1's rate about its own
+		ConstraintID addGear(RigidBody* b1, RigidBody* b2, mthz::Vec3 b1_rot_axis_local, mthz::Vec3 b2_axis_local, bool b2_slides, double ratio);
 		Motor* fetchMotor(ConstraintID id);
 		Piston* fetchPiston(ConstraintID id);
 
@@ -10,51 +10,58 @@ namespace phyz {
 	static void calculateMassProperties(const ConvexUnionGeometry& geometry, mthz::Vec3* com, mthz::Mat3* tensor, double* mass, bool override_center_of_mass, mthz::Vec3 center_of_mass_override);
 	static mthz::Mat3 recenterTensor(double mass, const mthz::Mat3& tensor, mthz::Vec3 new_center_of_rotation, mthz::Vec3 old_center_of_rotation, mthz::Vec3 true_center_of_mass_of_geometry);
 
-	RigidBody::RigidBody(const ConvexUnionGeometry& source_geometry, const mthz::Vec3& pos, const mthz::Quaternion& orientation, unsigned int id, bool overide_center_of_mass = false, mthz::Vec3 local_coords_com_override = mthz::Vec3(0, 0, 0))
-		: geometry_type(CONVEX_UNION), geometry(source_geometry.getPolyhedra()), reference_geometry(source_geometry.getPolyhedra()), vel(0, 0, 0), ang_vel(0, 0, 0),
-		psuedo_vel(0, 0, 0), psuedo_ang_vel(0, 0, 0), asleep(false), sleep_ready_counter(0), non_sleepy_tick_count(0), com_type(PHYSICALLY_BASED), id(id)
+	RigidBodyShape::RigidBodyShape(const ConvexUnionGeometry& source_geometry, bool override_center_of_mass, mthz::Vec3 local_coords_com_override)
+		: is_static_mesh(false), reference_geometry(source_geometry.getPolyhedra())
 	{
-		movement_type = DYNAMIC;
-		calculateMassProperties(source_geometry, &this->com, &this->reference_tensor, &this->mass, overide_center_of_mass, local_coords_com_override);
-		reference_invTensor = reference_tensor.inverse();
-		tensor = reference_tensor;
-		invTensor = reference_invTensor;
+		calculateMassProperties(source_geometry, &com, &tensor, &mass, override_center_of_mass, local_coords_com_override);
 
 		for (ConvexPrimitive& c : reference_geometry) {
 			c.recomputeFromReference(*c.getGeometry(), mthz::Mat3::iden(), -com);
+			reference_geometry_AABB.push_back(c.gen_AABB());
 		}
-
-		geometry_AABB = std::vector<AABB>(geometry.size());
-		for (int i = 0; i < reference_geometry.size(); i++) {
-			geometry_AABB[i] = geometry[i].gen_AABB();
-		}
-		aabb = AABB::combine(geometry_AABB);
-		local_coord_origin = -com;
-		origin_pkey = trackPoint(mthz::Vec3(0, 0, 0));
-		setToPosition(pos);
-		recievedWakingAction = false;
-
-		custom_com_referenceTensor = reference_tensor;
-		custom_com_referenceTensor = reference_invTensor;
 	}
 
-	RigidBody::RigidBody(const StaticMeshGeometry& source_geometry, unsigned int id)
-		: geometry_type(STATIC_MESH), reference_mesh(source_geometry), mesh(source_geometry), vel(0, 0, 0), ang_vel(0, 0, 0), psuedo_vel(0, 0, 0), psuedo_ang_vel(0, 0, 0),
-		asleep(false), sleep_ready_counter(0), non_sleepy_tick_count(0), id(id)
+	RigidBodyShape::RigidBodyShape(const StaticMeshGeometry& source_geometry)
+		: is_static_mesh(true), reference_mesh(source_geometry), com(0, 0, 0)
 	{
-		movement_type = FIXED;
 		mass = std::numeric_limits<double>::quiet_NaN();
-		reference_tensor *= std::numeric_limits<double>::quiet_NaN();
+		tensor *= std::numeric_limits<double>::quiet_NaN();
+		reference_aabb = reference_mesh.genAABB();
+	}
 
+	RigidBody::RigidBody(std::shared_ptr<const RigidBodyShape> shape, const mthz::Vec3& pos, const mthz::Quaternion& orientation, unsigned int id)
+		: geometry_type(shape->isStaticMesh()? STATIC_MESH : CONVEX_UNION), shape(shape), local_space_geometry(false), tight_AABBs(false), geometry(shape->getPolyhedra()), vel(0, 0, 0), ang_vel(0, 0, 0),
+		psuedo_vel(0, 0, 0), psuedo_ang_vel(0, 0, 0), asleep(false), no_collision(false), sleep_disabled(false), sleep_ready_counter(0), non_sleepy_tick_count(0), solver_index(0), solver_vel_iterations(0), solver_pos_iterations(0), articulation(nullptr), articulation_link(0), com_type(PHYSICALLY_BASED), id(id)
+	{
+		movement_type = geometry_type == STATIC_MESH ? FIXED : DYNAMIC;
+		mass = shape->getMass();
+		reference_tensor = shape->getTensor();
 		reference_invTensor = reference_tensor.inverse();
 		tensor = reference_tensor;
 		invTensor = reference_invTensor;
 
-		reference_aabb = reference_mesh.genAABB();
-		aabb = reference_aabb;
+		//the body starts out where the source geometry was defined, with the center of mass at the shapes local origin
+		com = shape->getCOM();
 		local_coord_origin = -com;
 		origin_pkey = trackPoint(mthz::Vec3(0, 0, 0));
 		recievedWakingAction = false;
+
+		if (geometry_type == CONVEX_UNION) {
+			geometry_AABB = std::vector<AABB>(geometry.size());
+			geometry_AABB_hints = std::vector<AABBSupportHints>(geometry.size());
+
+			custom_com_referenceTensor = reference_tensor;
+			custom_com_referenceTensor = reference_invTensor;
+		}
+		else {
+			aabb = shape->getMeshAABB();
+		}
+
+		//rotate about the center of mass, then move the shapes local origin to pos
+		if (geometry_type == CONVEX_UNION || mthz::Quaternion() != orientation || pos != mthz::Vec3()) {
+			setOrientation(orientation);
+			setToPosition(pos);
+		}
 	}
 
 	void RigidBody::applyImpulse(mthz::Vec3 impulse, mthz::Vec3 position) {
@@ -186,18 +193,29 @@ namespace phyz {
 		RayQueryReturn closest_hit_info = { false };
 
 		if (geometry_type == CONVEX_UNION) {
+			//local space geometry is tested against the ray brought into local coordinates
+			mthz::Mat3 rot = orientation.getRotMatrix();
+			mthz::Mat3 rot_conjugate = orientation.conjugate().getRotMatrix();
+			mthz::Vec3 geometry_ray_origin = local_space_geometry ? rot_conjugate * (ray_origin - com) : ray_origin;
+			mthz::Vec3 geometry_ray_dir = local_space_geometry ? rot_conjugate * ray_dir : ray_dir;
+
 			for (int i = 0; i < geometry.size(); i++) {
 				//check ray actually hits the convex primitive AABB. if geometry.size == 1 then the convex primitive AABB == the rigid body AABB, which is redundant to check
 				if (geometry.size() != 1 && !AABB::rayIntersectsAABB(geometry_AABB[i], ray_origin, ray_dir)) continue;
 
-				RayQueryReturn hit_info = geometry[i].testRayIntersection(ray_origin, ray_dir);
+				RayQueryReturn hit_info = geometry[i].testRayIntersection(geometry_ray_origin, geometry_ray_dir);
 				if (hit_info.did_hit && (!closest_hit_info.did_hit || hit_info.intersection_dist < closest_hit_info.intersection_dist)) {
 					closest_hit_info = hit_info;
 				}
 			}
+
+			if (closest_hit_info.did_hit && local_space_geometry) {
+				closest_hit_info.intersection_point = rot * closest_hit_info.intersection_point + com;
+				closest_hit_info.surface_norm = rot * closest_hit_info.surface_norm;
+			}
 		}
 		else {
-			closest_hit_info = mesh.testRayIntersection(ray_origin, ray_dir);
+			closest_hit_info = getWorldMesh().testRayIntersection(ray_origin, ray_dir);
 		}
 
 		return RayHitInfo{ closest_hit_info.did_hit, (phyz::RigidBody*)this, closest_hit_info.intersection_point, closest_hit_info.surface_norm, closest_hit_info.intersection_dist };
@@ -282,30 +300,70 @@ namespace phyz {
 		invTensor = rot * reference_invTensor_to_use * rot_conjugate;
 		
 		if (geometry_type == CONVEX_UNION) {
+			const std::vector<ConvexPrimitive>& reference_geometry = shape->getPolyhedra();
+			const std::vector<AABB>& reference_geometry_AABB = shape->getPolyhedraAABBs();
 			for (int i = 0; i < reference_geometry.size(); i++) {
-				geometry[i].recomputeFromReference(*reference_geometry[i].getGeometry(), rot, com);
-				geometry_AABB[i] = geometry[i].gen_AABB();
+				if (!local_space_geometry) {
+					geometry[i].recomputeFromReference(*reference_geometry[i].getGeometry(), rot, com);
+				}
+				//AABBs come from the reference geometry either way, so they never need a pass over the world space vertices
+				if (tight_AABBs) {
+					geometry_AABB[i] = reference_geometry[i].gen_AABB(rot, com, &geometry_AABB_hints[i]);
+				}
+				else {
+					geometry_AABB[i] = AABB::getTransformed(reference_geometry_AABB[i], rot, com);
+				}
 			}
 			aabb = AABB::combine(geometry_AABB);
 		}
 		else if (geometry_type == STATIC_MESH) {
 			if (movement_type == FIXED) {
-				mesh.recomputeFromReference(reference_mesh, rot, com);
-				aabb = mesh.genAABB();
+				if (orientation.r == 1.0 && com == mthz::Vec3(0, 0, 0)) {
+					world_mesh.reset();
+					aabb = shape->getMeshAABB();
+				}
+				else {
+					if (!world_mesh) world_mesh = std::make_shared<StaticMeshGeometry>(shape->getMesh());
+					world_mesh->recomputeFromReference(shape->getMesh(), rot, com);
+					aabb = world_mesh->genAABB();
+				}
 			}
 			else {
-				//u, v, w, origin are the world's x, y, z, origin from perspective of local coordinates
-				mthz::Vec3 u = rot_conjugate * mthz::Vec3(1, 0, 0);
-				mthz::Vec3 v = rot_conjugate * mthz::Vec3(0, 1, 0);
-				mthz::Vec3 w = rot_conjugate * mthz::Vec3(0, 0, 1);
-				mthz::Vec3 origin = -rot_conjugate * com;
-
-				aabb = AABB::conformNewBasis(reference_aabb, u, v, w, origin);
+				aabb = AABB::getTransformed(shape->getMeshAABB(), rot, com);
 			}
 		}
 		
 	}
 
+	void RigidBody::setLocalSpaceGeometry(bool local_space) {
+		if (geometry_type != CONVEX_UNION || local_space == local_space_geometry) return;
+
+		local_space_geometry = local_space;
+		if (local_space) {
+			const std::vector<ConvexPrimitive>& reference_geometry = shape->getPolyhedra();
+			for (int i = 0; i < reference_geometry.size(); i++) {
+				geometry[i].recomputeFromReference(*reference_geometry[i].getGeometry(), mthz::Mat3::iden(), mthz::Vec3(0, 0, 0));
+			}
+		}
+		updateGeometry();
+	}
+
+	void RigidBody::setTightAABBs(bool tight) {
+		if (geometry_type != CONVEX_UNION || tight == tight_AABBs) return;
+
+		tight_AABBs = tight;
+		updateGeometry();
+	}
+
+	//local space geometry is copied into world coordinates, the copy is held by world_copy
+	const ConvexPrimitive& RigidBody::getWorldSpacePrimitive(int i, std::unique_ptr<ConvexPrimitive>* world_copy) const {
+		if (!local_space_geometry) return geometry[i];
+
+		*world_copy = std::make_unique<ConvexPrimitive>(geometry[i]);
+		(*world_copy)->recomputeFromReference(*geometry[i].getGeometry(), orientation.getRotMatrix(), com);
+		return **world_copy;
+	}
+
 	void RigidBody::translateNoGeomUpdate(mthz::Vec3 v) {
 		com += v;
 	}
@@ -8,14 +8,46 @@
 #include "AABB.h"
 #include <Vector>
 #include <set>
+#include <memory>
 
 namespace phyz {
 	struct RayHitInfo;
+	class Articulation;
+
+	//immutable reference geometry and mass properties of a body, in local coordinates centered on the center of mass.
+	//Shapes are reference counted, every body created from the same shape shares its polyhedra, gauss maps and mesh BVH.
+	class RigidBodyShape {
+	public:
+		RigidBodyShape(const ConvexUnionGeometry& source_geometry, bool override_center_of_mass=false, mthz::Vec3 local_coords_com_override=mthz::Vec3(0, 0, 0));
+		RigidBodyShape(const StaticMeshGeometry& source_geometry);
+
+		inline bool isStaticMesh() const { return is_static_mesh; }
+		inline const std::vector<ConvexPrimitive>& getPolyhedra() const { return reference_geometry; }
+		inline const std::vector<AABB>& getPolyhedraAABBs() const { return reference_geometry_AABB; }
+		inline const StaticMeshGeometry& getMesh() const { return reference_mesh; }
+		inline AABB getMeshAABB() const { return reference_aabb; }
+		inline mthz::Vec3 getCOM() const { return com; } //in the coordinates of the source geometry
+		inline double getMass() const { return mass; }
+		inline mthz::Mat3 getTensor() const { return tensor; }
+
+	private:
+		bool is_static_mesh;
+		mthz::Vec3 com;
+		mthz::Mat3 tensor;
+		double mass;
+
+		//used for convex union
+		std::vector<ConvexPrimitive> reference_geometry;
+		std::vector<AABB> reference_geometry_AABB;
+
+		//for static mesh
+		StaticMeshGeometry reference_mesh;
+		AABB reference_aabb;
+	};
 
 	class RigidBody {
 	private:
-		RigidBody(const ConvexUnionGeometry& source_geometry, const mthz::Vec3& pos, const mthz::Quaternion& orientation, unsigned int id, bool overide_center_of_mass, mthz::Vec3 local_coords_com_override);
-		RigidBody(const StaticMeshGeometry& source_geometry, unsigned int id);
+		RigidBody(std::shared_ptr<const RigidBodyShape> shape, const mthz::Vec3& pos, const mthz::Quaternion& orientation, unsigned int id);
 	public:
 		typedef int PKey;
 		enum GeometryType { CONVEX_UNION, STATIC_MESH };
@@ -44,6 +76,9 @@ namespace phyz {
 		mthz::Vec3 getVel() const;
 		mthz::Vec3 getAngVel() const;
 		inline GeometryType getGeometryType() const { return geometry_type; }
+		inline const std::shared_ptr<const RigidBodyShape>& getShape() const { return shape; }
+		//the articulation whose joints move the body, nullptr if it moves freely. The fixed root of an articulation is not moved by it
+		inline Articulation* getArticulation() const { return movement_type == DYNAMIC ? articulation : nullptr; }
 		RayHitInfo checkRayIntersection(mthz::Vec3 ray_origin, mthz::Vec3 ray_dir) const;
 
 		void applyForce(mthz::Vec3 force) { vel += force * getInvMass(); }
@@ -66,6 +101,7 @@ namespace phyz {
 		void rotateExtrapolatedOrientation(mthz::Quaternion rotation) { extrapolated_orientation = rotation * extrapolated_orientation; }
 
 		friend class PhysicsEngine;
+		friend class Articulation;
 	private:
 		AABB aabb;
 		MovementType movement_type;
@@ -88,6 +124,12 @@ namespace phyz {
 
 		mthz::Vec3 prev_com;
 		mthz::Quaternion prev_orientation;
+		int solver_index; //position in its island's SolverBodies, only meaningful while the island is being solved
+		//PGS iterations the body's island needed to converge last solve, -1 if it didn't converge and 0 if it hasn't been solved
+		int solver_vel_iterations;
+		int solver_pos_iterations;
+		Articulation* articulation;
+		int articulation_link; //index in the articulation's links
 
 		void sleep();
 		void wake();
@@ -95,6 +137,9 @@ namespace phyz {
 
 		void rotateWhileApplyingGyroAccel(float fElapsedTime, int n_itr = 1, bool gyro_accel_disabled=false);
 		void updateGeometry();
+		void setLocalSpaceGeometry(bool local_space);
+		void setTightAABBs(bool tight);
+		const ConvexPrimitive& getWorldSpacePrimitive(int i, std::unique_ptr<ConvexPrimitive>* world_copy) const;
 		void translateNoGeomUpdate(mthz::Vec3 v);
 		void rotateNoGeomUpdate(mthz::Quaternion q);
 
@@ -121,16 +166,22 @@ namespace phyz {
 		int non_sleepy_tick_count;
 		
 		GeometryType geometry_type;
-
-		//used for convex union
+		std::shared_ptr<const RigidBodyShape> shape;
+
+		//used for convex union. With local space geometry, geometry is left in the shape's local coordinates and is never rebuilt,
+		//collision detection brings one primitive into the others coordinates per pair instead. geometry_AABB is always in world coordinates
+		bool local_space_geometry;
+		//by default primitive AABBs are the shape's local AABBs transformed to world coordinates, which can be loose when rotated.
+		//Tight AABBs are exact, found by hill climbing from the extremal vertices of the previous update
+		bool tight_AABBs;
 		std::vector<AABB> geometry_AABB;
+		std::vector<AABBSupportHints> geometry_AABB_hints;
 		std::vector<ConvexPrimitive> geometry;
-		std::vector<ConvexPrimitive> reference_geometry;
 
-		//for static mesh
-		StaticMeshGeometry reference_mesh;
-		AABB reference_aabb;
-		StaticMeshGeometry mesh;
+		//for static mesh. A fixed mesh that hasn't been moved from its reference position uses the shape's mesh directly,
+		//world_mesh is only allocated once it has been transformed
+		std::shared_ptr<StaticMeshGeometry> world_mesh;
+		inline const StaticMeshGeometry& getWorldMesh() const { return world_mesh ? *world_mesh : shape->getMesh(); }
 		
 		std::vector<mthz::Vec3> track_p;
 	};
@@ -0,0 +1,13 @@
+#pragma once
+
+namespace phyz {
+
+	//precision the solver stores the jacobians and effective masses of its rows in. Impulses and velocity changes are always double.
+	//Defining PHYZ_SINGLE_PRECISION_SOLVER for the build halves the row data the PGS loop reads every sweep
+#ifdef PHYZ_SINGLE_PRECISION_SOLVER
+	typedef float solver_real;
+#else
+	typedef double solver_real;
+#endif
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include "DemoScene.h"
+#include "../../../ConstraintPhysics/src/PhysicsEngine.h"
+#include <chrono>
+#include <cstdio>
+
+//runs a few fixed scenes without rendering and prints the time per step, for each contact solver. Run it from builds with and without
+//PHYZ_SINGLE_PRECISION_SOLVER defined to compare solver precisions. Average height shows how much the stacks sink or the chain sags.
+//The substep solver is the per row solver split into 8 substeps in place of the usual iterations, nncg is the per row solver with NNCG steps
+//and shock is the per row solver with a shock propagation sweep. Artic chain is the hinge chain as an articulation, which can't sag. Cable is a
+//rope of spheres draped onto the floor, solved directly by the cable rather than by the contact solver
+class SolverBenchmarkDemo : public DemoScene {
+public:
+	SolverBenchmarkDemo(DemoManager* manager, DemoProperties properties) : DemoScene(manager, properties) {}
+
+	~SolverBenchmarkDemo() override {
+
+	}
+
+	std::vector<ControlDescription> controls() override {
+		return {};
+	}
+
+	std::map<std::string, std::string> askParameters() override {
+		std::map<std::string, std::string> out;
+
+		out["steps"] = askCustomParameterValue(
+			"Steps to simulate per scene: ", [](std::string s) -> bool { return !s.empty() && s.find_first_not_of("0123456789") == std::string::npos; }, "Enter a whole number: "
+		);
+
+		return out;
+	}
+
+	void run() override {
+		if (properties.n_threads != 0) {
+			phyz::PhysicsEngine::enableMultithreading(properties.n_threads);
+		}
+
+		int steps = atoi(parameters["steps"].c_str());
+		printf("\nSolver rows stored in %s precision, %d steps per scene\n", sizeof(phyz::solver_real) == sizeof(float) ? "single" : "double", steps);
+		printf("%-14s %-10s %12s %14s %16s\n", "scene", "contacts", "ms per step", "avg vel itr", "avg height");
+
+		for (ContactSolver solver : { PER_ROW, BATCHED, MANIFOLD_BLOCK, SUBSTEPPED, NNCG, SHOCK }) {
+			runScene("box pile", solver, steps, [](phyz::PhysicsEngine* p, std::vector<phyz::RigidBody*>* tracked) {
+				for (int x = 0; x < 10; x++) for (int y = 0; y < 10; y++) for (int z = 0; z < 3; z++) {
+					tracked->push_back(p->createRigidBody(phyz::ConvexUnionGeometry::box(mthz::Vec3(x + (y % 2) * 0.5, y * 1.001, z), 1, 1, 1)));
+				}
+			});
+			runScene("tower", solver, steps, [](phyz::PhysicsEngine* p, std::vector<phyz::RigidBody*>* tracked) {
+				for (int y = 0; y < 40; y++) {
+					tracked->push_back(p->createRigidBody(phyz::ConvexUnionGeometry::box(mthz::Vec3(0, y * 1.001, 0), 1, 1, 1)));
+				}
+			});
+			runScene("hinge chain", solver, steps, [](phyz::PhysicsEngine* p, std::vector<phyz::RigidBody*>* tracked) {
+				phyz::RigidBody* prev = p->createRigidBody(phyz::ConvexUnionGeometry::box(mthz::Vec3(0, 30, 0), 1, 1, 1), phyz::RigidBody::FIXED);
+				for (int i = 1; i < 30; i++) {
+					phyz::RigidBody* link = p->createRigidBody(phyz::ConvexUnionGeometry::box(mthz::Vec3(i, 30, 0), 1, 1, 1));
+					p->addHingeConstraint(prev, link, mthz::Vec3(i, 30.5, 0.5), mthz::Vec3(0, 0, 1));
+					tracked->push_back(link);
+					prev = link;
+				}
+			});
+			runScene("artic chain", solver, steps, [](phyz::PhysicsEngine* p, std::vector<phyz::RigidBody*>* tracked) {
+				phyz::RigidBody* prev = p->createRigidBody(phyz::ConvexUnionGeometry::box(mthz::Vec3(0, 30, 0), 1, 1, 1), phyz::RigidBody::FIXED);
+				phyz::Articulation* a = p->createArticulation(prev);
+				for (int i = 1; i < 30; i++) {
+					phyz::RigidBody* link = p->createRigidBody(phyz::ConvexUnionGeometry::box(mthz::Vec3(i, 30, 0), 1, 1, 1));
+					p->addArticulationHinge(a, prev, link, mthz::Vec3(i, 30.5, 0.5), mthz::Vec3(0, 0, 1));
+					tracked->push_back(link);
+					prev = link;
+				}
+			});
+			runScene("cable", solver, steps, [](phyz::PhysicsEngine* p, std::vector<phyz::RigidBody*>* tracked) {
+				phyz::RigidBody* anchor = p->createRigidBody(phyz::ConvexUnionGeometry::box(mthz::Vec3(0, 30, 0), 1, 1, 1), phyz::RigidBody::FIXED);
+				for (int i = 0; i < 120; i++) {
+					tracked->push_back(p->createRigidBody(phyz::ConvexUnionGeometry::sphere(mthz::Vec3(1.5 + i * 0.5, 30.5, 0.5), 0.2)));
+				}
+				phyz::Cable* c = p->createCable(*tracked);
+				p->attachCable(c, anchor, mthz::Vec3(1, 30.5, 0.5), true);
+			});
+		}
+
+		manager->deselectCurrentScene();
+	}
+
+private:
+	enum ContactSolver { PER_ROW, BATCHED, MANIFOLD_BLOCK, SUBSTEPPED, NNCG, SHOCK };
+
+	void runScene(const std::string& name, ContactSolver solver, int steps, std::function<void(phyz::PhysicsEngine*, std::vector<phyz::RigidBody*>*)> build) {
+		phyz::PhysicsEngine p;
+		p.setSleepingEnabled(false);
+		p.setSIMDContactSolver(solver == BATCHED);
+		p.setBlockContactSolver(solver == MANIFOLD_BLOCK);
+		p.setSubsteps(solver == SUBSTEPPED ? 8 : 1);
+		p.setNNCGSolver(solver == NNCG);
+		p.setShockPropagation(solver == SHOCK);
+		p.createRigidBody(phyz::ConvexUnionGeometry::box(mthz::Vec3(-50, -1, -50), 100, 1, 100), phyz::RigidBody::FIXED);
+
+		std::vector<phyz::RigidBody*> tracked;
+		build(&p, &tracked);
+
+		long total_iterations = 0;
+		long n_islands = 0;
+		auto t1 = std::chrono::system_clock::now();
+		for (int i = 0; i < steps; i++) {
+			p.timeStep();
+			for (const phyz::PGSSolveStats& s : p.getIslandSolveStats()) {
+				total_iterations += s.vel_iterations;
+				n_islands++;
+			}
+		}
+		auto t2 = std::chrono::system_clock::now();
+
+		double avg_height = 0;
+		for (phyz::RigidBody* r : tracked) avg_height += r->getCOM().y / tracked.size();
+		double ms_per_step = 1000 * std::chrono::duration<double>(t2 - t1).count() / steps;
+		const char* solver_names[] = { "per row", "batched", "block", "substep", "nncg", "shock" };
+		printf("%-14s %-10s %12.3f %14.2f %16.5f\n", name.c_str(), solver_names[solver], ms_per_step, n_islands == 0 ? 0.0 : (double)total_iterations / n_islands, avg_height);
+	}
+};
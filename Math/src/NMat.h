@@ -3,25 +3,28 @@
 #include "Vec3.h"
 #include <cstring>
 #include <vector>
+#include <type_traits>
 
 namespace mthz {
 
 	template<int n>
 	void rowMajorOrderInverse(double* target, double* source);
 
-	template <int n_row, int n_col>
+	//T is the scalar type, double unless the matrix is only used for compact storage
+	template <int n_row, int n_col, typename T = double>
 	struct NMat {
-		double v[n_row][n_col] = { 0 };
+		T v[n_row][n_col] = { 0 };
 
-		NMat<n_row, n_col> inverse() const {
+		NMat<n_row, n_col, T> inverse() const {
+			static_assert(std::is_same<T, double>::value, "inverse is computed in double precision");
 			assert(n_row == n_col);
-			NMat<n_row, n_col> out;
+			NMat<n_row, n_col, T> out;
 			rowMajorOrderInverse<n_row>((double*)out.v, (double*)v);
 			return out;
 		}
 
-		NMat<n_col, n_row> transpose() const {
-			NMat<n_col, n_row> out;
+		NMat<n_col, n_row, T> transpose() const {
+			NMat<n_col, n_row, T> out;
 
 			for (int i = 0; i < n_row; i++) {
 				for (int j = 0; j < n_col; j++) {
@@ -33,7 +36,7 @@ namespace mthz {
 		}
 
 		template<int r, int c>
-		void copyInto(const NMat<r, c>& m, int row, int col) {
+		void copyInto(const NMat<r, c, T>& m, int row, int col) {
 			for (int i = 0; i < r; i++) {
 				for (int j = 0; j < c; j++) {
 					v[i + row][j + col] = m.v[i][j];
@@ -41,8 +44,8 @@ namespace mthz {
 			}
 		}
 
-		NMat<n_row, n_col> operator+(const NMat<n_row, n_col>& r) const {
-			NMat<n_row, n_col> out;
+		NMat<n_row, n_col, T> operator+(const NMat<n_row, n_col, T>& r) const {
+			NMat<n_row, n_col, T> out;
 			for (int i = 0; i < n_row; i++) {
 				for (int j = 0; j < n_col; j++) {
 					out.v[i][j] = this->v[i][j] + r.v[i][j];
@@ -50,8 +53,10 @@ namespace mthz {
 			}
 			return out;
 		}
-		NVec<n_row> operator*(const NVec<n_col>& n_vec) const {
-			NVec<n_row> out;
+		//the product takes the scalar type of the vector, so matrices stored in single precision can still be applied in double precision
+		template<typename U>
+		NVec<n_row, U> operator*(const NVec<n_col, U>& n_vec) const {
+			NVec<n_row, U> out;
 			for (int i = 0; i < n_row; i++) {
 				out.v[i] = 0;
 				for (int j = 0; j < n_col; j++) {
@@ -61,8 +66,8 @@ namespace mthz {
 			return out;
 		}
 
-		NMat<n_row, n_col> operator-(const NMat<n_row, n_col>& r) const {
-			NMat<n_row, n_col> out;
+		NMat<n_row, n_col, T> operator-(const NMat<n_row, n_col, T>& r) const {
+			NMat<n_row, n_col, T> out;
 			for (int i = 0; i < n_row; i++) {
 				for (int j = 0; j < n_col; j++) {
 					out.v[i][j] = this->v[i][j] - r.v[i][j];
@@ -71,8 +76,8 @@ namespace mthz {
 			return out;
 		}
 
-		NMat<n_row, n_col> operator-() const {
-			NMat<n_row, n_col> out;
+		NMat<n_row, n_col, T> operator-() const {
+			NMat<n_row, n_col, T> out;
 			for (int i = 0; i < n_row; i++) {
 				for (int j = 0; j < n_col; j++) {
 					out.v[i][j] = -this->v[i][j];
@@ -81,8 +86,8 @@ namespace mthz {
 			return out;
 		}
 
-		NMat<n_row, n_col> operator*(const double d) const{
-		NMat<n_row, n_col> out;
+		NMat<n_row, n_col, T> operator*(const double d) const{
+		NMat<n_row, n_col, T> out;
 		for (int i = 0; i < n_row; i++) {
 			for (int j = 0; j < n_col; j++) {
 				out.v[i][j] = v[i][j] * d;
@@ -92,8 +97,8 @@ namespace mthz {
 	}
 
 		template<int x>
-		NMat<n_row, x> operator*(const NMat<n_col, x>& r) const {
-			NMat<n_row, x> out;
+		NMat<n_row, x, T> operator*(const NMat<n_col, x, T>& r) const {
+			NMat<n_row, x, T> out;
 			for (int i = 0; i < n_row; i++) {
 				for (int j = 0; j < x; j++) {
 					out.v[i][j] = 0;
@@ -104,6 +109,17 @@ namespace mthz {
 			}
 			return out;
 		}
+
+		template<typename U>
+		NMat<n_row, n_col, U> cast() const {
+			NMat<n_row, n_col, U> out;
+			for (int i = 0; i < n_row; i++) {
+				for (int j = 0; j < n_col; j++) {
+					out.v[i][j] = v[i][j];
+				}
+			}
+			return out;
+		}
 	};
 
 	template<int n>
@@ -148,8 +164,41 @@ namespace mthz {
 		}
 	}
 
-	template<int n_row, int n_col>
-	NMat<n_row, n_col> operator*(double d, const NMat<n_row, n_col> mat) {
+	//inverse of a symmetric positive definite matrix through its LDL^T factorization. Only the lower triangle of source is read.
+	//Around a third of the work of rowMajorOrderInverse for the 4x4 to 6x6 effective mass matrices of joints
+	template<int n>
+	void rowMajorOrderSymmetricInverse(double* target, const double* source) {
+		double l[n][n];
+		double d[n];
+		for (int j = 0; j < n; j++) {
+			d[j] = source[n * j + j];
+			for (int k = 0; k < j; k++) d[j] -= l[j][k] * l[j][k] * d[k];
+			for (int i = j + 1; i < n; i++) {
+				double sum = source[n * i + j];
+				for (int k = 0; k < j; k++) sum -= l[i][k] * l[j][k] * d[k];
+				l[i][j] = sum / d[j];
+			}
+		}
+
+		//solve for each column of the identity. Only the entries on or below the diagonal are solved for, the rest are mirrored
+		for (int c = 0; c < n; c++) {
+			double x[n];
+			for (int i = c; i < n; i++) {
+				double sum = i == c ? 1.0 : 0.0;
+				for (int k = c; k < i; k++) sum -= l[i][k] * x[k];
+				x[i] = sum;
+			}
+			for (int i = c; i < n; i++) x[i] /= d[i];
+			for (int i = n - 1; i >= c; i--) {
+				for (int k = i + 1; k < n; k++) x[i] -= l[k][i] * x[k];
+				target[n * i + c] = x[i];
+				target[n * c + i] = x[i];
+			}
+		}
+	}
+
+	template<int n_row, int n_col, typename T>
+	NMat<n_row, n_col, T> operator*(double d, const NMat<n_row, n_col, T> mat) {
 		return mat * d;
 	}
 
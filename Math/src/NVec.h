@@ -5,9 +5,10 @@
 
 namespace mthz {
 
-	template <int n>
+	//T is the scalar type, double unless the vector is only used for compact storage
+	template <int n, typename T = double>
 	struct NVec {
-		double v[n] = { 0 };
+		T v[n] = { 0 };
 
 		bool isZero() const {
 			for (int i = 0; i < n; i++) {
@@ -18,67 +19,74 @@ namespace mthz {
 			return true;
 		}
 
-		NVec<n> operator+(const NVec<n>& r) const {
-			NVec<n> out;
+		NVec<n, T> operator+(const NVec<n, T>& r) const {
+			NVec<n, T> out;
 			for (int i = 0; i < n; i++) {
 				out.v[i] = this->v[i] + r.v[i];
 			}
 			return out;
 		}
 
-		NVec<n> operator-(const NVec<n>& r) const {
-			NVec<n> out;
+		NVec<n, T> operator-(const NVec<n, T>& r) const {
+			NVec<n, T> out;
 			for (int i = 0; i < n; i++) {
 				out.v[i] = this->v[i] - r.v[i];
 			}
 			return out;
 		}
 
-		NVec<n> operator-() const {
-			NVec<n> out;
+		NVec<n, T> operator-() const {
+			NVec<n, T> out;
 			for (int i = 0; i < n; i++) {
 				out.v[i] = -this->v[i];
 			}
 			return out;
 		};
 
-		double magSqrd() const {
-			double sum = 0;
+		T magSqrd() const {
+			T sum = 0;
 			for (int i = 0; i < n; i++) {
 				sum += v[i] * v[i];
 			}
 			return sum;
 		}
 		
-		NVec<n> norm() const {
+		NVec<n, T> norm() const {
 			return *this * (1.0 / sqrt(magSqrd()));
 		}
 
-		double dot(const NVec<n> nv) const {
-			double sum = 0;
+		T dot(const NVec<n, T> nv) const {
+			T sum = 0;
 			for (int i = 0; i < n; i++) {
 				sum += v[i] * nv.v[i];
 			}
 			return sum;
 		}
 
-		void operator+=(const NVec<n>& r) {
+		void operator+=(const NVec<n, T>& r) {
 			for (int i = 0; i < n; i++) {
 				v[i] += r.v[i];
 			}
 		}
+
+		template<typename U>
+		NVec<n, U> cast() const {
+			NVec<n, U> out;
+			for (int i = 0; i < n; i++) out.v[i] = v[i];
+			return out;
+		}
 	};
 
-	template<int n>
-	NVec<n> operator*(NVec<n> v, double d) {
-		NVec<n> out;
+	template<int n, typename T>
+	NVec<n, T> operator*(NVec<n, T> v, double d) {
+		NVec<n, T> out;
 		for (int i = 0; i < n; i++) out.v[i] = v.v[i] * d;
 		return out;
 	}
 
-	template<int n>
-	NVec<n> operator*(double d, NVec<n> v) {
-		NVec<n> out;
+	template<int n, typename T>
+	NVec<n, T> operator*(double d, NVec<n, T> v) {
+		NVec<n, T> out;
 		for (int i = 0; i < n; i++) out.v[i] = v.v[i] * d;
 		return out;
 	}